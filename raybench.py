@@ -0,0 +1,50 @@
+# -*- coding: utf-8 -*-
+
+"""
+Native micro-benchmarks of the evaluation hot paths, printed as JSON with
+sorted keys so that runs can be diffed and compared, see rayeval.benchmark()
+
+    python raybench.py --ranks-7=hr7.dat --ranks-9=hr9.dat [--load] [--generate]
+"""
+
+import argparse
+import json
+import os
+import tempfile
+
+import rayeval
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Native micro-benchmarks of rayeval.')
+    parser.add_argument('--ranks-7', help='7-card hand ranks file')
+    parser.add_argument('--ranks-9', help='9-card hand ranks file')
+    parser.add_argument('--scale', type=float, default=1.0,
+                        help='multiplies the number of operations of every case')
+    parser.add_argument('--repeats', type=int, default=3, help='runs of every case, the best is kept')
+    parser.add_argument('--load', action='store_true', help='time loading the tables too')
+    parser.add_argument('--generate', action='store_true', help='time generating the 7-card table too')
+    parser.add_argument('--n-jobs', type=int, default=-1, help='generation threads')
+    parser.add_argument('--output', help='write the JSON there instead of stdout')
+    args = parser.parse_args()
+
+    if args.ranks_7:
+        rayeval.load_handranks_7(args.ranks_7)
+    if args.ranks_9:
+        rayeval.load_handranks_9(args.ranks_9)
+    generate_to = None
+    if args.generate:
+        handle, generate_to = tempfile.mkstemp(suffix='.dat', prefix='raybench_')
+        os.close(handle)
+
+    results = rayeval.benchmark(args.ranks_7 if args.load else None,
+                                args.ranks_9 if args.load else None,
+                                args.scale, args.repeats, generate_to, args.n_jobs)
+    report = {'simd_level': rayeval.simd_level(), 'scale': args.scale, 'repeats': args.repeats,
+              'backing': {'7': rayeval.handranks_backing(7), '9': rayeval.handranks_backing(9)},
+              'results': results}
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    else:
+        print text
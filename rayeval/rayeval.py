@@ -1,17 +1,22 @@
 # -*- coding: utf-8 -*-
 
 """
-Shared memory routines will only work if your OS is properly configured,
-e.g. in Mac OS X run the following prior to using shm functionality:
+Shared memory routines use POSIX shared memory (shm_open) by default which
+needs no system configuration. The legacy SysV backend (backend='sysv') will
+only work if your OS is properly configured, e.g. in Mac OS X run the
+following prior to using it:
 
     sudo sysctl -w kern.sysv.shmmax=1598029824
     sudo sysctl -w kern.sysv.shmall=700000
 """
 
 import _rayeval
+import collections
 import itertools
-import joblib
+import math
 import pkg_resources
+import threading
+import weakref
 
 __card_list = list(''.join(c) for c in itertools.product(
     '23456789TJQKA', 'cdhs'))
@@ -78,190 +83,382 @@ def get_handranks_9_filename():
     return pkg_resources.resource_string(__name__, '__rayeval_ranks_path__.txt').split('\n')[1]
 
 
-def load_handranks_7(filename=None):
+def load_handranks_7(filename=None, mmap=False, populate=True, huge_pages=0):
     """
     Load 7-card handranks from file into process memory
 
     filename    : 7-card hand ranks file
+    mmap        : map the file read-only instead of reading it, all processes
+                  mapping the same file share one page cache copy
+    populate    : pre-fault the mapped pages instead of loading them lazily
+    huge_pages  : huge page size in MB (2 or 1024) to back the table with,
+                  falls back to transparent huge pages and then to normal
+                  pages; 0 to disable, see handranks_backing()
     """
     filename = get_handranks_7_filename() if filename is None else filename
-    _rayeval.load_handranks_7(filename)
+    _rayeval.load_handranks_7(filename, mmap, populate, huge_pages)
 
 
-def load_handranks_9(filename=None):
+def load_handranks_9(filename=None, mmap=False, populate=True, huge_pages=0):
     """
     Load 9-card handranks from file into process memory
 
     filename    : 9-card hand ranks file
+    mmap        : map the file read-only instead of reading it, all processes
+                  mapping the same file share one page cache copy
+    populate    : pre-fault the mapped pages instead of loading them lazily
+    huge_pages  : huge page size in MB (2 or 1024) to back the table with,
+                  falls back to transparent huge pages and then to normal
+                  pages; 0 to disable, see handranks_backing()
     """
     filename = get_handranks_9_filename() if filename is None else filename
-    _rayeval.load_handranks_9(filename)
+    _rayeval.load_handranks_9(filename, mmap, populate, huge_pages)
 
 
-def generate_handranks_7(filename, test=True):
+def generate_preflop_tables(filename, iterations=1e5, stderr=None, exact_holdem=False, n_jobs=-1,
+                            seed=None):
+    """
+    Evaluates heads-up preflop equities of every pocket into a file for
+    load_preflop_tables(): hold'em vs a random pocket and vs every other
+    pocket, omaha vs a random pocket; returns the number of classes evaluated
+    (one per class of pockets under suit relabelling: 169 hold'em pockets,
+    47008 hold'em pairings and 16432 omaha pockets, 63609 in all). Both hand
+    ranks tables must be loaded.
+
+    iterations      : sampled deals per class
+    stderr          : target standard error of every equity instead, the
+                      iterations are sized for the worst case variance
+    exact_holdem    : enumerate the hold'em boards instead of sampling them
+                      (hours on one core), the omaha ones are always sampled
+    n_jobs          : number of native threads, -1 to use all cores
+    seed            : seed of the sampling streams, see eval_mc()
+    """
+    if stderr is not None:
+        if not stderr > 0:
+            raise ValueError('Target standard error must be positive.')
+        iterations = math.ceil(0.25 / stderr ** 2)
+    return _rayeval.generate_preflop_tables(filename, int(iterations), int(bool(exact_holdem)),
+                                            parse_n_jobs(n_jobs), parse_seed(seed))
+
+
+def load_preflop_tables(filename, mmap=False, populate=True):
+    """
+    Load preflop equity tables written by generate_preflop_tables(), see
+    preflop_equity()
+
+    mmap, populate  : see load_handranks_7()
+    """
+    _rayeval.load_preflop_tables(filename, mmap, populate)
+
+
+def preflop_equity(game='holdem', pocket='', opponent=None):
+    """
+    Heads-up preflop equity of a pocket from the loaded preflop tables
+
+    opponent    : a hold'em pocket, None for a random one (always for omaha)
+    """
+    game = parse_game(game)
+    i_pocket = parse_pocket(pocket, game)
+    i_opponent = [] if opponent is None else parse_pocket(opponent, game)
+    if 255 in i_pocket or 255 in i_opponent:
+        raise ValueError('Masked pocket is not allowed.')
+    return _rayeval.preflop_equity(game, i_pocket, i_opponent)
+
+
+def handranks_backing(n_cards):
+    """
+    Returns how the loaded 7- or 9-card handranks are held in memory: none,
+    heap, heap+thp, hugetlb, mmap, mmap+thp, hugetlbfs, shm, shm+hugetlb,
+    posix_shm or posix_shm+thp
+    """
+    return _rayeval.handranks_backing(n_cards)
+
+
+def handranks_info(filename):
+    """
+    Returns the header of a hand ranks file as a dict with keys version
+    (1 for files without a header), kind (7, 9, 2 for preflop tables or 0
+    if unknown), length (number of entries), sections (flush suit, flush
+    rank and non-flush block offsets of 9-card files) and checksum
+
+    filename    : hand ranks file
+    """
+    return _rayeval.handranks_info(filename)
+
+
+def verify_handranks(filename):
+    """
+    Returns True if a hand ranks file is complete and matches its checksum,
+    files without a header can only be checked for truncation
+
+    filename    : hand ranks file
+    """
+    return _rayeval.verify_handranks(filename)
+
+
+def generate_handranks_7(filename, test=True, n_jobs=-1):
     """
     Generate 7-card handranks
 
     filename    : 7-card hand ranks file
     test        : run the verification test
+    n_jobs      : number of threads generating the table, -1 for all cores
     """
-    _rayeval.generate_handranks_7(filename, test)
+    _rayeval.generate_handranks_7(filename, test, parse_n_jobs(n_jobs))
 
 
-def generate_handranks_9(filename, filename7='', test=True):
+def generate_handranks_9(filename, filename7='', test=True, n_jobs=-1,
+                         reorder=False):
     """
     Generate 9-card handranks
 
     filename    : 9-card hand ranks file
     filename7   : 7-card hand ranks file
     test        : run the verification test
+    n_jobs      : number of threads generating the table, -1 for all cores
+    reorder     : lay the blocks out breadth-first, see reorder_handranks_9()
+    """
+    _rayeval.generate_handranks_9(filename, filename7, test, parse_n_jobs(n_jobs),
+                                  int(reorder))
+
+
+def reorder_handranks_9(filename=None, filename_out=None):
+    """
+    Reorder the blocks of 9-card handranks breadth-first for better locality
+
+    The upper levels of the table, visited by every evaluation, are packed
+    together and the children of a block are adjacent. The results and the
+    way the table is used stay the same.
+
+    filename    : 9-card hand ranks file
+    filename_out: reordered 9-card hand ranks file
+    """
+    filename = get_handranks_9_filename() if filename is None else filename
+    if filename_out is None:
+        raise ValueError('filename_out must be specified')
+    _rayeval.reorder_handranks_9(filename, filename_out)
+
+
+def parse_shm_backend(backend):
+    if backend not in ('posix', 'sysv'):
+        raise ValueError("Shared memory backend must be 'posix' or 'sysv'.")
+    return int(backend == 'posix')
+
+
+def test_handranks_9(filename=None, filename7=None, n_jobs=-1, samples=0,
+                     shard=0, n_shards=1):
     """
-    _rayeval.generate_handranks_9(filename, filename7, test)
+    Verify 9-card handranks against 7-card handranks, returns True on success
 
+    filename    : 9-card hand ranks file
+    filename7   : 7-card hand ranks file
+    n_jobs      : number of threads, -1 for all cores
+    samples     : check this many random hands instead of all ~4.5 billion
+                  sorted 7-, 8- and 9-card combinations
+    shard       : check only the shard-th of n_shards disjoint slices of
+    n_shards      the combinations, e.g. on several machines
+    """
+    filename = get_handranks_9_filename() if filename is None else filename
+    filename7 = get_handranks_7_filename() if filename7 is None else filename7
+    return _rayeval.test_handranks_9(filename, filename7, parse_n_jobs(n_jobs),
+                                     int(samples), shard, n_shards)
+
+
+def compact_handranks_9(filename=None, filename_out=None, samples=1000000):
+    """
+    Convert 9-card handranks to the compact layout (about 4x smaller)
 
-def load_handranks_7_to_shm(filename=None, path=None, ftok_id=0):
+    The compact table is loaded and shared like the original one, all the
+    Omaha evaluators pick the layout up automatically.
+
+    filename    : 9-card hand ranks file
+    filename_out: compact 9-card hand ranks file
+    samples     : number of random hands to check the compact table on
+    """
+    filename = get_handranks_9_filename() if filename is None else filename
+    if filename_out is None:
+        raise ValueError('filename_out must be specified')
+    _rayeval.compact_handranks_9(filename, filename_out, int(samples))
+
+
+def load_handranks_7_to_shm(filename=None, path=None, ftok_id=0, huge_pages=0,
+                            backend='posix'):
     """
     Load 7-card handranks from file to IPC shared memory
 
+    The segment is published only once the table is completely loaded,
+    processes attaching earlier fail instead of reading a partial table.
+
     filename    : 7-card hand ranks file
     path        : ftok path param for generating shm key
     ftok_id     : ftok id param for generating shm key
+    huge_pages  : huge page size in MB (2 or 1024) to back the segment with,
+                  posix segments use transparent huge pages if shmem allows
+    backend     : 'posix' (shm_open, no sysctl limits) or 'sysv' (shmget)
     """
     filename = get_handranks_7_filename() if filename is None else filename
     path = path if path is not None else filename
-    _rayeval.load_handranks_7_to_shm(filename, path, ftok_id)
+    _rayeval.load_handranks_7_to_shm(filename, path, ftok_id, huge_pages,
+                                     parse_shm_backend(backend))
 
 
-def load_handranks_9_to_shm(filename=None, path=None, ftok_id=0):
+def load_handranks_9_to_shm(filename=None, path=None, ftok_id=0, huge_pages=0,
+                            backend='posix'):
     """
     Load 9-card handranks from file to IPC shared memory
 
+    The segment is published only once the table is completely loaded,
+    processes attaching earlier fail instead of reading a partial table.
+
     filename    : 9-card hand ranks file
     path        : ftok path param to generate shm key
     ftok_id     : ftok id param to generate shm key
+    huge_pages  : huge page size in MB (2 or 1024) to back the segment with,
+                  posix segments use transparent huge pages if shmem allows
+    backend     : 'posix' (shm_open, no sysctl limits) or 'sysv' (shmget)
     """
     filename = get_handranks_9_filename() if filename is None else filename
     path = path if path is not None else filename
-    _rayeval.load_handranks_9_to_shm(filename, path, ftok_id)
+    _rayeval.load_handranks_9_to_shm(filename, path, ftok_id, huge_pages,
+                                     parse_shm_backend(backend))
 
 
-def attach_handranks_7(path=None, ftok_id=0):
+def attach_handranks_7(path=None, ftok_id=0, backend='posix'):
     """
-    Attach 7-card handranks shared memory segment
+    Attach 7-card handranks shared memory segment (read-only for posix)
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
     path = get_handranks_7_filename() if path is None else path
-    _rayeval.attach_handranks_7(path, ftok_id)
+    _rayeval.attach_handranks_7(path, ftok_id, parse_shm_backend(backend))
 
 
-def attach_handranks_9(path=None, ftok_id=0):
+def attach_handranks_9(path=None, ftok_id=0, backend='posix'):
     """
-    Attach 9-card handranks shared memory segment
+    Attach 9-card handranks shared memory segment (read-only for posix)
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
     path = get_handranks_9_filename() if path is None else path
-    _rayeval.attach_handranks_9(path, ftok_id)
+    _rayeval.attach_handranks_9(path, ftok_id, parse_shm_backend(backend))
 
 
 def detach_handranks_7():
     """
-    Detach 7-card handranks shared memory segment
+    Detach 7-card handranks shared memory segment, hand ranks can be
+    loaded or attached again afterwards; raises while evaluations in other
+    threads or eval_mc_async() runs are still using them, see MCFuture.wait()
     """
     _rayeval.detach_handranks_7()
 
 
 def detach_handranks_9():
     """
-    Detach 9-card handranks shared memory segment
+    Detach 9-card handranks shared memory segment, hand ranks can be
+    loaded or attached again afterwards; raises while evaluations in other
+    threads or eval_mc_async() runs are still using them, see MCFuture.wait()
     """
     _rayeval.detach_handranks_9()
 
 
-def del_handranks_shm_7(path=None, ftok_id=0):
+def del_handranks_shm_7(path=None, ftok_id=0, backend='posix'):
     """
     Deletes 7-card handranks shared memory segment
 
     Note that only the super-user or a process with an effective uid equal
     to the shm_perm.cuid or shm_perm.uid values in the data structure
-    associated with the queue can do this.
+    associated with the queue can do this. Processes still attached keep
+    their mapping until they detach.
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
     path = get_handranks_7_filename() if path is None else path
-    _rayeval.del_handranks_shm(path, ftok_id)
+    _rayeval.del_handranks_shm(path, ftok_id, parse_shm_backend(backend))
 
 
-def del_handranks_shm_9(path=None, ftok_id=0):
+def del_handranks_shm_9(path=None, ftok_id=0, backend='posix'):
     """
     Deletes 9-card handranks shared memory segment
 
     Note that only the super-user or a process with an effective uid equal
     to the shm_perm.cuid or shm_perm.uid values in the data structure
-    associated with the queue can do this.
+    associated with the queue can do this. Processes still attached keep
+    their mapping until they detach.
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
     path = get_handranks_9_filename() if path is None else path
-    _rayeval.del_handranks_shm(path, ftok_id)
+    _rayeval.del_handranks_shm(path, ftok_id, parse_shm_backend(backend))
 
 
-def del_handranks_shm(path, ftok_id=0):
+def del_handranks_shm(path, ftok_id=0, backend='posix'):
     """
     Deletes handranks shared memory segment
 
     Note that only the super-user or a process with an effective uid equal
     to the shm_perm.cuid or shm_perm.uid values in the data structure
-    associated with the queue can do this.
+    associated with the queue can do this. Processes still attached keep
+    their mapping until they detach.
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
-    _rayeval.del_handranks_shm(path, ftok_id)
+    _rayeval.del_handranks_shm(path, ftok_id, parse_shm_backend(backend))
 
 
-def is_loaded_to_shm_7(path=None, ftok_id=0):
+def is_loaded_to_shm_7(path=None, ftok_id=0, backend='posix'):
     """
     Returns True if 7-card hand rank file loaded to shm and False otherwise or on error
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
     path = get_handranks_7_filename() if path is None else path
-    return _rayeval.is_loaded_to_shm(path, ftok_id)
+    return _rayeval.is_loaded_to_shm(path, ftok_id, parse_shm_backend(backend))
 
 
-def is_loaded_to_shm_9(path=None, ftok_id=0):
+def is_loaded_to_shm_9(path=None, ftok_id=0, backend='posix'):
     """
     Returns True if 9-card hand rank file loaded to shm and False otherwise or on error
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
     path = get_handranks_9_filename() if path is None else path
-    return _rayeval.is_loaded_to_shm(path, ftok_id)
+    return _rayeval.is_loaded_to_shm(path, ftok_id, parse_shm_backend(backend))
 
 
-def is_loaded_to_shm(path, ftok_id=0):
+def is_loaded_to_shm(path, ftok_id=0, backend='posix'):
     """
     Returns True if hand rank file loaded to shm and False otherwise or on error
 
     path    : ftok path param to generate shm key
     ftok_id : ftok id param to generate shm key
+    backend : 'posix' or 'sysv', as the segment was loaded with
     """
-    return _rayeval.is_loaded_to_shm(path, ftok_id)
+    return _rayeval.is_loaded_to_shm(path, ftok_id, parse_shm_backend(backend))
 
 
-def seed(n):
+def seed(n, stream=0):
     """
     Set the random seed for sampling to a specified values.
+
+    n       : seed of the generator
+    stream  : independent stream of the same seed, e.g. the worker
+              number when seeding several processes from one value
     """
-    _rayeval.seed(n)
+    _rayeval.seed(n, stream)
 
 
 def parse_board(board):
@@ -298,13 +495,13 @@ def parse_pocket_fast(pocket, game):
     return [card_to_rank(c) for c in pocket]
 
 
-def parse_pockets(pockets, game):
+def parse_pockets(pockets, game, min_players=2):
     if isinstance(pockets, basestring):
         pockets = split_string(pockets)
     if not is_iterable(pockets):
         raise TypeError('Pockets must be a list or a tuple.')
     n_players = len(pockets)
-    if n_players <= 1 or n_players > 10:
+    if n_players < min_players or n_players > 10:
         raise ValueError('Invalid number of players.')
     i_pockets = []
     map(i_pockets.extend, map(lambda p: parse_pocket(p, game), pockets))
@@ -328,6 +525,109 @@ def eval_hand_i(game, i_board, i_pocket):
     return _rayeval.eval_hand(game, i_board, i_pocket)
 
 
+def eval_hands_batch(game, boards, pockets, out=None, n_jobs=1):
+    """
+    Evaluate many hands in one native call with the GIL released
+
+    boards  : N x 3-5 uint8 array of 0-51 cards (anything exposing a
+              contiguous buffer, e.g. a numpy array)
+    pockets : N x 2 (holdem) or N x 4 (omaha) uint8 array of 0-51 cards
+    out     : int32 array of N ranks to write into, allocated with numpy
+              if not given
+    n_jobs  : number of native threads, -1 to use all cores
+    """
+    game = parse_game(game)
+    if out is None:
+        import numpy
+        out = numpy.empty(len(boards), dtype=numpy.int32)
+    _rayeval.eval_hands_batch(game, boards, pockets, out, parse_n_jobs(n_jobs))
+    return out
+
+
+SIMD_LEVELS = ('scalar', 'avx2', 'avx512')
+
+
+def simd_level(level=None):
+    """
+    Instruction set used for the batch and Monte Carlo table walks
+
+    level   : 'scalar', 'avx2', 'avx512' or 'auto' for the best one the CPU
+              supports (anything above that is capped); None to keep the
+              current one. Returns the level in use.
+    """
+    if level is None:
+        return SIMD_LEVELS[_rayeval.simd_level()]
+    if level != 'auto' and level not in SIMD_LEVELS:
+        raise ValueError("SIMD level must be 'scalar', 'avx2', 'avx512' or 'auto'.")
+    return SIMD_LEVELS[_rayeval.simd_level(-1 if level == 'auto' else SIMD_LEVELS.index(level))]
+
+
+def benchmark(filename7=None, filename9=None, scale=1.0, repeats=3, generate_to=None, n_jobs=-1):
+    """
+    Native timings of the hot paths, a list of dicts of 'name', 'params' (a
+    dict), 'ops', 'seconds' (of the best repeat), 'ns_per_op' and 'ops_per_sec';
+    see raybench.py. The evaluation and Monte Carlo cases use the loaded hand
+    ranks and are skipped for the tables that aren't loaded.
+
+    filename7   : 7-card hand ranks file to time loading with fread, mmap and
+                  a POSIX shared memory attach, None to skip
+    filename9   : the same for a 9-card hand ranks file
+    scale       : multiplies the number of operations of every case
+    repeats     : runs of every case, the best one is kept
+    generate_to : scratch file to time the 7-card table generation phases
+                  with (removed afterwards), None to skip
+    n_jobs      : generation threads, -1 to use all cores
+    """
+    results = []
+    for name, params, ops, seconds in _rayeval.benchmark(filename7 or '', filename9 or '',
+                                                         float(scale), int(repeats),
+                                                         generate_to or '', parse_n_jobs(n_jobs)):
+        results.append({'name': name, 'ops': ops, 'seconds': seconds,
+                        'params': dict((k, int(v) if v.isdigit() else v) for k, v in
+                                       (p.split('=') for p in params.split(',') if p)),
+                        'ns_per_op': 1e9 * seconds / ops,
+                        'ops_per_sec': ops / seconds if seconds > 0 else float('inf')})
+    return results
+
+
+def enable_stats(hardware=False):
+    """
+    Start counting calls, time, deals and evaluations for stats(); returns
+    whether the hardware counters could be opened. Counting is off by default.
+
+    hardware : also count cache and dTLB misses in user space (linux perf_event,
+               needs perf_event_paranoid <= 2); only threads started from now
+               on are counted, so the thread pool isn't
+    """
+    return _rayeval.stats_enable(1, int(hardware))
+
+
+def disable_stats():
+    """
+    Stop counting and close the hardware counters; the counts are kept.
+    """
+    _rayeval.stats_enable(0, 0)
+
+
+def reset_stats():
+    """
+    Zero the counters (the table load times are kept).
+    """
+    _rayeval.stats_reset()
+
+
+def stats():
+    """
+    The counters as a dict of 'enabled', 'calls' and 'seconds' (dicts by entry
+    point), 'deals' and 'evaluations' (hands scored), 'sample_seconds' and
+    'walk_seconds' (the Monte Carlo time split between dealing and the table
+    walks, estimated from the 'timed_deals'), 'tables' ({'7': ..., '9': ...}
+    of 'backing' and 'load_seconds') and 'hardware' ('cache_misses' and
+    'dtlb_misses', or None).
+    """
+    return _rayeval.stats()
+
+
 def hand_rank_str(game='holdem', board='', pocket=''):
     return __hand_rank_str__[eval_hand(game=game, board=board, pocket=pocket) >> 12]
 
@@ -343,7 +643,29 @@ def hand_draw_outs(game='omaha', board='', pocket='', draw='straight'):
     return hand_draw_outs_i(game, i_board, i_pocket, draw)
 
 
+def classify_hand(board='', pocket='', game='omaha'):
+    """
+    Draws and made hand of a pocket on a board in one native call: a dict of
+    'straight_outs', 'flush_outs' (both (outs, nut_outs) tuples, see
+    hand_draw_outs), their sums 'outs' and 'nut_outs', 'draw_type' (see
+    draw_type) and 'made_hand_type' (see made_hand_type)
+
+    board   : 3-5 known cards, there are no outs on the river
+    """
+    game = parse_game(game)
+    return classify_hand_i(game, parse_board(board), parse_pocket(pocket, game))
+
+
+def classify_hand_i(game, i_board, i_pocket):
+    s_outs, s_nut_outs, f_outs, f_nut_outs, draw, made = _rayeval.classify_hand(game, i_board, i_pocket)
+    return {'straight_outs': (s_outs, s_nut_outs), 'flush_outs': (f_outs, f_nut_outs),
+            'outs': s_outs + f_outs, 'nut_outs': s_nut_outs + f_nut_outs,
+            'draw_type': draw, 'made_hand_type': made}
+
+
 def hand_draw_outs_i(game, i_board, i_pocket, draw):
+    if draw in ('straight', 'flush'):
+        return classify_hand_i(game, i_board, i_pocket)[draw + '_outs']
     outs = 0
     nut_outs = 0
 
@@ -367,60 +689,11 @@ def draw_type(board='', pocket=''):
 
 
 def draw_type_i(i_board, i_pocket):
-    s_outs, s_nut_outs = hand_draw_outs_i('omaha', i_board, i_pocket, 'straight')
-    f_outs, f_nut_outs = hand_draw_outs_i('omaha', i_board, i_pocket, 'flush')
-    outs = s_outs + f_outs
-    nut_outs = s_nut_outs + f_nut_outs
-    if outs == 0:
-        return 'ND'
-    if outs < 8:
-        return 'WD'
-    if outs < 11:
-        if nut_outs < 4:
-            return 'WD'
-        return 'GD'
-    return 'SD'
+    return classify_hand_i('omaha', i_board, i_pocket)['draw_type']
 
 
 def made_hand_type_i(i_board, i_pocket):
-    bc = []
-    pc = []
-
-    for card in i_board:
-        c, s = divmod(card, 4)
-        bc.append(c)
-
-    for card in i_pocket:
-        c, s = divmod(card, 4)
-        pc.append(c)
-
-    bc.sort()
-    bc.reverse()
-    pc.sort()
-    pc.reverse()
-
-    hand = hand_rank_str_i('omaha', i_board, i_pocket)
-
-    if hand in ["two pair", "three of a kind", "straight", "flush", "full house", "four of a kind", "straight flush"]:
-        return '2P+'
-    if hand in ["n/a", "high card"]:
-        return 'WMH'
-
-    prev = -1
-    pp = -1
-    for c in pc:
-        if c == prev:
-            pp = c
-            break
-        prev = c
-
-    if pp > bc[0]:
-        return 'OP'
-
-    if bc[0] in pc and (pc[0] is 12 or pc[0] is 11 or pc[1] is 11):
-        return 'TPGK'
-
-    return 'WMH'
+    return _rayeval.classify_hand('omaha', i_board, i_pocket)[5]
 
 
 def made_hand_type(board='', pocket=''):
@@ -546,28 +819,529 @@ def texture_change(i_board, next_card):
     return new_nuts
 
 
+def parse_n_jobs(n_jobs):
+    if not isinstance(n_jobs, int) or (n_jobs <= 0 and n_jobs != -1):
+        raise ValueError('Invalid number of jobs.')
+    return n_jobs
+
+
+def parse_seed(seed):
+    if seed is None:
+        return -1
+    if not isinstance(seed, (int, long)) or seed < 0 or seed >= 2 ** 63:
+        raise ValueError('Seed must be a non-negative 63-bit integer or None.')
+    return seed
+
+
+class EquityCache(object):
+    """
+    Equities keyed by the canonical spot (see canonical_form()) in an
+    in-process LRU, optionally in front of an on-disk store that every process
+    opening the same file shares through a memory mapping, like the hand-rank
+    tables. An entry answers the queries that ask for no more deals than it
+    was sampled with, or any query if it was enumerated.
+
+    size        : number of spots kept in the LRU
+    filename    : on-disk store, created if it doesn't exist; entries only get
+                  evicted there when their slots are taken by other spots
+    slots       : number of entries of a new on-disk store, ~144 bytes each
+    """
+
+    EXACT = -1
+
+    def __init__(self, size=100000, filename=None, slots=1 << 20):
+        if not isinstance(size, (int, long)) or size <= 0:
+            raise ValueError('Size must be a positive integer.')
+        self.size = size
+        self.filename = filename
+        self._lru = collections.OrderedDict()
+        self._lock = threading.Lock()
+        self._store = None if filename is None else _rayeval.cache_open(filename, int(slots))
+        self.hits = self.disk_hits = self.misses = 0
+
+    @staticmethod
+    def key(game, i_board, i_pockets):
+        i_board, i_pockets, _ = _rayeval.canonical_form(game, i_board, i_pockets)
+        return game, tuple(i_board), tuple(i_pockets)
+
+    @staticmethod
+    def _covers(accuracy, wanted):
+        return accuracy == EquityCache.EXACT or (wanted != EquityCache.EXACT and accuracy >= wanted)
+
+    def get(self, key, accuracy):
+        """
+        Equities of a key() with at least the given number of deals (EXACT for
+        enumerated ones only), None if there are none
+        """
+        with self._lock:
+            entry = self._lru.pop(key, None)
+            if entry is not None:
+                self._lru[key] = entry
+                if self._covers(entry[0], accuracy):
+                    self.hits += 1
+                    return list(entry[1])
+        if self._store is not None:
+            ev = _rayeval.cache_get(self._store, key[0], list(key[1]), list(key[2]), accuracy)
+            if ev is not None:
+                with self._lock:
+                    self.disk_hits += 1
+                self._put_lru(key, accuracy, ev)
+                return ev
+        with self._lock:
+            self.misses += 1
+        return None
+
+    def put(self, key, accuracy, ev):
+        self._put_lru(key, accuracy, ev)
+        if self._store is not None:
+            _rayeval.cache_put(self._store, key[0], list(key[1]), list(key[2]), accuracy, list(ev))
+
+    def _put_lru(self, key, accuracy, ev):
+        with self._lock:
+            entry = self._lru.pop(key, None)
+            if entry is None or self._covers(accuracy, entry[0]):
+                entry = (accuracy, tuple(ev))
+            self._lru[key] = entry
+            while len(self._lru) > self.size:
+                self._lru.popitem(last=False)
+
+    def clear(self):
+        """
+        Empties the LRU, the on-disk store is left alone
+        """
+        with self._lock:
+            self._lru.clear()
+
+    def info(self):
+        return {'hits': self.hits, 'disk_hits': self.disk_hits, 'misses': self.misses,
+                'size': len(self._lru), 'max_size': self.size, 'filename': self.filename}
+
+
+_equity_cache = None
+
+
+def enable_cache(size=100000, filename=None, slots=1 << 20):
+    """
+    Puts an EquityCache in front of eval_mc() and eval_exact() and returns it
+
+    Only calls without a seed use the cache, seeded ones are reproducible.
+    """
+    global _equity_cache
+    _equity_cache = EquityCache(size, filename, slots)
+    return _equity_cache
+
+
+def disable_cache():
+    global _equity_cache
+    _equity_cache = None
+
+
+def cache_info():
+    """
+    Hit and miss counts of the cache of enable_cache(), None if it's disabled
+    """
+    return None if _equity_cache is None else _equity_cache.info()
+
+
+def parse_exact_threshold(exact, exact_threshold, iterations):
+    if exact is True:
+        return 2 ** 62
+    elif exact is False:
+        return 0
+    elif exact == 'auto':
+        return iterations if exact_threshold is None else int(exact_threshold)
+    raise ValueError('Exact must be True, False or auto.')
+
+
+def mc_stats_result(result):
+    ev, win, tie, categories, stderr, n_deals = result
+    return {'ev': ev, 'win': win, 'tie': tie,
+            'lose': [max(0.0, 1.0 - w - t) for w, t in zip(win, tie)],
+            'categories': [dict(zip(__hand_rank_str__[1:], c[1:])) for c in categories],
+            'stderr': stderr, 'deals': n_deals}
+
+
 def eval_mc(game='holdem', board='', pockets=['', ''],
-            iterations=1e6, n_jobs=1):
+            iterations=1e6, n_jobs=1, exact='auto', exact_threshold=None,
+            interleave=16, stratify=False, seed=None, stats=False):
+    """
+    Monte Carlo equity of each pocket, masked cards are dealt at random
+
+    iterations      : number of sampled deals
+    n_jobs          : number of native threads to split the iterations across,
+                      -1 to use all cores; the GIL is released while running
+    exact           : True to enumerate every deal of the masked cards, False
+                      to always sample, 'auto' to enumerate when there are no
+                      more than exact_threshold deals
+    exact_threshold : defaults to the number of iterations
+    interleave      : number of deals every thread evaluates in lockstep so
+                      that their table lookups overlap, 1 to evaluate one
+                      deal at a time (1-32, same results for the same seed)
+    stratify        : deal the first masked board card (the turn on a flop)
+                      evenly over the remaining cards instead of at random,
+                      which removes its share of the variance
+    seed            : seed of the sampling streams; calls with the same seed
+                      use common random numbers, so comparing related spots
+                      (e.g. different turn cards) is much less noisy; None
+                      for a fresh seed from the global generator, and for
+                      the cache of enable_cache() if there is one
+    stats           : tally the same deals by outcome and final hand too and
+                      return a dict of 'ev', 'win', 'tie' and 'lose' (shares
+                      of the deals won outright, split and lost per pocket),
+                      'categories' (per pocket, the share of the deals ending
+                      in each hand category, see hand_rank_str), 'stderr' (of
+                      every equity, 0 if enumerated) and 'deals'; never cached
+    """
     game = parse_game(game)
     i_board = parse_board(board)
     i_pockets = parse_pockets(pockets, game)
     iterations = int(iterations)
-    if not isinstance(n_jobs, int) or n_jobs <= 0:
-        raise ValueError('Invalid number of jobs.')
-    if n_jobs is 1:
-        return _rayeval.eval_mc(game, i_board, i_pockets, iterations)
+    n_jobs = parse_n_jobs(n_jobs)
+    if stats:
+        return mc_stats_result(_rayeval.eval_mc(
+            game, i_board, i_pockets, iterations, n_jobs,
+            parse_exact_threshold(exact, exact_threshold, iterations),
+            int(interleave), int(stratify), parse_seed(seed), 1))
+    cache = _equity_cache if seed is None else None
+    if exact is True:
+        accuracy = EquityCache.EXACT
+    else:
+        exact_threshold = parse_exact_threshold(exact, exact_threshold, iterations)
+        accuracy = iterations
+        if cache is not None and _rayeval.count_deals(game, i_board, i_pockets) <= exact_threshold:
+            accuracy = EquityCache.EXACT
+    if cache is not None:
+        key = cache.key(game, i_board, i_pockets)
+        ev = cache.get(key, accuracy)
+        if ev is not None:
+            return ev
+    if exact is True:
+        ev = _rayeval.eval_exact(game, i_board, i_pockets, n_jobs)
+    else:
+        ev = _rayeval.eval_mc(game, i_board, i_pockets, iterations, n_jobs, exact_threshold,
+                              int(interleave), int(stratify), parse_seed(seed))
+    if cache is not None:
+        cache.put(key, accuracy, ev)
+    return ev
+
+
+def _mc_async_progress(run):
+    n_done, ev, state = _rayeval.mc_async_progress(run)
+    return {'iterations': n_done, 'ev': ev if n_done else None, 'state': state}
+
+
+def _mc_async_watch(future_ref, run, callback, interval):
+    # holds the run and only a weak reference to its future, so that dropping
+    # the future still cancels the run
+    while _rayeval.mc_async_wait(run, interval) == 'running':
+        if future_ref() is None:
+            _rayeval.mc_async_cancel(run)
+            continue
+        callback(_mc_async_progress(run))
+    callback(_mc_async_progress(run))
+
+
+class MCFuture(object):
+    """
+    Handle of a Monte Carlo run in the background, see eval_mc_async()
+
+    The run is cancelled once the handle is garbage collected (unless the
+    callback holds on to it).
+    """
+
+    def __init__(self, run, callback=None, interval=0.1):
+        self._run = run
+        self._watcher = None
+        if callback is not None:
+            self._watcher = threading.Thread(target=_mc_async_watch,
+                                             args=(weakref.ref(self), run, callback, interval))
+            self._watcher.daemon = True
+            self._watcher.start()
+
+    def progress(self):
+        """
+        Returns a dict of the deals done so far ('iterations'), their equities
+        ('ev', None before the first task is done) and the state of the run
+        ('state': 'running', 'done', 'cancelled' or 'timeout')
+        """
+        return _mc_async_progress(self._run)
+
+    def cancel(self):
+        """
+        Stops the run after the tasks already started, the deals done are kept
+        """
+        _rayeval.mc_async_cancel(self._run)
+
+    def done(self):
+        return _rayeval.mc_async_wait(self._run, 1e-9) != 'running'
+
+    def wait(self, timeout=None):
+        """
+        Waits for the run to stop, up to timeout seconds; returns True if it has
+        """
+        return _rayeval.mc_async_wait(self._run, 0 if timeout is None else max(float(timeout), 1e-9)) != 'running'
+
+    def result(self, timeout=None):
+        """
+        Waits up to timeout seconds for the run to stop and returns the best
+        estimate of the equities at that point (None if no deals are done),
+        without stopping the run
+        """
+        self.wait(timeout)
+        return self.progress()['ev']
+
+
+def eval_mc_async(game='holdem', board='', pockets=['', ''], iterations=1e6, n_jobs=1,
+                  timeout=None, callback=None, interval=0.1, interleave=16,
+                  stratify=False, seed=None, chunk=20000):
+    """
+    Starts eval_mc() in the background and returns an MCFuture right away
+
+    The deals are done in tasks of chunk deals on the native thread pool;
+    progress(), cancel() and result() of the future see whole tasks only.
+    With a seed, a finished run gives the same result for the same chunk
+    size however many n_jobs are used, and so does eval_mc() with n_jobs set
+    to the number of tasks if chunk is a divisor of iterations.
+
+    timeout     : seconds after which the run stops with the deals done by then
+    callback    : called with progress() every interval seconds from a
+                  background Python thread, and once more when the run stops
+    chunk       : deals per task, the granularity of progress and cancellation
+    """
+    game = parse_game(game)
+    i_board = parse_board(board)
+    i_pockets = parse_pockets(pockets, game)
+    run = _rayeval.eval_mc_async(game, i_board, i_pockets, int(iterations), parse_n_jobs(n_jobs),
+                                 int(interleave), int(stratify), parse_seed(seed),
+                                 0.0 if timeout is None else max(float(timeout), 1e-9), int(chunk))
+    return MCFuture(run, callback, interval)
+
+
+def eval_mc_batch(spots, iterations=1e6, n_jobs=-1, exact='auto', exact_threshold=None,
+                  interleave=16, stratify=False, seed=None):
+    """
+    eval_mc() of many spots at once, returns the list of their equities
+
+    The spots are split into tasks of up to 100000 deals that a persistent
+    pool of native threads works through, stealing work from each other.
+    With a seed, every spot gets the same result as eval_mc() with that seed
+    and n_jobs set to its number of tasks, however many n_jobs are used here
+    (so equal spots get equal results); without one, every spot samples
+    independently, like a loop of eval_mc() calls.
+
+    spots           : list of (game, board, pockets) or (game, board, pockets,
+                      iterations) tuples
+    iterations      : default number of sampled deals per spot
+    n_jobs          : number of native threads, -1 to use all cores
+    exact, exact_threshold, interleave, stratify, seed : see eval_mc(), the
+                      same for all spots; exact_threshold defaults to iterations
+    """
+    iterations = int(iterations)
+    i_spots = []
+    for spot in spots:
+        if not isinstance(spot, tuple) or len(spot) not in (3, 4):
+            raise TypeError('Every spot must be a (game, board, pockets[, iterations]) tuple.')
+        game = parse_game(spot[0])
+        i_spots.append((game, parse_board(spot[1]), parse_pockets(spot[2], game),
+                        int(spot[3]) if len(spot) == 4 else iterations))
+    exact_threshold = parse_exact_threshold(exact, exact_threshold, iterations)
+    return _rayeval.eval_mc_batch(i_spots, parse_n_jobs(n_jobs), exact_threshold,
+                                  int(interleave), int(stratify), parse_seed(seed))
+
+
+def parse_target_stderr(stderr, half_width, confidence):
+    if (stderr is None) == (half_width is None):
+        raise ValueError('Exactly one of stderr and half_width must be given.')
+    if half_width is None:
+        return float(stderr)
+    if not 0 < confidence < 1:
+        raise ValueError('Confidence must be between 0 and 1.')
+    # two-sided normal quantile by bisection
+    lo, hi, p = 0.0, 40.0, 0.5 + confidence / 2
+    for _ in range(100):
+        mid = (lo + hi) / 2
+        if 0.5 * math.erfc(-mid / math.sqrt(2)) < p:
+            lo = mid
+        else:
+            hi = mid
+    return float(half_width) / lo
+
+
+def eval_mc_adaptive(game='holdem', board='', pockets=['', ''], stderr=None,
+                     half_width=None, confidence=0.95, max_iterations=1e7,
+                     n_jobs=1, interleave=16, chunk=10000, stratify=False,
+                     seed=None):
+    """
+    Monte Carlo equity sampled until it is precise enough, returns a tuple of
+    (ev, stderr, iterations) with the standard error of every equity and
+    the number of deals actually sampled
+
+    stderr          : target standard error of every equity
+    half_width      : target half-width of the confidence interval of every
+                      equity instead of stderr
+    confidence      : confidence level of the half_width interval
+    max_iterations  : stop there even if the target is not reached
+    n_jobs          : number of native threads, -1 to use all cores
+    interleave      : see eval_mc()
+    chunk           : size of the first round, the next rounds are sized
+                      after the variance seen so far
+    stratify, seed  : see eval_mc()
+    """
+    stderr = parse_target_stderr(stderr, half_width, confidence)
+    game = parse_game(game)
+    i_board = parse_board(board)
+    i_pockets = parse_pockets(pockets, game)
+    return _rayeval.eval_mc_adaptive(game, i_board, i_pockets, int(max_iterations), stderr,
+                                     parse_n_jobs(n_jobs), int(interleave), int(chunk),
+                                     int(stratify), parse_seed(seed))
+
+
+def parse_range(hand_range, game):
+    """
+    Returns (cards, weights) of a range: a pocket ('Ah Kd', '* *'), a list of
+    pockets and/or (pocket, weight) pairs, or a dict {pocket: weight}
+    """
+    if isinstance(hand_range, basestring):
+        hand_range = [hand_range]
+    elif isinstance(hand_range, dict):
+        hand_range = hand_range.items()
+    if not is_iterable(hand_range):
+        raise TypeError('Range must be a pocket, a list or a dict.')
+    cards, weights = [], []
+    for combo in hand_range:
+        weight = 1.0
+        if isinstance(combo, tuple) and len(combo) == 2 and not isinstance(combo[1], basestring):
+            combo, weight = combo
+        cards.extend(parse_pocket(combo, game))
+        weights.append(float(weight))
+    return cards, weights
+
+
+def eval_range_equity(game='holdem', board='', ranges=['', ''], iterations=1e6, n_jobs=1,
+                      exact='auto', exact_threshold=None, seed=None, return_exact=False):
+    """
+    Equity of each weighted range against the others
+
+    Combos are dealt with probability proportional to the product of their
+    weights among those that don't share cards, masked cards at random.
+
+    ranges          : one per player, see parse_range(), e.g.
+                      [{'Ah Ad': 1, 'Kh Kd': 0.5}, '* *']
+    iterations      : number of sampled deals
+    n_jobs          : number of native threads, -1 to use all cores
+    exact           : True to enumerate all combos and deals, False to always
+                      sample, 'auto' to enumerate when there are no more than
+                      exact_threshold of them (an upper bound: combo tuples,
+                      clashing ones included, times the deals of the combos
+                      with the most masked cards)
+    exact_threshold : defaults to the number of iterations
+    seed            : seed of the sampling streams, see eval_mc()
+    return_exact    : return (ev, exact) to tell whether it was enumerated
+    """
+    game = parse_game(game)
+    i_board = parse_board(board)
+    if not is_iterable(ranges) or isinstance(ranges, basestring):
+        raise TypeError('Ranges must be a list or a tuple.')
+    i_ranges = [parse_range(r, game) for r in ranges]
+    iterations = int(iterations)
+    if exact is True:
+        exact_threshold = float('inf')
+    elif exact is False:
+        exact_threshold = 0
+    elif exact == 'auto':
+        exact_threshold = iterations if exact_threshold is None else exact_threshold
     else:
-        result = joblib.Parallel(n_jobs=n_jobs)(joblib.delayed(
-            _rayeval.eval_mc)(game, i_board, i_pockets, iterations / n_jobs)
-            for i in xrange(n_jobs))
-        return [sum(c) / float(n_jobs) for c in zip(*result)]
+        raise ValueError('Exact must be True, False or auto.')
+    ev, was_exact = _rayeval.eval_range_equity(game, i_board, i_ranges, iterations, parse_n_jobs(n_jobs),
+                                               float(exact_threshold), parse_seed(seed))
+    return (ev, was_exact) if return_exact else ev
+
 
+def eval_exact(game='holdem', board='', pockets=['', ''], n_jobs=1):
+    """
+    Exact equity of each pocket over all deals of the masked cards
+
+    n_jobs  : number of native threads, -1 to use all cores
+    """
+    game = parse_game(game)
+    i_board = parse_board(board)
+    i_pockets = parse_pockets(pockets, game)
+    n_jobs = parse_n_jobs(n_jobs)
+    cache = _equity_cache
+    if cache is not None:
+        key = cache.key(game, i_board, i_pockets)
+        ev = cache.get(key, EquityCache.EXACT)
+        if ev is not None:
+            return ev
+    ev = _rayeval.eval_exact(game, i_board, i_pockets, n_jobs)
+    if cache is not None:
+        cache.put(key, EquityCache.EXACT, ev)
+    return ev
+
+
+def count_deals(game='holdem', board='', pockets=['', '']):
+    """
+    Number of distinct deals of the masked cards, i.e. the cost of eval_exact
+    """
+    game = parse_game(game)
+    i_board = parse_board(board)
+    i_pockets = parse_pockets(pockets, game)
+    return int(_rayeval.count_deals(game, i_board, i_pockets))
 
-def eval_turn_outs_vs_random_omaha(flopBoard, pocket, iterations):
+
+def canonical_form(game='holdem', board='', pockets=['', '']):
+    """
+    Representative of the class of spots equivalent to this one under suit
+    relabelling, which have the same equities; returns (board, pockets, n)
+    with the board and every pocket sorted, masked cards last, and the number
+    of spots in the class. Equivalent spots get the same board and pockets,
+    so they can be used as a cache key.
+
+    pockets : 1-10 pockets, the order of the players is kept
+    """
+    game = parse_game(game)
+    if isinstance(pockets, basestring):
+        pockets = [pockets]
+    i_board, i_pockets, n = _rayeval.canonical_form(game, parse_board(board),
+                                                    parse_pockets(pockets, game, 1))
+    pocket_size = 2 if game == 'holdem' else 4
+    cards = lambda c: ' '.join('*' if x == 255 else rank_to_card(x) for x in c)
+    return (cards(i_board), [cards(i_pockets[i:i + pocket_size])
+                             for i in xrange(0, len(i_pockets), pocket_size)], n)
+
+
+def canonical_flops():
+    """
+    All flops up to suit relabelling, a list of (flop, n) with the number of
+    flops n in every class; the 1755 classes stand for all 22100 flops
+    """
+    flops = {}
+    for flop in itertools.combinations(range(52), 3):
+        i_board, _, n = _rayeval.canonical_form('holdem', list(flop), [255, 255])
+        flops[tuple(i_board)] = n
+    return [(' '.join(rank_to_card(c) for c in flop), n) for flop, n in sorted(flops.items())]
+
+
+def eval_turn_outs_vs_random_omaha(flopBoard, pocket, iterations, seed=None, n_jobs=1):
+    """
+    Omaha equity of a pocket against a random one on a flop and on every turn
+
+    Every sampled villain pocket and river is evaluated on all turn cards, so
+    each turn gets about as many deals as iterations, in a single pass.
+
+    flopBoard   : 3 known board cards, e.g. 'Ah Kh 2c * *'
+    iterations  : number of sampled villain pockets
+    n_jobs      : number of native threads, -1 to use all cores
+    """
     i_board = parse_board(flopBoard)
     i_pocket = parse_pocket(pocket, 'omaha')
     iterations = int(iterations)
-    cppresult = _rayeval.eval_turn_outs_vs_random_omaha(i_board, i_pocket, iterations)
+    cppresult = _rayeval.eval_turn_outs_vs_random_omaha(i_board, i_pocket, iterations, parse_seed(seed),
+                                                        parse_n_jobs(n_jobs))
+    return turn_outs_result(cppresult)
+
+
+def turn_outs_result(cppresult):
     result = {}
     result['flop_ev'] = cppresult[0]
     outs = {}
@@ -578,25 +1352,132 @@ def eval_turn_outs_vs_random_omaha(flopBoard, pocket, iterations):
     return result
 
 
-def find_first_nuts_holdem(flopBoard):
+def eval_river_outs_vs_random_omaha(flopBoard, pocket, iterations, seed=None, n_jobs=1):
+    """
+    Like eval_turn_outs_vs_random_omaha(), but every sampled villain pocket is
+    evaluated on all turn and river cards; the result has 'river_outs' too,
+    a dict of dicts of the equity by turn and river card
+
+    iterations  : number of sampled villain pockets, each costs ~800 boards
+    """
     i_board = parse_board(flopBoard)
-    cppresult = _rayeval.find_first_nuts_holdem(i_board)
-    return __card_list[cppresult[0]] + ' ' + __card_list[cppresult[1]]
+    i_pocket = parse_pocket(pocket, 'omaha')
+    return river_outs_result(_rayeval.eval_river_outs_vs_random_omaha(
+        i_board, i_pocket, int(iterations), parse_seed(seed), parse_n_jobs(n_jobs)))
+
+
+def river_outs_result(cppresult):
+    flop_ev, turn_ev, river_ev = cppresult
+    result = {'flop_ev': flop_ev, 'outs': {}, 'river_outs': {}}
+    for t in xrange(52):
+        if turn_ev[t] > -0.00001:
+            turn = rank_to_card(t)
+            result['outs'][turn] = turn_ev[t]
+            result['river_outs'][turn] = dict((rank_to_card(r), river_ev[t][r]) for r in xrange(52)
+                                              if river_ev[t][r] > -0.00001)
+    return result
+
 
+class Scenario(object):
+    """
+    A spot parsed and checked once, to be evaluated many times over
+
+    Every method takes the options of the function of the same name and gives
+    the same result for the same seed, without re-parsing the cards and, for
+    the outs, re-building the flop walk and the hero's turn and river scores.
+
+    pockets : 1-10 pockets (a single pocket for the outs queries), see eval_mc()
+    """
 
-def get_first_nuts_change_next_street(flopBoard):
+    def __init__(self, game='holdem', board='', pockets=['', '']):
+        game = parse_game(game)
+        if isinstance(pockets, basestring):
+            pockets = [pockets]
+        self._scenario = _rayeval.Scenario(game, parse_board(board), parse_pockets(pockets, game, 1))
+
+    game = property(lambda self: self._scenario.game)
+    n_players = property(lambda self: self._scenario.n_players)
+
+    def count_deals(self):
+        return int(self._scenario.n_deals)
+
+    def eval_mc(self, iterations=1e6, n_jobs=1, exact='auto', exact_threshold=None,
+                interleave=16, stratify=False, seed=None, stats=False):
+        iterations = int(iterations)
+        if exact is True and not stats:
+            return self.eval_exact(n_jobs)
+        result = self._scenario.eval_mc(iterations, parse_n_jobs(n_jobs),
+                                        parse_exact_threshold(exact, exact_threshold, iterations),
+                                        int(interleave), int(stratify), parse_seed(seed),
+                                        int(bool(stats)))
+        return mc_stats_result(result) if stats else result
+
+    def eval_mc_adaptive(self, stderr=None, half_width=None, confidence=0.95, max_iterations=1e7,
+                         n_jobs=1, interleave=16, chunk=10000, stratify=False, seed=None):
+        return self._scenario.eval_mc_adaptive(int(max_iterations),
+                                               parse_target_stderr(stderr, half_width, confidence),
+                                               parse_n_jobs(n_jobs), int(interleave), int(chunk),
+                                               int(stratify), parse_seed(seed))
+
+    def eval_exact(self, n_jobs=1):
+        return self._scenario.eval_exact(parse_n_jobs(n_jobs))
+
+    def eval_turn_outs(self, iterations, seed=None, n_jobs=1):
+        """
+        See eval_turn_outs_vs_random_omaha()
+        """
+        return turn_outs_result(self._scenario.eval_turn_outs(int(iterations), parse_seed(seed),
+                                                              parse_n_jobs(n_jobs)))
+
+    def eval_river_outs(self, iterations, seed=None, n_jobs=1):
+        """
+        See eval_river_outs_vs_random_omaha()
+        """
+        return river_outs_result(self._scenario.eval_river_outs(int(iterations), parse_seed(seed),
+                                                                parse_n_jobs(n_jobs)))
+
+
+def find_first_nuts_holdem(flopBoard):
     i_board = parse_board(flopBoard)
-    nuts = _rayeval.find_first_nuts_holdem(i_board)
+    cppresult = _rayeval.find_first_nuts_holdem(i_board)
+    return __card_list[cppresult[0]] + ' ' + __card_list[cppresult[1]]
 
-    result = {}
-    for c in __card_list:
-        i_c = card_to_rank(c)
-        if i_c in i_board: continue
 
-        turn_arr = i_board + [i_c]
-        turnnuts = _rayeval.find_first_nuts_holdem(turn_arr)
-        if turnnuts[0] != nuts[0] or turnnuts[1] != nuts[1]:
-            s = __card_list[turnnuts[0]] + ' ' + __card_list[turnnuts[1]]
-            result[c] = s
+def find_nuts(game='holdem', board='', next_street=False, n_jobs=1):
+    """
+    Returns the first pocket (in the order of the cards) that makes the nuts
+    on the board, and with next_street a dict of the nuts with every card that
+    can come next too, e.g. ('Qh Jh', {'2c': 'Kh Qh', ...})
 
-    return result
\ No newline at end of file
+    board   : 3-5 known cards
+    n_jobs  : number of native threads for the next street cards, -1 to use all cores
+    """
+    game = parse_game(game)
+    i_board = parse_board(board)
+    pocket, score, next_nuts = _rayeval.find_nuts(game, i_board, int(next_street), parse_n_jobs(n_jobs))
+    nuts = ' '.join(rank_to_card(c) for c in pocket)
+    if not next_street:
+        return nuts
+    next_map = {}
+    for c, item in enumerate(next_nuts or []):
+        if item is not None:
+            next_map[rank_to_card(c)] = ' '.join(rank_to_card(i) for i in item[0])
+    return nuts, next_map
+
+
+def get_first_nuts_change_next_street(flopBoard, game='holdem'):
+    if parse_game(game) == 'holdem' and handranks_backing(7) == 'none':
+        # the Cactus Kev search of find_first_nuts_holdem(), one turn card at a time
+        i_board = parse_board(flopBoard)
+        nuts = _rayeval.find_first_nuts_holdem(i_board)
+        result = {}
+        for c in __card_list:
+            i_c = card_to_rank(c)
+            if i_c in i_board:
+                continue
+            turn_nuts = _rayeval.find_first_nuts_holdem(i_board + [i_c])
+            if turn_nuts[0] != nuts[0] or turn_nuts[1] != nuts[1]:
+                result[c] = __card_list[turn_nuts[0]] + ' ' + __card_list[turn_nuts[1]]
+        return result
+    nuts, next_map = find_nuts(game, flopBoard, next_street=True)
+    return dict((c, p) for c, p in next_map.items() if p != nuts)
\ No newline at end of file
@@ -16,8 +16,8 @@ if platform.system() == 'Darwin':
     extra_compile_args = ['-O3', '-msse4', '-fPIC', '-g', '-gdwarf-2', '-stdlib=libstdc++']
     extra_link_args = ['-O3', '-msse4', '-fPIC', '-g', '-gdwarf-2', '-stdlib=libstdc++']
 else:
-    extra_compile_args = ['-O3', '-msse4', '-fPIC', '-g', '-gdwarf-2']
-    extra_link_args = ['-O3', '-msse4', '-fPIC', '-g', '-gdwarf-2']
+    extra_compile_args = ['-O3', '-msse4', '-fPIC', '-g', '-gdwarf-2', '-pthread']
+    extra_link_args = ['-O3', '-msse4', '-fPIC', '-g', '-gdwarf-2', '-pthread', '-lrt']
 
 
 INSTALL_LIB_PATH = ''
@@ -29,7 +29,10 @@ ARGV_OPTIONS = {
     'hand_ranks_7_file_name': 'rayeval_hand_ranks_7.dat',
     'hand_ranks_9_file_name': 'rayeval_hand_ranks_9.dat',
     'use_ranks_7': None,
-    'use_ranks_9': None
+    'use_ranks_9': None,
+    'ranks_test_samples': 0,
+    'ranks_test_shard': (0, 1),
+    'reorder_ranks': False
 }
 GENERATE_HAND_RANKS = False
 
@@ -38,6 +41,8 @@ filtered_args = []
 for arg in sys.argv:
     if arg == '--no-ranks-test':
         ARGV_OPTIONS['no_ranks_test'] = True
+    elif arg == '--reorder-ranks':
+        ARGV_OPTIONS['reorder_ranks'] = True
     elif arg == '--without-build-ranks':
         ARGV_OPTIONS['without_build_ranks'] = True
     elif arg.startswith('--ranks-dir'):
@@ -50,6 +55,10 @@ for arg in sys.argv:
         ARGV_OPTIONS['use_ranks_7'] = arg.split('=')[1]
     elif arg.startswith('--use-ranks-9'):
         ARGV_OPTIONS['use_ranks_9'] = arg.split('=')[1]
+    elif arg.startswith('--ranks-test-samples'):
+        ARGV_OPTIONS['ranks_test_samples'] = int(float(arg.split('=')[1]))
+    elif arg.startswith('--ranks-test-shard'):
+        ARGV_OPTIONS['ranks_test_shard'] = tuple(map(int, arg.split('=')[1].split('/')))
     else:
         filtered_args.append(arg)
 
@@ -84,7 +93,15 @@ def build_and_install_ranks():
         rayeval_module.generate_handranks_7(ranks_7_path, not ARGV_OPTIONS['no_ranks_test'])
 
     if GENERATE_HAND_RANKS and ARGV_OPTIONS['use_ranks_9'] is None:
-        rayeval_module.generate_handranks_9(ranks_9_path, ranks_7_path, not ARGV_OPTIONS['no_ranks_test'])
+        full_test = ARGV_OPTIONS['ranks_test_samples'] == 0 and ARGV_OPTIONS['ranks_test_shard'] == (0, 1)
+        test = not ARGV_OPTIONS['no_ranks_test']
+        rayeval_module.generate_handranks_9(ranks_9_path, ranks_7_path, test and full_test,
+                                            reorder=ARGV_OPTIONS['reorder_ranks'])
+        if test and not full_test:
+            shard, n_shards = ARGV_OPTIONS['ranks_test_shard']
+            if not rayeval_module.test_handranks_9(ranks_9_path, ranks_7_path, samples=ARGV_OPTIONS['ranks_test_samples'],
+                                                   shard=shard, n_shards=n_shards):
+                raise RuntimeError("Hand ranks [9] verification failed.")
 
     if GENERATE_HAND_RANKS or ARGV_OPTIONS['use_ranks_7'] is not None or ARGV_OPTIONS['use_ranks_9'] is not None:
         f = open(resource_filename('rayeval', "__rayeval_ranks_path__.txt"), 'w')
@@ -131,7 +148,6 @@ setup(name='rayeval',
       author='Aldanor',
       author_email='i.s.smirnov@gmail.com',
       url='https://github.com/WhatMatters/ray_eval',
-      install_requires=['joblib'],
       packages=find_packages(),
       package_data = {'rayeval': ['rayeval/__rayeval_ranks_path__.txt']},
       data_files=[('shared', [':hand_ranks'])],
@@ -142,7 +158,9 @@ setup(name='rayeval',
                         'src/arrays.cpp',
                         'src/rayutils.cpp',
                         'src/raygen7.cpp',
-                        'src/raygen9.cpp'],
+                        'src/raygen9.cpp',
+                        'src/raythreads.cpp',
+                        'src/raysimd.cpp'],
                     extra_compile_args=extra_compile_args,
                     extra_link_args=extra_link_args)
       ],
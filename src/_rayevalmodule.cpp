@@ -2,19 +2,242 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 #include <iostream>
 
 #include <Python.h>
 
 #include "rayutils.h"
+#include "arrays.h"
 #include "raygen7.h"
 #include "raygen9.h"
+#include "raythreads.h"
+#include "raysimd.h"
 
 int *HR = 0, *HR9 = 0;
+int HR_backing = BACKING_NONE, HR9_backing = BACKING_NONE;
+hr9c_t HR9C; // only valid if HR9_compact is set
+int HR9_compact = 0;
+int HR9_generation = 0; // bumped whenever HR9 changes, for the walk states cached off it
+
+// native code walking HR or HR9 without the GIL (around Py_BEGIN_ALLOW_THREADS 
+// or in a background run); the tables can't be detached while there is any
+volatile int TABLE_users = 0;
+#define TABLES_ACQUIRE() __sync_add_and_fetch(&TABLE_users, 1)
+#define TABLES_RELEASE() __sync_sub_and_fetch(&TABLE_users, 1)
+int *PREFLOP = 0; // preflop equity tables, see generate_preflop_tables()
+int PREFLOP_backing = BACKING_NONE;
+
+// to be called whenever HR9 changes
+void update_hr9_layout()
+{
+	HR9_compact = !hr9c_layout(HR9, &HR9C);
+	HR9_generation++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							INSTRUMENTATION
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+	Counters of what the module spends its time on, off by default and read 
+	through stats(). When on, every entry point counts its calls and wall
+	time, the evaluation loops count their deals and hand evaluations, and 
+	the Monte Carlo loops time the sampling and the table walks of one deal
+	(or interleaved batch) in every STATS_TIMING_STRIDE and scale that up to 
+	all of them. When off, what's left is a test of STATS_enabled per call and per
+	batch. The counters are updated atomically at the end of every loop, so
+	they are exact across threads. Hardware counters (cache and dTLB misses
+	in user space) come from perf_event on linux; they count the threads 
+	started after they are enabled (run_threads() workers, not the pool).
+*/
+
+#define STATS_EVAL_HAND			0
+#define STATS_EVAL_HANDS_BATCH	1
+#define STATS_EVAL_MC			2
+#define STATS_EVAL_MC_BATCH		3
+#define STATS_EVAL_MC_ASYNC		4
+#define STATS_EVAL_MC_ADAPTIVE	5
+#define STATS_EVAL_EXACT		6
+#define STATS_EVAL_RANGE_EQUITY	7
+#define STATS_EVAL_OUTS			8
+#define STATS_FIND_NUTS			9
+#define STATS_CLASSIFY_HAND		10
+#define STATS_PREFLOP_EQUITY	11
+#define STATS_CACHE				12
+#define STATS_SCENARIO			13
+#define STATS_ENTRIES			14
+
+#define STATS_TIMING_STRIDE		16	// deals per timed one in the Monte Carlo loops
+#define STATS_HW_COUNTERS		2	// cache and dTLB read misses
+
+static const char *stats_entry_names[STATS_ENTRIES] = {
+	"eval_hand", "eval_hands_batch", "eval_mc", "eval_mc_batch", "eval_mc_async", 
+	"eval_mc_adaptive", "eval_exact", "eval_range_equity", "eval_outs", "find_nuts", 
+	"classify_hand", "preflop_equity", "cache", "scenario"
+};
+
+typedef struct {
+	uint64_t calls[STATS_ENTRIES], ns[STATS_ENTRIES];
+	uint64_t deals, evaluations;
+	uint64_t timed_deals, sample_ns, walk_ns; // the last two scaled up to all deals
+} stats_counters;
+
+int STATS_enabled = 0;
+stats_counters STATS;
+double STATS_load_seconds[2] = {0.0, 0.0}; // of the 7- and 9-card tables, kept even when off
+int STATS_hw_fd[STATS_HW_COUNTERS] = {-1, -1};
+
+static inline uint64_t stats_clock()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+// counts a call of an entry point and its time, for as long as it is in scope
+struct stats_scope {
+	int entry;
+	uint64_t start;
+	stats_scope(int entry) : entry(entry), start(STATS_enabled ? stats_clock() : 0) {}
+	~stats_scope()
+	{
+		if (!start)
+			return;
+		__sync_add_and_fetch(&STATS.calls[entry], 1ULL);
+		__sync_add_and_fetch(&STATS.ns[entry], stats_clock() - start);
+	}
+};
+
+// the sampling and walking times of the deals a loop has timed so far
+typedef struct {
+	int timed, n_batches;
+	uint64_t t0, t1, sample_ns, walk_ns, n_timed;
+} stats_timer;
+
+static inline void stats_timer_init(stats_timer *st)
+{
+	memset(st, 0, sizeof(stats_timer));
+}
+
+// a batch is one deal, or one interleaved group of them
+static inline void stats_timer_start(stats_timer *st)
+{
+	if ((st->timed = STATS_enabled && (st->n_batches++ % STATS_TIMING_STRIDE) == 0))
+		st->t0 = stats_clock();
+}
+
+// the deals are sampled, their walks start
+static inline void stats_timer_split(stats_timer *st)
+{
+	if (st->timed)
+		st->t1 = stats_clock();
+}
+
+static inline void stats_timer_stop(stats_timer *st, int n_deals)
+{
+	if (!st->timed)
+		return;
+	st->sample_ns += st->t1 - st->t0;
+	st->walk_ns += stats_clock() - st->t1;
+	st->n_timed += n_deals;
+}
+
+// st may be NULL for the loops that aren't timed
+static void stats_add_deals(const stats_timer *st, uint64_t deals, int n_players)
+{
+	if (!STATS_enabled)
+		return;
+	__sync_add_and_fetch(&STATS.deals, deals);
+	__sync_add_and_fetch(&STATS.evaluations, deals * n_players);
+	if (st && st->n_timed)
+	{
+		double scale = (double) deals / st->n_timed;
+		__sync_add_and_fetch(&STATS.timed_deals, st->n_timed);
+		__sync_add_and_fetch(&STATS.sample_ns, (uint64_t) (st->sample_ns * scale));
+		__sync_add_and_fetch(&STATS.walk_ns, (uint64_t) (st->walk_ns * scale));
+	}
+}
+
+static void stats_add_evaluations(uint64_t n)
+{
+	if (STATS_enabled)
+		__sync_add_and_fetch(&STATS.evaluations, n);
+}
+
+static void stats_hw_close()
+{
+	for (int i = 0; i < STATS_HW_COUNTERS; i++)
+		if (STATS_hw_fd[i] != -1)
+		{
+			close(STATS_hw_fd[i]);
+			STATS_hw_fd[i] = -1;
+		}
+}
+
+// returns 0 if the counters are counting, they are left closed otherwise
+static int stats_hw_open()
+{
+#ifdef __linux__
+	static const uint32_t types[STATS_HW_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+	static const uint64_t configs[STATS_HW_COUNTERS] = {
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+	};
+	if (STATS_hw_fd[0] != -1)
+		return 0;
+	for (int i = 0; i < STATS_HW_COUNTERS; i++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[i];
+		attr.config = configs[i];
+		attr.inherit = 1; // threads started from now on count too
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		STATS_hw_fd[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if (STATS_hw_fd[i] == -1)
+		{
+			stats_hw_close();
+			return -1;
+		}
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static void stats_hw_read(uint64_t *values)
+{
+	for (int i = 0; i < STATS_HW_COUNTERS; i++)
+		if (STATS_hw_fd[i] == -1 || read(STATS_hw_fd[i], &values[i], sizeof(uint64_t)) != sizeof(uint64_t))
+			values[i] = 0;
+}
+
+static void stats_reset()
+{
+	memset(&STATS, 0, sizeof(STATS));
+#ifdef __linux__
+	for (int i = 0; i < STATS_HW_COUNTERS; i++)
+		if (STATS_hw_fd[i] != -1)
+			ioctl(STATS_hw_fd[i], PERF_EVENT_IOC_RESET, 0);
+#endif
+}
 
 void extract_cards(uint64_t *deck, int card)
 {
@@ -94,13 +317,115 @@ void find_first_nuts_holdem(int *board, int n_board, int *result_pocket)
 	}
 }
 
+// 0-51 cards, 5-7 in total
+int eval_hand_holdem(int *board, int n_board, int *pocket, int n_pocket)
+{
+	int i, value = 53;
+	for (i = 0; i < n_board; i++)
+		value = HR[value + board[i] + 1];
+	for (i = 0; i < n_pocket; i++)
+		value = HR[value + pocket[i] + 1];
+	if (n_board + n_pocket < 7)
+		value = HR[value];
+	return value;
+}
+
+// 0-51 cards, 3-5 board cards and 4 pocket cards
+int eval_hand_omaha(int *board, int n_board, int *pocket)
+{
+	int i, value, fs = 106, snf = HR9[0] + 53, fo = HR9[1] + 56;
+	if (HR9_compact)
+	{
+		int cards[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+		for (i = 0; i < n_board; i++)
+			cards[5 - n_board + i] = board[i] + 1;
+		for (i = 0; i < 4; i++)
+			cards[5 + i] = pocket[i] + 1;
+		return eval_hr9c(&HR9C, cards);
+	}
+	if (n_board < 5) { fs = HR9[fs]; snf = HR9[snf]; fo = HR9[fo]; }
+	if (n_board < 4) { fs = HR9[fs]; snf = HR9[snf]; fo = HR9[fo]; }
+	for (i = 0; i < n_board; i++)
+	{
+		fs = HR9[fs + board[i] + 1]; 
+		snf = HR9[snf + board[i] + 1];
+	}
+	for (i = 0; i < 4; i++)
+	{
+		fs = HR9[fs + pocket[i] + 1];
+		snf = HR9[snf + pocket[i] + 1];
+	}
+	value = snf;
+	if (fs != 0)
+	{
+		int *HR9_f = HR9 + (4 - fs);
+		int flush_score = fo;
+		for (i = 0; i < n_board; i++)
+			flush_score = HR9_f[flush_score + board[i] + 1]; 
+		for (i = 0; i < 4; i++)
+			flush_score = HR9_f[flush_score + pocket[i] + 1];
+		value = (flush_score > value) ? flush_score : value;
+	}
+	return value;
+}
+
+// With stratification the first masked board card (the turn on a flop, the
+// river on a turn) isn't drawn at random but goes through all the available
+// cards in turn from a random start, so every run-out card gets its share of
+// the deals; the other masked cards are drawn at random from the rest.
+static inline int first_stratum(int stratify, int n_mask, const int *mask, int n_board, 
+	int n_available, rng_t *rng)
+{
+	return (stratify && n_mask > 0 && mask[0] < n_board) ? (int) rng_bounded(rng, n_available) : -1;
+}
+
+// draws the masked cards of a deal, stratum is -1 for plain sampling
+static inline void sample_deal(int n_available, int n_mask, int *sample, int *stratum, rng_t *rng)
+{
+	if (*stratum < 0)
+		random_sample_52_ross(n_available, n_mask, sample, rng);
+	else
+	{
+		random_sample_52_stratified(n_available, n_mask, *stratum, sample, rng);
+		if (++*stratum == n_available)
+			*stratum = 0;
+	}
+}
+
+// Optional tallies of the same deals as the equities: deals won outright, deals
+// split and the final hand category of every player (the rank bits >> 12).
+// The loops add up deal counts, the callers turn them into shares of the deals.
+typedef struct {
+	double win[MAX_PLAYERS], tie[MAX_PLAYERS];
+	double category[MAX_PLAYERS][10];
+	double std_err[MAX_PLAYERS]; // of the equities, 0 when enumerated
+	double n_deals;
+} mc_stats;
+
+static inline void mc_stats_add(mc_stats *stats, const int *scores, int n_players, 
+	int best_score, int tied, double weight)
+{
+	for (int k = 0; k < n_players; k++)
+	{
+		stats->category[k][scores[k] >> 12] += weight;
+		if (scores[k] == best_score)
+			*((tied == 1) ? &stats->win[k] : &stats->tie[k]) += weight;
+	}
+	stats->n_deals += weight;
+}
+
 int eval_monte_carlo_holdem(int N, int *board, int n_board, 
-	int *pocket, int n_players, double *ev)
+	int *pocket, int n_players, double *ev, rng_t *rng, double *ev2 = NULL, int stratify = 0,
+	mc_stats *stats = NULL)
 {
 	int mask[52], cards[52], n_cards = 0, n_mask = 0, n_available, i, j, k;
 	memset(mask, 0, 52 * sizeof(int));
 	memset(cards, 0, 52 * sizeof(int));
 	memset(ev, 0, n_players * sizeof(double));
+	if (ev2)
+		memset(ev2, 0, n_players * sizeof(double));
+	if (stats)
+		memset(stats, 0, sizeof(mc_stats));
 	uint64_t deck = new_deck();
 	int available_cards[52];
 	if (n_board != 3 && n_board != 4 && n_board != 5)
@@ -123,12 +448,17 @@ int eval_monte_carlo_holdem(int N, int *board, int n_board,
 	}
 	n_available = 52 - n_board - 2 * n_players + n_mask;
 	get_cards(deck, available_cards, 1); // convert 0-51 to 1-52
+	int stratum = first_stratum(stratify, n_mask, mask, n_board, n_available, rng);
+	stats_timer st;
+	stats_timer_init(&st);
 	for (i = 0; i < N; i++)
 	{
 		int sample[52], scores[MAX_PLAYERS], best_score = -1, tied = 0;
-		random_sample_52_ross(n_available, n_mask, sample);
+		stats_timer_start(&st);
+		sample_deal(n_available, n_mask, sample, &stratum, rng);
 		for (j = 0; j < n_mask; j++)
 			cards[mask[j]] = available_cards[sample[j]];
+		stats_timer_split(&st);
 		int path = 53;
 		for (j = 0; j < n_board; j++)
 			path = HR[path + cards[j]];
@@ -136,6 +466,8 @@ int eval_monte_carlo_holdem(int N, int *board, int n_board,
 		for (k = 0; k < n_players; k++)
 		{
 			int score = HR[HR[path + player_cards[0]] + player_cards[1]];
+			if (n_board < 5)
+				score = HR[score]; // 5- and 6-card ranks are kept in the zero slot
 			scores[k] = score;
 			if (score > best_score)
 			{
@@ -149,24 +481,172 @@ int eval_monte_carlo_holdem(int N, int *board, int n_board,
 		double delta_ev = 1.0 / tied;
 		for (k = 0; k < n_players; k++)
 			if (scores[k] == best_score)
+			{
+				ev[k] += delta_ev;
+				if (ev2)
+					ev2[k] += delta_ev * delta_ev;
+			}
+		if (stats)
+			mc_stats_add(stats, scores, n_players, best_score, tied, 1.0);
+		stats_timer_stop(&st, 1);
+	}
+	stats_add_deals(&st, N, n_players);
+	for (k = 0; k < n_players; k++)
+	{
+		ev[k] /= (double)N;
+		if (ev2)
+			ev2[k] /= (double)N;
+	}
+	return 0;
+}
+
+// the same as eval_monte_carlo_omaha() on a compact 9-card table
+int eval_monte_carlo_omaha_compact(int N, int *board, int n_board, 
+	int *pocket, int n_players, double *ev, rng_t *rng, double *ev2 = NULL, int stratify = 0,
+	mc_stats *stats = NULL)
+{
+	int mask[52], cards[52], n_cards = 0, n_mask = 0, n_available, i, j, k;
+	memset(mask, 0, 52 * sizeof(int));
+	memset(cards, 0, 52 * sizeof(int));
+	memset(ev, 0, n_players * sizeof(double));
+	if (ev2)
+		memset(ev2, 0, n_players * sizeof(double));
+	if (stats)
+		memset(stats, 0, sizeof(mc_stats));
+	uint64_t deck = new_deck();
+	int available_cards[52];
+	if (n_board != 3 && n_board != 4 && n_board != 5)
+		return 1;
+	const int *nfs = HR9C.nodes[HR9C_FLUSH_SUITS], *nnf = HR9C.nodes[HR9C_NO_FLUSH],
+		*nfr = HR9C.nodes[HR9C_FLUSH_RANKS];
+	const uint16_t *lfs = HR9C.leaves[HR9C_FLUSH_SUITS], *lnf = HR9C.leaves[HR9C_NO_FLUSH],
+		*lfr = HR9C.leaves[HR9C_FLUSH_RANKS];
+	int fs_offset = HR9C.root[HR9C_FLUSH_SUITS], snf_offset = HR9C.root[HR9C_NO_FLUSH],
+		flush_offset = HR9C.root[HR9C_FLUSH_RANKS];
+	for (i = n_board; i < 5; i++)
+	{
+		// skipped board cards
+		fs_offset = nfs[fs_offset];
+		snf_offset = nnf[snf_offset];
+		flush_offset = nfr[flush_offset];
+	}
+	for (i = 0; i < n_board; i++)
+	{
+		if (board[i] == 255)
+			mask[n_mask++] = n_cards;
+		else
+			extract_cards(&deck, board[i]);
+		cards[n_cards++] = board[i] + 1; // convert 0-51 to 1-52
+	}
+	for (i = 0; i < 4 * n_players; i++)
+	{
+		if (pocket[i] == 255)
+			mask[n_mask++] = n_cards;
+		else
+			extract_cards(&deck, pocket[i]);
+		cards[n_cards++] = pocket[i] + 1; // convert 0-51 to 1-52
+	}
+	n_available = 52 - n_board - 4 * n_players + n_mask;
+	get_cards(deck, available_cards, 1); // convert 0-51 to 1-52
+	int stratum = first_stratum(stratify, n_mask, mask, n_board, n_available, rng);
+	stats_timer st;
+	stats_timer_init(&st);
+	for (i = 0; i < N; i++)
+	{
+		int sample[52], scores[MAX_PLAYERS], best_score = -1, tied = 0;
+		int flush_board[5] = {-1, -1, -1, -1, -1};
+		stats_timer_start(&st);
+		sample_deal(n_available, n_mask, sample, &stratum, rng);
+		for (j = 0; j < n_mask; j++)
+			cards[mask[j]] = available_cards[sample[j]];
+		stats_timer_split(&st);
+		int board_fs = fs_offset;
+		int board_snf = snf_offset;
+		for (j = 0; j < n_board; j++)
+		{
+			board_fs = nfs[board_fs + hr9c_suit_class[cards[j]]];
+			board_snf = nnf[board_snf + hr9c_rank_class[cards[j]]];
+		}
+		int *player_cards = cards + n_board;
+		for (k = 0; k < n_players; k++)
+		{
+			int fs = board_fs;
+			int score = board_snf;
+			for (j = 0; j < 3; j++)
+			{
+				fs = nfs[fs + hr9c_suit_class[player_cards[j]]];
+				score = nnf[score + hr9c_rank_class[player_cards[j]]];
+			}
+			fs = lfs[fs + hr9c_suit_class[player_cards[3]]];
+			score = lnf[score + hr9c_rank_class[player_cards[3]]];
+			if (fs != 0)
+			{
+				const unsigned char *flush_class = hr9c_flush_class[fs];
+				int sf = flush_board[fs];
+				if (sf == -1)
+				{
+					sf = flush_offset;
+					for (j = 0; j < n_board; j++)
+						sf = nfr[sf + flush_class[cards[j]]];
+					flush_board[fs] = sf;
+				}
+				for (j = 0; j < 3; j++)
+					sf = nfr[sf + flush_class[player_cards[j]]];
+				sf = lfr[sf + flush_class[player_cards[3]]];
+				score = MAX(score, sf);
+			}
+			
+			scores[k] = score;
+			if (score > best_score)
+			{
+				best_score = score;
+				tied = 1;
+			}
+			else if (score == best_score)
+				tied++;
+			player_cards += 4;
+		}
+		double delta_ev = 1.0 / tied;
+		for (k = 0; k < n_players; k++)
+			if (scores[k] == best_score)
+			{
 				ev[k] += delta_ev;
+				if (ev2)
+					ev2[k] += delta_ev * delta_ev;
+			}
+		if (stats)
+			mc_stats_add(stats, scores, n_players, best_score, tied, 1.0);
+		stats_timer_stop(&st, 1);
 	}
+	stats_add_deals(&st, N, n_players);
 	for (k = 0; k < n_players; k++)
+	{
 		ev[k] /= (double)N;
+		if (ev2)
+			ev2[k] /= (double)N;
+	}
 	return 0;
 }
 
 int eval_monte_carlo_omaha(int N, int *board, int n_board, 
-	int *pocket, int n_players, double *ev)
+	int *pocket, int n_players, double *ev, rng_t *rng, double *ev2 = NULL, int stratify = 0,
+	mc_stats *stats = NULL)
 {
 	int mask[52], cards[52], n_cards = 0, n_mask = 0, n_available, i, j, k;
 	memset(mask, 0, 52 * sizeof(int));
 	memset(cards, 0, 52 * sizeof(int));
 	memset(ev, 0, n_players * sizeof(double));
+	if (ev2)
+		memset(ev2, 0, n_players * sizeof(double));
+	if (stats)
+		memset(stats, 0, sizeof(mc_stats));
 	uint64_t deck = new_deck();
 	int available_cards[52];
 	if (n_board != 3 && n_board != 4 && n_board != 5)
 		return 1;
+	if (HR9_compact)
+		return eval_monte_carlo_omaha_compact(N, board, n_board, pocket, n_players, ev, rng, ev2, stratify, 
+			stats);
 	int fs_offset = (n_board == 5) ? 106 : ((n_board == 4) ? HR9[106] : HR9[HR9[106]]);
 	int snf_offset = (n_board == 5) ? (HR9[0] + 53) : 
 		((n_board == 4) ? HR9[HR9[0] + 53] : HR9[HR9[HR9[0] + 53]]);
@@ -190,13 +670,18 @@ int eval_monte_carlo_omaha(int N, int *board, int n_board,
 	}
 	n_available = 52 - n_board - 4 * n_players + n_mask;
 	get_cards(deck, available_cards, 1); // convert 0-51 to 1-52
+	int stratum = first_stratum(stratify, n_mask, mask, n_board, n_available, rng);
+	stats_timer st;
+	stats_timer_init(&st);
 	int *HR9_f;
 	for (i = 0; i < N; i++)
 	{
 		int sample[52], scores[MAX_PLAYERS], best_score = -1, tied = 0;
-		random_sample_52_ross(n_available, n_mask, sample);
+		stats_timer_start(&st);
+		sample_deal(n_available, n_mask, sample, &stratum, rng);
 		for (j = 0; j < n_mask; j++)
 			cards[mask[j]] = available_cards[sample[j]];
+		stats_timer_split(&st);
 		int board_fs = fs_offset;
 		int board_snf = snf_offset;
 		for (j = 0; j < n_board; j++)
@@ -238,529 +723,4986 @@ int eval_monte_carlo_omaha(int N, int *board, int n_board,
 		double delta_ev = 1.0 / tied;
 		for (k = 0; k < n_players; k++)
 			if (scores[k] == best_score)
+			{
 				ev[k] += delta_ev;
+				if (ev2)
+					ev2[k] += delta_ev * delta_ev;
+			}
+		if (stats)
+			mc_stats_add(stats, scores, n_players, best_score, tied, 1.0);
+		stats_timer_stop(&st, 1);
 	}
+	stats_add_deals(&st, N, n_players);
 	for (k = 0; k < n_players; k++)
+	{
 		ev[k] /= (double)N;
+		if (ev2)
+			ev2[k] /= (double)N;
+	}
 	return 0;
 }
 
-static int pocket_perms[2][6] = {{0, 0, 0, 1, 1, 2}, {1, 2, 3, 2, 3, 3}};
-static int n_pocket_perms = 6;
-static int board_perms[10][3] = {
-	{0, 1, 2}, // 3, 4, 5
-	{0, 1, 3}, {0, 2, 3}, {1, 2, 3}, // 4, 5
-	{0, 1, 4}, {0, 2, 4}, {0, 3, 4}, {1, 2, 4}, {1, 3, 4}, {2, 3, 4}}; // 5
+// The interleaved versions of the Monte Carlo loops below sample K deals
+// at once and walk them in lockstep, one card at a time: as soon as a walk
+// knows its next block, the lookup into it is prefetched and the other walks
+// are advanced meanwhile, so up to K * n_players cache misses are in flight
+// instead of one. With AVX2 or AVX-512 the pocket steps of all the walks are
+// done as gathers instead (see raysimd.cpp). The deals are sampled and 
+// tallied in the same order as in the scalar loops, so all of them give the
+// same results for the same stream.
 
-// naive old method, left here for reference
-int eval_monte_carlo_omaha_old(int N, int *board, int n_board, 
-	int *pocket, int n_players, double *ev)
+int eval_monte_carlo_holdem_interleaved(int N, int *board, int n_board, 
+	int *pocket, int n_players, double *ev, rng_t *rng, int K, double *ev2 = NULL, int stratify = 0,
+	mc_stats *stats = NULL)
 {
-	int n_board_perms = n_board == 5 ? 10 : n_board == 4 ? 4 : n_board == 3 ? 1 : -1;
-	if (n_board_perms == -1)
-		return 1;
-
-	int mask[52], cards[52], n_mask = 0, n_available, 
-		i, available_cards[52], sample[52];
-
+	int mask[52], cards[52], n_cards = 0, n_mask = 0, n_available, i, j, k, t, w;
 	memset(mask, 0, 52 * sizeof(int));
 	memset(cards, 0, 52 * sizeof(int));
 	memset(ev, 0, n_players * sizeof(double));
+	if (ev2)
+		memset(ev2, 0, n_players * sizeof(double));
+	if (stats)
+		memset(stats, 0, sizeof(mc_stats));
 	uint64_t deck = new_deck();
-
+	int available_cards[52];
+	if (n_board != 3 && n_board != 4 && n_board != 5)
+		return 1;
+	K = MAX(1, MIN(K, MC_MAX_INTERLEAVE));
 	for (i = 0; i < n_board; i++)
 	{
 		if (board[i] == 255)
-			mask[n_mask++] = i;
+			mask[n_mask++] = n_cards;
 		else
 			extract_cards(&deck, board[i]);
-		cards[i] = board[i] + 1; // convert 0-51 to 1-52
+		cards[n_cards++] = board[i] + 1; // convert 0-51 to 1-52
 	}
-	for (i = 0; i < 4 * n_players; i++)
+	for (i = 0; i < 2 * n_players; i++)
 	{
 		if (pocket[i] == 255)
-			mask[n_mask++] = n_board + i;
+			mask[n_mask++] = n_cards;
 		else
 			extract_cards(&deck, pocket[i]);
-		cards[n_board + i] = pocket[i] + 1; // convert 0-51 to 1-52
+		cards[n_cards++] = pocket[i] + 1; // convert 0-51 to 1-52
 	}
-
-	n_available = 52 - n_board - 4 * n_players + n_mask;
+	n_available = 52 - n_board - 2 * n_players + n_mask;
 	get_cards(deck, available_cards, 1); // convert 0-51 to 1-52
-
-	for (i = 0; i < N; ++i)
+	int stratum = first_stratum(stratify, n_mask, mask, n_board, n_available, rng);
+	stats_timer st;
+	stats_timer_init(&st);
+	int deal[MC_MAX_INTERLEAVE][52], path[MC_MAX_INTERLEAVE];
+	int score[MC_MAX_INTERLEAVE * MAX_PLAYERS], column[MC_MAX_INTERLEAVE * MAX_PLAYERS];
+	int gather = (simd_level() != SIMD_SCALAR);
+	for (i = 0; i < N; i += K)
 	{
-		int best_score = 0;
-		int tied = 0;
-		random_sample_52_ross(n_available, n_mask, sample);
-		int j = 0, nb = 0, np = 0;
-		for (j = 0; j < n_mask; ++j)
-			cards[mask[j]] = available_cards[sample[j]];
-		int *player_cards = cards + n_board;
-		int board_paths[10];
-		for (nb = 0; nb < n_board_perms; nb++)
-			board_paths[nb] = HR[HR[HR[53 + 
-				cards[board_perms[nb][0]]] + 
-					cards[board_perms[nb][1]]] + 
-						cards[board_perms[nb][2]]];
-		int scores[MAX_PLAYERS];
-		for (j = 0; j < n_players; ++j)
+		int n_trials = MIN(K, N - i), n_walks = n_trials * n_players;
+		stats_timer_start(&st);
+		for (t = 0; t < n_trials; t++)
 		{
-			int score = 0;
-			for (nb = 0; nb < n_board_perms; ++nb)
-				for (np = 0; np < n_pocket_perms; ++np)
-					// Aldanor: don't forget to use extra HR[...] for 5/6-card eval
-					score = MAX(score, HR[HR[HR[board_paths[nb] + 
-						player_cards[pocket_perms[0][np]]] + 
-							player_cards[pocket_perms[1][np]]]]);
-			scores[j] = score;
-			if (score > best_score)
+			int sample[52];
+			sample_deal(n_available, n_mask, sample, &stratum, rng);
+			memcpy(deal[t], cards, n_cards * sizeof(int));
+			for (j = 0; j < n_mask; j++)
+				deal[t][mask[j]] = available_cards[sample[j]];
+			path[t] = 53;
+		}
+		stats_timer_split(&st);
+		for (j = 0; j < n_board; j++)
+			for (t = 0; t < n_trials; t++)
 			{
-				best_score = score;
-				tied = 1;
+				path[t] = HR[path[t] + deal[t][j]];
+				PREFETCH(HR + path[t] + deal[t][j + 1]);
+			}
+		if (gather)
+		{
+			for (j = 0; j < 2; j++)
+			{
+				for (w = 0, t = 0; t < n_trials; t++)
+					for (k = 0; k < n_players; k++, w++)
+					{
+						if (j == 0)
+							score[w] = path[t];
+						column[w] = deal[t][n_board + 2 * k + j];
+					}
+				gather_step(HR, score, column, n_walks);
+			}
+			if (n_board < 5)
+			{
+				memset(column, 0, n_walks * sizeof(int));
+				gather_step(HR, score, column, n_walks);
 			}
-			else if (score == best_score)
-				tied++;
-			player_cards += 4;
 		}
-		double delta_ev = 1.0 / tied;
-		for (j = 0; j < n_players; j++)
-			if (scores[j] == best_score)
-				ev[j] += delta_ev;
-	}
-	for (i = 0; i < n_players; ++i)
+		else
+		{
+			for (w = 0, t = 0; t < n_trials; t++)
+				for (k = 0; k < n_players; k++, w++)
+				{
+					score[w] = HR[path[t] + deal[t][n_board + 2 * k]];
+					PREFETCH(HR + score[w] + deal[t][n_board + 2 * k + 1]);
+				}
+			for (w = 0, t = 0; t < n_trials; t++)
+				for (k = 0; k < n_players; k++, w++)
+				{
+					score[w] = HR[score[w] + deal[t][n_board + 2 * k + 1]];
+					if (n_board < 5)
+						PREFETCH(HR + score[w]);
+				}
+			if (n_board < 5)
+				for (w = 0; w < n_walks; w++)
+					score[w] = HR[score[w]]; // 5- and 6-card ranks are kept in the zero slot
+		}
+		for (w = 0, t = 0; t < n_trials; t++, w += n_players)
+		{
+			int best_score = -1, tied = 0;
+			for (k = 0; k < n_players; k++)
+			{
+				if (score[w + k] > best_score)
+				{
+					best_score = score[w + k];
+					tied = 1;
+				}
+				else if (score[w + k] == best_score)
+					tied++;
+			}
+			double delta_ev = 1.0 / tied;
+			for (k = 0; k < n_players; k++)
+				if (score[w + k] == best_score)
+				{
+					ev[k] += delta_ev;
+					if (ev2)
+						ev2[k] += delta_ev * delta_ev;
+				}
+			if (stats)
+				mc_stats_add(stats, score + w, n_players, best_score, tied, 1.0);
+		}
+		stats_timer_stop(&st, n_trials);
+	}
+	stats_add_deals(&st, N, n_players);
+	for (k = 0; k < n_players; k++)
+	{
+		ev[k] /= (double)N;
+		if (ev2)
+			ev2[k] /= (double)N;
+	}
+	return 0;
+}
+
+int eval_monte_carlo_omaha_interleaved(int N, int *board, int n_board, 
+	int *pocket, int n_players, double *ev, rng_t *rng, int K, double *ev2 = NULL, int stratify = 0,
+	mc_stats *stats = NULL)
+{
+	int mask[52], cards[52], n_cards = 0, n_mask = 0, n_available, i, j, k, t, w;
+	memset(mask, 0, 52 * sizeof(int));
+	memset(cards, 0, 52 * sizeof(int));
+	memset(ev, 0, n_players * sizeof(double));
+	if (ev2)
+		memset(ev2, 0, n_players * sizeof(double));
+	if (stats)
+		memset(stats, 0, sizeof(mc_stats));
+	uint64_t deck = new_deck();
+	int available_cards[52];
+	if (n_board != 3 && n_board != 4 && n_board != 5)
+		return 1;
+	K = MAX(1, MIN(K, MC_MAX_INTERLEAVE));
+	int fs_offset = (n_board == 5) ? 106 : ((n_board == 4) ? HR9[106] : HR9[HR9[106]]);
+	int snf_offset = (n_board == 5) ? (HR9[0] + 53) : 
+		((n_board == 4) ? HR9[HR9[0] + 53] : HR9[HR9[HR9[0] + 53]]);
+	int flush_offset = (n_board == 5) ? (HR9[1] + 56) : 
+		((n_board == 4) ? HR9[HR9[1] + 56] : HR9[HR9[HR9[1] + 56]]);
+	for (i = 0; i < n_board; i++)
+	{
+		if (board[i] == 255)
+			mask[n_mask++] = n_cards;
+		else
+			extract_cards(&deck, board[i]);
+		cards[n_cards++] = board[i] + 1; // convert 0-51 to 1-52
+	}
+	for (i = 0; i < 4 * n_players; i++)
+	{
+		if (pocket[i] == 255)
+			mask[n_mask++] = n_cards;
+		else
+			extract_cards(&deck, pocket[i]);
+		cards[n_cards++] = pocket[i] + 1; // convert 0-51 to 1-52
+	}
+	n_available = 52 - n_board - 4 * n_players + n_mask;
+	get_cards(deck, available_cards, 1); // convert 0-51 to 1-52
+	int stratum = first_stratum(stratify, n_mask, mask, n_board, n_available, rng);
+	stats_timer st;
+	stats_timer_init(&st);
+	int deal[MC_MAX_INTERLEAVE][52], board_fs[MC_MAX_INTERLEAVE], board_snf[MC_MAX_INTERLEAVE];
+	int fs[MC_MAX_INTERLEAVE * MAX_PLAYERS], score[MC_MAX_INTERLEAVE * MAX_PLAYERS];
+	int sf[MC_MAX_INTERLEAVE * MAX_PLAYERS], flushes[MC_MAX_INTERLEAVE * MAX_PLAYERS];
+	int column[MC_MAX_INTERLEAVE * MAX_PLAYERS], gather = (simd_level() != SIMD_SCALAR);
+	// the 9 cards of walk w are its board and then its pocket
+	int *walk_board[MC_MAX_INTERLEAVE * MAX_PLAYERS], *walk_pocket[MC_MAX_INTERLEAVE * MAX_PLAYERS];
+	for (w = 0, t = 0; t < K; t++)
+		for (k = 0; k < n_players; k++, w++)
+		{
+			walk_board[w] = deal[t];
+			walk_pocket[w] = deal[t] + n_board + 4 * k;
+		}
+	for (i = 0; i < N; i += K)
+	{
+		int n_trials = MIN(K, N - i), n_walks = n_trials * n_players, n_flushes = 0;
+		stats_timer_start(&st);
+		for (t = 0; t < n_trials; t++)
+		{
+			int sample[52];
+			sample_deal(n_available, n_mask, sample, &stratum, rng);
+			memcpy(deal[t], cards, n_cards * sizeof(int));
+			for (j = 0; j < n_mask; j++)
+				deal[t][mask[j]] = available_cards[sample[j]];
+			board_fs[t] = fs_offset;
+			board_snf[t] = snf_offset;
+		}
+		stats_timer_split(&st);
+		for (j = 0; j < n_board; j++)
+			for (t = 0; t < n_trials; t++)
+			{
+				board_fs[t] = HR9[board_fs[t] + deal[t][j]];
+				board_snf[t] = HR9[board_snf[t] + deal[t][j]];
+				// the card after the board is the first pocket card
+				PREFETCH(HR9 + board_fs[t] + deal[t][j + 1]);
+				PREFETCH(HR9 + board_snf[t] + deal[t][j + 1]);
+			}
+		for (w = 0; w < n_walks; w++)
+		{
+			fs[w] = board_fs[w / n_players];
+			score[w] = board_snf[w / n_players];
+		}
+		if (gather)
+		{
+			// the same steps as gathers over card columns, the flush walks are
+			// packed and get the suit shift added to their cards
+			for (j = 0; j < 4; j++)
+			{
+				for (w = 0; w < n_walks; w++)
+					column[w] = walk_pocket[w][j];
+				gather_step(HR9, fs, column, n_walks);
+				gather_step(HR9, score, column, n_walks);
+			}
+			for (w = 0; w < n_walks; w++)
+				if (fs[w] != 0)
+				{
+					sf[n_flushes] = flush_offset;
+					flushes[n_flushes++] = w;
+				}
+			for (j = 0; j < n_board + 4 && n_flushes; j++)
+			{
+				for (int f = 0; f < n_flushes; f++)
+				{
+					w = flushes[f];
+					column[f] = (4 - fs[w]) + (j < n_board ? walk_board[w][j] : walk_pocket[w][j - n_board]);
+				}
+				gather_step(HR9, sf, column, n_flushes);
+			}
+			for (int f = 0; f < n_flushes; f++)
+				score[flushes[f]] = MAX(score[flushes[f]], sf[f]);
+		}
+		else
+		{
+			for (j = 0; j < 4; j++)
+				for (w = 0; w < n_walks; w++)
+				{
+					fs[w] = HR9[fs[w] + walk_pocket[w][j]];
+					score[w] = HR9[score[w] + walk_pocket[w][j]];
+					if (j < 3)
+					{
+						PREFETCH(HR9 + fs[w] + walk_pocket[w][j + 1]);
+						PREFETCH(HR9 + score[w] + walk_pocket[w][j + 1]);
+					}
+				}
+			for (w = 0; w < n_walks; w++)
+				if (fs[w] != 0)
+				{
+					flushes[n_flushes++] = w;
+					sf[w] = flush_offset;
+					PREFETCH(HR9 + (4 - fs[w]) + sf[w] + walk_board[w][0]);
+				}
+			for (j = 0; j < n_board + 4; j++)
+				for (int f = 0; f < n_flushes; f++)
+				{
+					w = flushes[f];
+					const int *HR9_f = HR9 + (4 - fs[w]);
+					sf[w] = HR9_f[sf[w] + (j < n_board ? walk_board[w][j] : walk_pocket[w][j - n_board])];
+					if (j + 1 < n_board + 4)
+						PREFETCH(HR9_f + sf[w] + (j + 1 < n_board ? 
+							walk_board[w][j + 1] : walk_pocket[w][j + 1 - n_board]));
+				}
+			for (int f = 0; f < n_flushes; f++)
+				score[flushes[f]] = MAX(score[flushes[f]], sf[flushes[f]]);
+		}
+		for (w = 0, t = 0; t < n_trials; t++, w += n_players)
+		{
+			int best_score = -1, tied = 0;
+			for (k = 0; k < n_players; k++)
+			{
+				if (score[w + k] > best_score)
+				{
+					best_score = score[w + k];
+					tied = 1;
+				}
+				else if (score[w + k] == best_score)
+					tied++;
+			}
+			double delta_ev = 1.0 / tied;
+			for (k = 0; k < n_players; k++)
+				if (score[w + k] == best_score)
+				{
+					ev[k] += delta_ev;
+					if (ev2)
+						ev2[k] += delta_ev * delta_ev;
+				}
+			if (stats)
+				mc_stats_add(stats, score + w, n_players, best_score, tied, 1.0);
+		}
+		stats_timer_stop(&st, n_trials);
+	}
+	stats_add_deals(&st, N, n_players);
+	for (k = 0; k < n_players; k++)
+	{
+		ev[k] /= (double)N;
+		if (ev2)
+			ev2[k] /= (double)N;
+	}
+	return 0;
+}
+
+typedef struct {
+	int N, *board, n_board, *pocket, n_players, is_omaha;
+	int interleave; // trials walked in lockstep, 1 for the scalar loops
+	int track_variance; // fill ev2 with the mean squared payoffs too
+	int stratify; // stratify the deals over the first masked board card
+	int track_stats; // fill stats with the win, tie and hand category counts too
+	rng_t rng;
+	double ev[MAX_PLAYERS], ev2[MAX_PLAYERS];
+	mc_stats stats;
+} mc_job;
+
+static void *mc_job_run(void *arg)
+{
+	mc_job *job = (mc_job *) arg;
+	double *ev2 = job->track_variance ? job->ev2 : NULL;
+	mc_stats *stats = job->track_stats ? &job->stats : NULL;
+	if (job->is_omaha && job->interleave > 1 && !HR9_compact)
+		eval_monte_carlo_omaha_interleaved(job->N, job->board, job->n_board, job->pocket, 
+			job->n_players, job->ev, &job->rng, job->interleave, ev2, job->stratify, stats);
+	else if (job->is_omaha)
+		eval_monte_carlo_omaha(job->N, job->board, job->n_board, 
+			job->pocket, job->n_players, job->ev, &job->rng, ev2, job->stratify, stats);
+	else if (job->interleave > 1)
+		eval_monte_carlo_holdem_interleaved(job->N, job->board, job->n_board, job->pocket, 
+			job->n_players, job->ev, &job->rng, job->interleave, ev2, job->stratify, stats);
+	else
+		eval_monte_carlo_holdem(job->N, job->board, job->n_board, 
+			job->pocket, job->n_players, job->ev, &job->rng, ev2, job->stratify, stats);
+	return NULL;
+}
+
+// Splits N iterations across n_threads workers sharing the same HR/HR9 tables,
+// i-th worker samples from i-th stream of the generator seeded with seed.
+// Doesn't touch any Python objects, so it may be called with the GIL released.
+// If stats is given, it gets the shares of the deals won, split and ending in 
+// each hand category, and the standard errors of the equities.
+int eval_monte_carlo_parallel(int N, int *board, int n_board, int *pocket, 
+	int n_players, int is_omaha, int n_threads, uint64_t seed, double *ev,
+	int interleave, int stratify, mc_stats *stats = NULL)
+{
+	int i, k;
+	if (n_threads > N)
+		n_threads = N;
+	if (n_threads < 1)
+		n_threads = 1;
+	mc_job *jobs = (mc_job *) malloc(n_threads * sizeof(mc_job));
+	for (i = 0; i < n_threads; i++)
+	{
+		jobs[i].N = N / n_threads + (i < (N % n_threads));
+		jobs[i].board = board;
+		jobs[i].n_board = n_board;
+		jobs[i].pocket = pocket;
+		jobs[i].n_players = n_players;
+		jobs[i].is_omaha = is_omaha;
+		jobs[i].interleave = interleave;
+		jobs[i].track_variance = (stats != NULL);
+		jobs[i].track_stats = (stats != NULL);
+		jobs[i].stratify = stratify;
+		rng_seed(&jobs[i].rng, seed, i);
+	}
+	run_threads(n_threads, mc_job_run, jobs, sizeof(mc_job));
+	memset(ev, 0, n_players * sizeof(double));
+	for (i = 0; i < n_threads; i++)
+		for (k = 0; k < n_players; k++)
+			ev[k] += jobs[i].ev[k] * jobs[i].N;
+	for (k = 0; k < n_players; k++)
+		ev[k] /= (double) N;
+	if (stats)
+	{
+		double s2[MAX_PLAYERS];
+		memset(stats, 0, sizeof(mc_stats));
+		memset(s2, 0, n_players * sizeof(double));
+		for (i = 0; i < n_threads; i++)
+			for (k = 0; k < n_players; k++)
+			{
+				s2[k] += jobs[i].ev2[k] * jobs[i].N;
+				stats->win[k] += jobs[i].stats.win[k];
+				stats->tie[k] += jobs[i].stats.tie[k];
+				for (int c = 0; c < 10; c++)
+					stats->category[k][c] += jobs[i].stats.category[k][c];
+			}
+		stats->n_deals = N;
+		for (k = 0; k < n_players; k++)
+		{
+			stats->win[k] /= N;
+			stats->tie[k] /= N;
+			for (int c = 0; c < 10; c++)
+				stats->category[k][c] /= N;
+			double var = (N > 1) ? MAX(0.0, (s2[k] - ev[k] * ev[k] * N) / (N - 1)) : 0.0;
+			stats->std_err[k] = sqrt(var / N);
+		}
+	}
+	free(jobs);
+	return 0;
+}
+
+// Like eval_monte_carlo_parallel(), but runs in rounds until the standard error
+// of every player's equity is at most target_stderr or max_N deals are done.
+// The first round is chunk deals, the next ones are sized after the variance
+// seen so far. The workers keep their streams from round to round, so a run
+// is reproducible for a given seed. Returns the standard errors and the 
+// number of deals actually done too.
+int eval_monte_carlo_adaptive(int max_N, int *board, int n_board, int *pocket, 
+	int n_players, int is_omaha, int n_threads, uint64_t seed, int interleave,
+	int stratify, double target_stderr, int chunk, double *ev, double *std_err, int *n_done)
+{
+	int i, k, n = 0, round = MIN(max_N, MAX(chunk, 2));
+	double s1[MAX_PLAYERS], s2[MAX_PLAYERS];
+	memset(s1, 0, n_players * sizeof(double));
+	memset(s2, 0, n_players * sizeof(double));
+	if (n_threads < 1)
+		n_threads = 1;
+	mc_job *jobs = (mc_job *) malloc(n_threads * sizeof(mc_job));
+	for (i = 0; i < n_threads; i++)
+	{
+		jobs[i].board = board;
+		jobs[i].n_board = n_board;
+		jobs[i].pocket = pocket;
+		jobs[i].n_players = n_players;
+		jobs[i].is_omaha = is_omaha;
+		jobs[i].interleave = interleave;
+		jobs[i].track_variance = 1;
+		jobs[i].track_stats = 0;
+		jobs[i].stratify = stratify;
+		rng_seed(&jobs[i].rng, seed, i);
+	}
+	while (round > 0)
+	{
+		int n_run = MIN(n_threads, round);
+		for (i = 0; i < n_run; i++)
+			jobs[i].N = round / n_run + (i < (round % n_run));
+		run_threads(n_run, mc_job_run, jobs, sizeof(mc_job));
+		for (i = 0; i < n_run; i++)
+			for (k = 0; k < n_players; k++)
+			{
+				s1[k] += jobs[i].ev[k] * jobs[i].N;
+				s2[k] += jobs[i].ev2[k] * jobs[i].N;
+			}
+		n += round;
+		double worst = 0.0;
+		for (k = 0; k < n_players; k++)
+		{
+			double var = MAX(0.0, (s2[k] - s1[k] * s1[k] / n) / (n - 1));
+			std_err[k] = sqrt(var / n);
+			worst = MAX(worst, std_err[k]);
+		}
+		if (worst <= target_stderr || n >= max_N)
+			break;
+		// the error shrinks as 1 / sqrt(n), aim a bit past the estimate
+		double needed = 1.1 * n * (worst / target_stderr) * (worst / target_stderr) - n;
+		round = (int) MIN((double) (max_N - n), MAX((double) chunk, needed));
+	}
+	for (k = 0; k < n_players; k++)
+		ev[k] = s1[k] / n;
+	*n_done = n;
+	free(jobs);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							EXACT ENUMERATION
+////////////////////////////////////////////////////////////////////////////////
+
+// number of distinct deals of the masked cards: every group (the board and
+// each pocket) takes an unordered subset of whatever is left in the deck
+double count_deals(int *board, int n_board, int *pocket, int n_players, int pocket_size)
+{
+	int i, k, n_known = 0, n_left, n_masked;
+	for (i = 0; i < n_board; i++)
+		n_known += (board[i] != 255);
+	for (i = 0; i < pocket_size * n_players; i++)
+		n_known += (pocket[i] != 255);
+	n_left = 52 - n_known;
+	double n_deals = 1.0;
+	for (k = -1; k < n_players; k++)
+	{
+		int *group = (k == -1) ? board : (pocket + k * pocket_size);
+		int group_size = (k == -1) ? n_board : pocket_size;
+		for (i = 0, n_masked = 0; i < group_size; i++)
+			n_masked += (group[i] == 255);
+		for (i = 0; i < n_masked; i++)
+			n_deals = n_deals * (n_left - i) / (i + 1);
+		n_left -= n_masked;
+	}
+	return n_deals;
+}
+
+typedef struct {
+	int path, fs; // holdem: path only; omaha: non-flush score and flush suit paths
+	int depth; // compact omaha table only, the last step reads the leaves
+} walk_t;
+
+typedef struct {
+	int is_omaha, n_board, n_players, pocket_size;
+	int cards[5 + 4 * MAX_PLAYERS]; // 1-52, masked slots are filled in as we go
+	int board_mask[5], n_board_mask, board_known[5], n_board_known;
+	int pocket_mask[MAX_PLAYERS][4], n_pocket_mask[MAX_PLAYERS];
+	int pocket_known[MAX_PLAYERS][4], n_pocket_known[MAX_PLAYERS];
+	int available[52], n_available, used[52];
+	int fs_offset, snf_offset, flush_offset;
+	int flush_board[5]; // board walk in the flush ranks block per suit, -1 if not there yet
+	walk_t board_walk;
+	int scores[MAX_PLAYERS];
+	int offset, stride; // only take every stride-th choice of the top level, starting at offset
+	int sym[SUIT_PERMUTATIONS][4], n_sym; // suit permutations that fix the known cards
+	int sym_group; // the first group with masked cards, -1 for the board, -2 if n_sym is 1
+	double weight; // the number of deals the current choice of sym_group stands for
+	double ev[MAX_PLAYERS], n_deals;
+	int track_stats;
+	mc_stats stats;
+} exact_job;
+
+static inline void exact_step(exact_job *job, walk_t *w, int card)
+{
+	if (job->is_omaha && HR9_compact)
+	{
+		if (++w->depth < HR9C_DEPTH)
+		{
+			w->fs = HR9C.nodes[HR9C_FLUSH_SUITS][w->fs + hr9c_suit_class[card]];
+			w->path = HR9C.nodes[HR9C_NO_FLUSH][w->path + hr9c_rank_class[card]];
+		}
+		else
+		{
+			w->fs = HR9C.leaves[HR9C_FLUSH_SUITS][w->fs + hr9c_suit_class[card]];
+			w->path = HR9C.leaves[HR9C_NO_FLUSH][w->path + hr9c_rank_class[card]];
+		}
+	}
+	else if (job->is_omaha)
+	{
+		w->fs = HR9[w->fs + card];
+		w->path = HR9[w->path + card];
+	}
+	else
+		w->path = HR[w->path + card];
+}
+
+static void exact_player(exact_job *job, int k);
+
+// Deals related by a suit symmetry of the known cards have the same outcome,
+// so only the choices of the masked cards of sym_group that are the smallest 
+// of their images are enumerated, and stand for their whole class. Returns 
+// the size of the class of the cards in the given slots of group, 0 if they
+// aren't the smallest. The slots are filled in ascending card order.
+static double exact_orbit_weight(exact_job *job, const int *group, const int *slots, int n)
+{
+	int i, j, k, n_same = 0, image[5];
+	for (k = 0; k < job->n_sym; k++)
+	{
+		for (i = 0; i < n; i++)
+		{
+			int c = group[slots[i]] - 1, card = ((c & ~3) | job->sym[k][c & 3]) + 1;
+			for (j = i; j > 0 && image[j - 1] > card; j--)
+				image[j] = image[j - 1];
+			image[j] = card;
+		}
+		int cmp = 0;
+		for (i = 0; i < n && !cmp; i++)
+			cmp = image[i] - group[slots[i]];
+		if (cmp < 0)
+			return 0.0;
+		n_same += (cmp == 0);
+	}
+	return (double) job->n_sym / n_same;
+}
+
+static void exact_score_player(exact_job *job, int k, walk_t w)
+{
+	int score = w.path, i;
+	int *player_cards = job->cards + job->n_board + k * job->pocket_size;
+	if (job->is_omaha && HR9_compact)
+	{
+		if (w.fs != 0)
+		{
+			const unsigned char *flush_class = hr9c_flush_class[w.fs];
+			const int *nfr = HR9C.nodes[HR9C_FLUSH_RANKS];
+			int sf = job->flush_board[w.fs];
+			if (sf == -1)
+			{
+				sf = job->flush_offset;
+				for (i = 0; i < job->n_board; i++)
+					sf = nfr[sf + flush_class[job->cards[i]]];
+				job->flush_board[w.fs] = sf;
+			}
+			for (i = 0; i < 3; i++)
+				sf = nfr[sf + flush_class[player_cards[i]]];
+			sf = HR9C.leaves[HR9C_FLUSH_RANKS][sf + flush_class[player_cards[3]]];
+			score = MAX(score, sf);
+		}
+	}
+	else if (job->is_omaha)
+	{
+		if (w.fs != 0)
+		{
+			int *HR9_f = HR9 + (4 - w.fs);
+			int sf = job->flush_board[w.fs];
+			if (sf == -1)
+			{
+				sf = job->flush_offset;
+				for (i = 0; i < job->n_board; i++)
+					sf = HR9_f[sf + job->cards[i]];
+				job->flush_board[w.fs] = sf;
+			}
+			for (i = 0; i < 4; i++)
+				sf = HR9_f[sf + player_cards[i]];
+			score = MAX(score, sf);
+		}
+	}
+	else if (job->n_board < 5)
+		score = HR[score]; // 5- and 6-card ranks are kept in the zero slot
+	job->scores[k] = score;
+	exact_player(job, k + 1);
+}
+
+static void exact_pocket(exact_job *job, int k, int level, int start, walk_t w, int top)
+{
+	if (level == job->n_pocket_mask[k])
+	{
+		if (k == job->sym_group)
+		{
+			job->weight = exact_orbit_weight(job, job->cards + job->n_board + k * job->pocket_size,
+				job->pocket_mask[k], level);
+			if (job->weight == 0.0)
+				return;
+		}
+		exact_score_player(job, k, w);
+		return;
+	}
+	int *slot = job->cards + job->n_board + k * job->pocket_size + job->pocket_mask[k][level];
+	int n_choice = 0;
+	for (int i = start; i < job->n_available; i++)
+	{
+		if (job->used[i])
+			continue;
+		if (top && (n_choice++ % job->stride) != job->offset)
+			continue;
+		job->used[i] = 1;
+		*slot = job->available[i];
+		walk_t next = w;
+		exact_step(job, &next, *slot);
+		exact_pocket(job, k, level + 1, i + 1, next, 0);
+		job->used[i] = 0;
+	}
+}
+
+static void exact_player(exact_job *job, int k)
+{
+	int i;
+	if (k == job->n_players)
+	{
+		int best_score = -1, tied = 0;
+		for (i = 0; i < job->n_players; i++)
+		{
+			if (job->scores[i] > best_score)
+			{
+				best_score = job->scores[i];
+				tied = 1;
+			}
+			else if (job->scores[i] == best_score)
+				tied++;
+		}
+		double delta_ev = job->weight / tied;
+		for (i = 0; i < job->n_players; i++)
+			if (job->scores[i] == best_score)
+				job->ev[i] += delta_ev;
+		job->n_deals += job->weight;
+		if (job->track_stats)
+			mc_stats_add(&job->stats, job->scores, job->n_players, best_score, tied, job->weight);
+		return;
+	}
+	// known pocket cards are walked once per board, masked ones per choice
+	walk_t w = job->board_walk;
+	int *player_cards = job->cards + job->n_board + k * job->pocket_size;
+	for (i = 0; i < job->n_pocket_known[k]; i++)
+		exact_step(job, &w, player_cards[job->pocket_known[k][i]]);
+	int top = (job->n_board_mask == 0);
+	for (i = 0; i < k; i++)
+		top = top && (job->n_pocket_mask[i] == 0);
+	exact_pocket(job, k, 0, 0, w, top);
+}
+
+static void exact_board(exact_job *job, int level, int start, walk_t w)
+{
+	if (level == job->n_board_mask)
+	{
+		if (job->sym_group == -1)
+		{
+			job->weight = exact_orbit_weight(job, job->cards, job->board_mask, level);
+			if (job->weight == 0.0)
+				return;
+		}
+		job->board_walk = w;
+		for (int s = 0; s < 5; s++)
+			job->flush_board[s] = -1;
+		exact_player(job, 0);
+		return;
+	}
+	int *slot = job->cards + job->board_mask[level];
+	int n_choice = 0;
+	for (int i = start; i < job->n_available; i++)
+	{
+		if (level == 0 && (n_choice++ % job->stride) != job->offset)
+			continue;
+		job->used[i] = 1;
+		*slot = job->available[i];
+		walk_t next = w;
+		exact_step(job, &next, *slot);
+		exact_board(job, level + 1, i + 1, next);
+		job->used[i] = 0;
+	}
+}
+
+static void *exact_job_run(void *arg)
+{
+	exact_job *job = (exact_job *) arg;
+	// known board cards go first so that their walk is shared by all deals
+	walk_t w;
+	w.path = job->is_omaha ? job->snf_offset : 53;
+	w.fs = job->fs_offset;
+	w.depth = 5 - job->n_board; // the skipped board cards
+	for (int i = 0; i < job->n_board_known; i++)
+		exact_step(job, &w, job->cards[job->board_known[i]]);
+	exact_board(job, 0, 0, w);
+	return NULL;
+}
+
+// Evaluates every distinct deal of the masked cards, the top enumeration level 
+// is split across n_threads workers. May be called with the GIL released.
+// See eval_monte_carlo_parallel() for stats.
+int eval_exact(int *board, int n_board, int *pocket, int n_players, 
+	int is_omaha, int n_threads, double *ev, mc_stats *stats = NULL)
+{
+	int i, k, pocket_size = is_omaha ? 4 : 2;
+	if (n_board != 3 && n_board != 4 && n_board != 5)
+		return 1;
+	if (n_threads < 1)
+		n_threads = 1;
+	if (n_threads > 52)
+		n_threads = 52;
+
+	exact_job base;
+	memset(&base, 0, sizeof(exact_job));
+	base.is_omaha = is_omaha;
+	base.n_board = n_board;
+	base.n_players = n_players;
+	base.pocket_size = pocket_size;
+	uint64_t deck = new_deck();
+	for (i = 0; i < n_board; i++)
+	{
+		if (board[i] == 255)
+			base.board_mask[base.n_board_mask++] = i;
+		else
+		{
+			base.board_known[base.n_board_known++] = i;
+			extract_cards(&deck, board[i]);
+		}
+		base.cards[i] = board[i] + 1; // convert 0-51 to 1-52
+	}
+	for (k = 0; k < n_players; k++)
+		for (i = 0; i < pocket_size; i++)
+		{
+			int card = pocket[k * pocket_size + i];
+			if (card == 255)
+				base.pocket_mask[k][base.n_pocket_mask[k]++] = i;
+			else
+			{
+				base.pocket_known[k][base.n_pocket_known[k]++] = i;
+				extract_cards(&deck, card);
+			}
+			base.cards[n_board + k * pocket_size + i] = card + 1; // convert 0-51 to 1-52
+		}
+	base.n_available = 0;
+	for (i = 0; i < 52; i++)
+		if (deck & (1LLU << i))
+			base.available[base.n_available++] = i + 1;
+	if (is_omaha && HR9_compact)
+	{
+		base.fs_offset = HR9C.root[HR9C_FLUSH_SUITS];
+		base.snf_offset = HR9C.root[HR9C_NO_FLUSH];
+		base.flush_offset = HR9C.root[HR9C_FLUSH_RANKS];
+		for (i = n_board; i < 5; i++)
+		{
+			base.fs_offset = HR9C.nodes[HR9C_FLUSH_SUITS][base.fs_offset];
+			base.snf_offset = HR9C.nodes[HR9C_NO_FLUSH][base.snf_offset];
+			base.flush_offset = HR9C.nodes[HR9C_FLUSH_RANKS][base.flush_offset];
+		}
+	}
+	else if (is_omaha)
+	{
+		base.fs_offset = (n_board == 5) ? 106 : ((n_board == 4) ? HR9[106] : HR9[HR9[106]]);
+		base.snf_offset = (n_board == 5) ? (HR9[0] + 53) : 
+			((n_board == 4) ? HR9[HR9[0] + 53] : HR9[HR9[HR9[0] + 53]]);
+		base.flush_offset = (n_board == 5) ? (HR9[1] + 56) : 
+			((n_board == 4) ? HR9[HR9[1] + 56] : HR9[HR9[HR9[1] + 56]]);
+	}
+
+	int has_masks = base.n_board_mask;
+	for (k = 0; k < n_players; k++)
+		has_masks += base.n_pocket_mask[k];
+	if (!has_masks)
+		n_threads = 1;
+
+	int group_sizes[1 + MAX_PLAYERS], suited[5 + 4 * MAX_PLAYERS];
+	group_sizes[0] = n_board;
+	memcpy(suited, board, n_board * sizeof(int));
+	for (k = 0; k < n_players; k++)
+		group_sizes[k + 1] = pocket_size;
+	memcpy(suited + n_board, pocket, n_players * pocket_size * sizeof(int));
+	base.n_sym = suit_symmetries(suited, group_sizes, 1 + n_players, base.sym);
+	// only worth it if another group is enumerated under every choice
+	int n_masked_groups = (base.n_board_mask > 0);
+	base.sym_group = -2;
+	for (k = n_players - 1; k >= 0; k--)
+		if (base.n_pocket_mask[k])
+		{
+			base.sym_group = k;
+			n_masked_groups++;
+		}
+	if (base.n_board_mask)
+		base.sym_group = -1;
+	if (base.n_sym == 1 || n_masked_groups < 2)
+		base.sym_group = -2;
+	base.weight = 1.0;
+	base.track_stats = (stats != NULL);
+
+	exact_job *jobs = (exact_job *) malloc(n_threads * sizeof(exact_job));
+	for (i = 0; i < n_threads; i++)
+	{
+		memcpy(&jobs[i], &base, sizeof(exact_job));
+		jobs[i].offset = i;
+		jobs[i].stride = n_threads;
+	}
+	run_threads(n_threads, exact_job_run, jobs, sizeof(exact_job));
+	double n_deals = 0;
+	memset(ev, 0, n_players * sizeof(double));
+	for (i = 0; i < n_threads; i++)
+	{
+		n_deals += jobs[i].n_deals;
+		for (k = 0; k < n_players; k++)
+			ev[k] += jobs[i].ev[k];
+	}
+	for (k = 0; k < n_players; k++)
+		ev[k] /= n_deals;
+	stats_add_deals(NULL, (uint64_t) n_deals, n_players);
+	if (stats)
+	{
+		memset(stats, 0, sizeof(mc_stats));
+		for (i = 0; i < n_threads; i++)
+			for (k = 0; k < n_players; k++)
+			{
+				stats->win[k] += jobs[i].stats.win[k] / n_deals;
+				stats->tie[k] += jobs[i].stats.tie[k] / n_deals;
+				for (int c = 0; c < 10; c++)
+					stats->category[k][c] += jobs[i].stats.category[k][c] / n_deals;
+			}
+		stats->n_deals = n_deals;
+	}
+	free(jobs);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							BATCHES
+////////////////////////////////////////////////////////////////////////////////
+
+// Many independent spots at once on the thread pool. Every spot is split into 
+// tasks of up to MC_BATCH_CHUNK deals, the i-th one sampling from the i-th 
+// stream of seed, so a spot gets the same result as eval_monte_carlo_parallel()
+// with as many threads as it has tasks, however many threads the pool runs.
+// That makes all spots sample the same numbers, so with spot_streams set the
+// tasks of spot i take streams (i << 32) + j instead, independent across spots.
+// Spots with no more than exact_threshold deals are enumerated in one task.
+typedef struct {
+	int board[5], n_board, pocket[4 * MAX_PLAYERS], n_players, is_omaha, N;
+} mc_spot;
+
+typedef struct {
+	mc_job job;
+	int spot, exact;
+} mc_batch_task;
+
+static void mc_batch_task_run(void *arg)
+{
+	mc_batch_task *task = (mc_batch_task *) arg;
+	mc_job *job = &task->job;
+	if (task->exact)
+		eval_exact(job->board, job->n_board, job->pocket, job->n_players, job->is_omaha, 1, job->ev);
+	else
+		mc_job_run(job);
+}
+
+// ev: MAX_PLAYERS per spot
+int eval_monte_carlo_batch(int n_spots, mc_spot *spots, int n_threads, uint64_t seed,
+	int spot_streams, double exact_threshold, int interleave, int stratify, double *ev)
+{
+	int i, j, k, n_tasks = 0;
+	int *exact = (int *) malloc(n_spots * sizeof(int));
+	for (i = 0; i < n_spots; i++)
+	{
+		mc_spot *spot = spots + i;
+		exact[i] = (count_deals(spot->board, spot->n_board, spot->pocket, spot->n_players, 
+			spot->is_omaha ? 4 : 2) <= exact_threshold);
+		n_tasks += exact[i] ? 1 : (spot->N + MC_BATCH_CHUNK - 1) / MC_BATCH_CHUNK;
+	}
+	mc_batch_task *tasks = (mc_batch_task *) malloc(n_tasks * sizeof(mc_batch_task));
+	mc_batch_task *task = tasks;
+	for (i = 0; i < n_spots; i++)
+	{
+		mc_spot *spot = spots + i;
+		int n_chunks = exact[i] ? 1 : (spot->N + MC_BATCH_CHUNK - 1) / MC_BATCH_CHUNK;
+		for (j = 0; j < n_chunks; j++, task++)
+		{
+			task->spot = i;
+			task->exact = exact[i];
+			task->job.N = spot->N / n_chunks + (j < (spot->N % n_chunks));
+			task->job.board = spot->board;
+			task->job.n_board = spot->n_board;
+			task->job.pocket = spot->pocket;
+			task->job.n_players = spot->n_players;
+			task->job.is_omaha = spot->is_omaha;
+			task->job.interleave = interleave;
+			task->job.track_variance = 0;
+			task->job.track_stats = 0;
+			task->job.stratify = stratify;
+			rng_seed(&task->job.rng, seed, spot_streams ? ((uint64_t) i << 32) + j : (uint64_t) j);
+		}
+	}
+	pool_run(n_threads, n_tasks, mc_batch_task_run, tasks, sizeof(mc_batch_task));
+	memset(ev, 0, n_spots * MAX_PLAYERS * sizeof(double));
+	for (task = tasks; task < tasks + n_tasks; task++)
+	{
+		mc_spot *spot = spots + task->spot;
+		double share = task->exact ? 1.0 : (double) task->job.N / spot->N;
+		for (k = 0; k < spot->n_players; k++)
+			ev[task->spot * MAX_PLAYERS + k] += task->job.ev[k] * share;
+	}
+	free(tasks);
+	free(exact);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							ASYNCHRONOUS MONTE CARLO
+////////////////////////////////////////////////////////////////////////////////
+
+// A run in the background: a controller thread submits rounds of tasks of up 
+// to chunk deals to the thread pool and publishes the totals after each round,
+// until N deals are done, the run is cancelled or its deadline passes. Tasks
+// that would start after that are skipped. Task i samples stream i of seed, 
+// so a finished run gives the same result for the same seed and chunk size 
+// however many threads it used, and a stopped one is its first tasks.
+
+#define MC_ASYNC_RUNNING	0
+#define MC_ASYNC_DONE		1
+#define MC_ASYNC_CANCELLED	2
+#define MC_ASYNC_TIMEOUT	3
+
+typedef struct {
+	int board[5], n_board, pocket[4 * MAX_PLAYERS], n_players, is_omaha;
+	int interleave, stratify, n_threads, chunk, N;
+	uint64_t seed;
+	double deadline; // monotonic seconds, 0 for none
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	volatile int cancelled;
+	int state, n_done, n_started;
+	double sum[MAX_PLAYERS]; // payoffs of the deals done
+} mc_async;
+
+typedef struct {
+	mc_job job;
+	mc_async *run;
+	int done;
+} mc_async_task;
+
+static double monotonic_seconds()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+static int mc_async_expired(const mc_async *run)
+{
+	return run->cancelled || (run->deadline > 0 && monotonic_seconds() >= run->deadline);
+}
+
+static void mc_async_task_run(void *arg)
+{
+	mc_async_task *task = (mc_async_task *) arg;
+	task->done = !mc_async_expired(task->run);
+	if (task->done)
+		mc_job_run(&task->job);
+}
+
+static void *mc_async_thread(void *arg)
+{
+	mc_async *run = (mc_async *) arg;
+	mc_async_task *tasks = (mc_async_task *) malloc(run->n_threads * sizeof(mc_async_task));
+	int i, k, stream = 0;
+	while (run->n_started < run->N && !mc_async_expired(run))
+	{
+		int n_tasks = 0;
+		for (i = 0; i < run->n_threads && run->n_started < run->N; i++, n_tasks++)
+		{
+			mc_job *job = &tasks[i].job;
+			tasks[i].run = run;
+			job->N = MIN(run->chunk, run->N - run->n_started);
+			job->board = run->board;
+			job->n_board = run->n_board;
+			job->pocket = run->pocket;
+			job->n_players = run->n_players;
+			job->is_omaha = run->is_omaha;
+			job->interleave = run->interleave;
+			job->track_variance = 0;
+			job->track_stats = 0;
+			job->stratify = run->stratify;
+			rng_seed(&job->rng, run->seed, stream++);
+			run->n_started += job->N;
+		}
+		pool_run(run->n_threads, n_tasks, mc_async_task_run, tasks, sizeof(mc_async_task));
+		pthread_mutex_lock(&run->lock);
+		// only a prefix of the tasks counts, so that a stopped run is reproducible too
+		for (i = 0; i < n_tasks && tasks[i].done; i++)
+		{
+			for (k = 0; k < run->n_players; k++)
+				run->sum[k] += tasks[i].job.ev[k] * tasks[i].job.N;
+			run->n_done += tasks[i].job.N;
+		}
+		pthread_cond_broadcast(&run->changed);
+		pthread_mutex_unlock(&run->lock);
+		if (i < n_tasks)
+			break;
+	}
+	free(tasks);
+	pthread_mutex_lock(&run->lock);
+	run->state = (run->n_done == run->N) ? MC_ASYNC_DONE : 
+		(run->cancelled ? MC_ASYNC_CANCELLED : MC_ASYNC_TIMEOUT);
+	TABLES_RELEASE(); // the run holds the tables until it stops
+	pthread_cond_broadcast(&run->changed);
+	pthread_mutex_unlock(&run->lock);
+	return NULL;
+}
+
+// timeout in seconds, 0 or negative for none; returns NULL if the thread can't start
+mc_async *mc_async_start(int N, const int *board, int n_board, const int *pocket, int n_players,
+	int is_omaha, int n_threads, uint64_t seed, int interleave, int stratify, int chunk, double timeout)
+{
+	mc_async *run = (mc_async *) calloc(1, sizeof(mc_async));
+	memcpy(run->board, board, n_board * sizeof(int));
+	memcpy(run->pocket, pocket, (is_omaha ? 4 : 2) * n_players * sizeof(int));
+	run->n_board = n_board;
+	run->n_players = n_players;
+	run->is_omaha = is_omaha;
+	run->N = N;
+	run->n_threads = MAX(1, n_threads);
+	run->seed = seed;
+	run->interleave = interleave;
+	run->stratify = stratify;
+	run->chunk = MAX(1, chunk);
+	run->deadline = (timeout > 0) ? monotonic_seconds() + timeout : 0;
+	run->state = MC_ASYNC_RUNNING;
+	pthread_mutex_init(&run->lock, NULL);
+	pthread_cond_init(&run->changed, NULL);
+	TABLES_ACQUIRE();
+	if (pthread_create(&run->thread, NULL, mc_async_thread, run))
+	{
+		TABLES_RELEASE();
+		pthread_mutex_destroy(&run->lock);
+		pthread_cond_destroy(&run->changed);
+		free(run);
+		return NULL;
+	}
+	return run;
+}
+
+// waits for the run to stop, up to timeout seconds if it's positive; returns the state
+int mc_async_wait(mc_async *run, double timeout)
+{
+	pthread_mutex_lock(&run->lock);
+	if (timeout > 0)
+	{
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		double t = until.tv_sec + 1e-9 * until.tv_nsec + timeout;
+		until.tv_sec = (time_t) t;
+		until.tv_nsec = (long) ((t - until.tv_sec) * 1e9);
+		while (run->state == MC_ASYNC_RUNNING)
+			if (pthread_cond_timedwait(&run->changed, &run->lock, &until) == ETIMEDOUT)
+				break;
+	}
+	else
+		while (run->state == MC_ASYNC_RUNNING)
+			pthread_cond_wait(&run->changed, &run->lock);
+	int state = run->state;
+	pthread_mutex_unlock(&run->lock);
+	return state;
+}
+
+// the equities of the deals done so far, returns their number
+int mc_async_progress(mc_async *run, double *ev, int *state)
+{
+	pthread_mutex_lock(&run->lock);
+	int n_done = run->n_done;
+	for (int k = 0; k < run->n_players; k++)
+		ev[k] = n_done ? run->sum[k] / n_done : 0.0;
+	*state = run->state;
+	pthread_mutex_unlock(&run->lock);
+	return n_done;
+}
+
+// cancels the run, waits for it to stop and frees it
+void mc_async_free(mc_async *run)
+{
+	run->cancelled = 1;
+	pthread_join(run->thread, NULL);
+	pthread_mutex_destroy(&run->lock);
+	pthread_cond_destroy(&run->changed);
+	free(run);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							RANGE VS RANGE
+////////////////////////////////////////////////////////////////////////////////
+
+// Every player holds a weighted range of combos. A deal picks one combo per
+// player with probability proportional to the product of their weights among
+// the combos that don't share cards with each other or the board, then deals
+// the masked cards at random; equities are averaged over such deals.
+
+typedef struct {
+	int N, *board, n_board, n_players, is_omaha;
+	const range_t *ranges;
+	rng_t rng;
+	int offset, stride; // exact: only every stride-th combo tuple, starting at offset
+	int failed; // no compatible combos found
+	double ev[MAX_PLAYERS], weight;
+} range_job;
+
+// draws combos until they don't clash, returns the used cards or 0 on failure
+static uint64_t range_deal(const range_job *job, uint64_t used, int *pocket, rng_t *rng)
+{
+	int i, k, size = job->is_omaha ? 4 : 2;
+	for (int attempt = 0; attempt < RANGE_MAX_REJECTS; attempt++)
+	{
+		uint64_t deal = used;
+		for (k = 0; k < job->n_players; k++)
+		{
+			const range_t *r = job->ranges + k;
+			int c = range_sample(r, rng);
+			if (r->masks[c] & deal)
+				break;
+			deal |= r->masks[c];
+			for (i = 0; i < size; i++)
+				pocket[k * size + i] = r->cards[c * size + i];
+		}
+		if (k == job->n_players)
+			return deal;
+	}
+	return 0;
+}
+
+static inline int range_random_card(uint64_t *used, rng_t *rng)
+{
+	int card;
+	do
+		card = (int) rng_bounded(rng, 52);
+	while (*used & (1LLU << card));
+	*used |= 1LLU << card;
+	return card;
+}
+
+static void *range_mc_run(void *arg)
+{
+	range_job *job = (range_job *) arg;
+	int i, k, board[5], pocket[4 * MAX_PLAYERS], size = job->is_omaha ? 4 : 2;
+	uint64_t known = 0;
+	for (i = 0; i < job->n_board; i++)
+		if (job->board[i] != 255)
+			known |= 1LLU << job->board[i];
+	memset(job->ev, 0, sizeof(job->ev));
+	job->failed = 0;
+	for (int trial = 0; trial < job->N; trial++)
+	{
+		int scores[MAX_PLAYERS], best_score = -1, tied = 0;
+		uint64_t used = range_deal(job, known, pocket, &job->rng);
+		if (!used)
+		{
+			job->failed = 1;
+			return NULL;
+		}
+		for (i = 0; i < job->n_board; i++)
+			board[i] = (job->board[i] == 255) ? range_random_card(&used, &job->rng) : job->board[i];
+		for (i = 0; i < size * job->n_players; i++)
+			if (pocket[i] == 255)
+				pocket[i] = range_random_card(&used, &job->rng);
+		if (job->is_omaha)
+			for (k = 0; k < job->n_players; k++)
+				scores[k] = eval_hand_omaha(board, job->n_board, pocket + 4 * k);
+		else
+		{
+			int path = 53;
+			for (i = 0; i < job->n_board; i++)
+				path = HR[path + board[i] + 1];
+			for (k = 0; k < job->n_players; k++)
+			{
+				int score = HR[HR[path + pocket[2 * k] + 1] + pocket[2 * k + 1] + 1];
+				scores[k] = (job->n_board < 5) ? HR[score] : score;
+			}
+		}
+		for (k = 0; k < job->n_players; k++)
+		{
+			if (scores[k] > best_score)
+			{
+				best_score = scores[k];
+				tied = 1;
+			}
+			else if (scores[k] == best_score)
+				tied++;
+		}
+		for (k = 0; k < job->n_players; k++)
+			if (scores[k] == best_score)
+				job->ev[k] += 1.0 / tied;
+	}
+	for (k = 0; k < job->n_players; k++)
+		job->ev[k] /= (double) job->N;
+	return NULL;
+}
+
+static void *range_exact_run(void *arg)
+{
+	range_job *job = (range_job *) arg;
+	int i, k, pocket[4 * MAX_PLAYERS], size = job->is_omaha ? 4 : 2;
+	uint64_t known = 0;
+	double n_tuples = 1.0, ev[MAX_PLAYERS];
+	for (i = 0; i < job->n_board; i++)
+		if (job->board[i] != 255)
+			known |= 1LLU << job->board[i];
+	for (k = 0; k < job->n_players; k++)
+		n_tuples *= job->ranges[k].n;
+	memset(job->ev, 0, sizeof(job->ev));
+	job->weight = 0.0;
+	for (int64_t t = job->offset; t < (int64_t) n_tuples; t += job->stride)
+	{
+		int64_t rest = t;
+		uint64_t used = known;
+		double weight = 1.0;
+		for (k = 0; k < job->n_players && weight > 0.0; k++)
+		{
+			const range_t *r = job->ranges + k;
+			int c = (int) (rest % r->n);
+			rest /= r->n;
+			if (r->masks[c] & used)
+				weight = 0.0;
+			used |= r->masks[c];
+			weight *= r->weights[c];
+			for (i = 0; i < size; i++)
+				pocket[k * size + i] = r->cards[c * size + i];
+		}
+		if (weight == 0.0)
+			continue;
+		eval_exact(job->board, job->n_board, pocket, job->n_players, job->is_omaha, 1, ev);
+		for (k = 0; k < job->n_players; k++)
+			job->ev[k] += weight * ev[k];
+		job->weight += weight;
+	}
+	return NULL;
+}
+
+// An upper bound on the deals of an enumeration: the number of combo tuples, 
+// clashing ones included, times the deals of a tuple made of the combos with 
+// the most masked cards of every range. Enumeration is used if that's at most
+// exact_threshold.
+double count_range_deals(int *board, int n_board, const range_t *ranges, int n_players, int is_omaha)
+{
+	int i, j, k, size = is_omaha ? 4 : 2, pocket[4 * MAX_PLAYERS];
+	double n_tuples = 1.0;
+	for (k = 0; k < n_players; k++)
+	{
+		int widest = 0, most_masked = -1;
+		for (i = 0; i < ranges[k].n; i++)
+		{
+			int n_masked = 0;
+			for (j = 0; j < size; j++)
+				n_masked += (ranges[k].cards[i * size + j] == 255);
+			if (n_masked > most_masked)
+			{
+				most_masked = n_masked;
+				widest = i;
+			}
+		}
+		memcpy(pocket + k * size, ranges[k].cards + widest * size, size * sizeof(int));
+		n_tuples *= ranges[k].n;
+	}
+	return n_tuples * count_deals(board, n_board, pocket, n_players, size);
+}
+
+// Equity of every range, exact if count_range_deals() is at most exact_threshold,
+// otherwise over N sampled deals; returns 2 if no combos of the ranges can be 
+// dealt together. May be called with the GIL released.
+int eval_range_equity(int N, int *board, int n_board, const range_t *ranges, int n_players,
+	int is_omaha, int n_threads, uint64_t seed, double exact_threshold, double *ev, int *exact)
+{
+	int i, k, failed = 0;
+	double weight = 0.0;
+	if (n_board != 3 && n_board != 4 && n_board != 5)
+		return 1;
+	*exact = (count_range_deals(board, n_board, ranges, n_players, is_omaha) <= exact_threshold);
+	if (n_threads > N && !*exact)
+		n_threads = N;
+	if (n_threads < 1)
+		n_threads = 1;
+	range_job *jobs = (range_job *) malloc(n_threads * sizeof(range_job));
+	for (i = 0; i < n_threads; i++)
+	{
+		jobs[i].N = N / n_threads + (i < (N % n_threads));
+		jobs[i].board = board;
+		jobs[i].n_board = n_board;
+		jobs[i].n_players = n_players;
+		jobs[i].is_omaha = is_omaha;
+		jobs[i].ranges = ranges;
+		jobs[i].offset = i;
+		jobs[i].stride = n_threads;
+		rng_seed(&jobs[i].rng, seed, i);
+	}
+	run_threads(n_threads, *exact ? range_exact_run : range_mc_run, jobs, sizeof(range_job));
+	if (!*exact)
+		stats_add_deals(NULL, N, n_players);
+	memset(ev, 0, n_players * sizeof(double));
+	for (i = 0; i < n_threads; i++)
+	{
+		double w = *exact ? jobs[i].weight : (double) jobs[i].N;
+		failed = failed || (!*exact && jobs[i].failed);
+		for (k = 0; k < n_players; k++)
+			ev[k] += *exact ? jobs[i].ev[k] : jobs[i].ev[k] * w;
+		weight += w;
+	}
+	free(jobs);
+	if (failed || weight <= 0.0)
+		return 2;
+	for (k = 0; k < n_players; k++)
+		ev[k] /= weight;
+	return 0;
+}
+
+static int pocket_perms[2][6] = {{0, 0, 0, 1, 1, 2}, {1, 2, 3, 2, 3, 3}};
+static int n_pocket_perms = 6;
+static int board_perms[10][3] = {
+	{0, 1, 2}, // 3, 4, 5
+	{0, 1, 3}, {0, 2, 3}, {1, 2, 3}, // 4, 5
+	{0, 1, 4}, {0, 2, 4}, {0, 3, 4}, {1, 2, 4}, {1, 3, 4}, {2, 3, 4}}; // 5
+
+// naive old method, left here for reference
+int eval_monte_carlo_omaha_old(int N, int *board, int n_board, 
+	int *pocket, int n_players, double *ev, rng_t *rng)
+{
+	int n_board_perms = n_board == 5 ? 10 : n_board == 4 ? 4 : n_board == 3 ? 1 : -1;
+	if (n_board_perms == -1)
+		return 1;
+
+	int mask[52], cards[52], n_mask = 0, n_available, 
+		i, available_cards[52], sample[52];
+
+	memset(mask, 0, 52 * sizeof(int));
+	memset(cards, 0, 52 * sizeof(int));
+	memset(ev, 0, n_players * sizeof(double));
+	uint64_t deck = new_deck();
+
+	for (i = 0; i < n_board; i++)
+	{
+		if (board[i] == 255)
+			mask[n_mask++] = i;
+		else
+			extract_cards(&deck, board[i]);
+		cards[i] = board[i] + 1; // convert 0-51 to 1-52
+	}
+	for (i = 0; i < 4 * n_players; i++)
+	{
+		if (pocket[i] == 255)
+			mask[n_mask++] = n_board + i;
+		else
+			extract_cards(&deck, pocket[i]);
+		cards[n_board + i] = pocket[i] + 1; // convert 0-51 to 1-52
+	}
+
+	n_available = 52 - n_board - 4 * n_players + n_mask;
+	get_cards(deck, available_cards, 1); // convert 0-51 to 1-52
+
+	for (i = 0; i < N; ++i)
+	{
+		int best_score = 0;
+		int tied = 0;
+		random_sample_52_ross(n_available, n_mask, sample, rng);
+		int j = 0, nb = 0, np = 0;
+		for (j = 0; j < n_mask; ++j)
+			cards[mask[j]] = available_cards[sample[j]];
+		int *player_cards = cards + n_board;
+		int board_paths[10];
+		for (nb = 0; nb < n_board_perms; nb++)
+			board_paths[nb] = HR[HR[HR[53 + 
+				cards[board_perms[nb][0]]] + 
+					cards[board_perms[nb][1]]] + 
+						cards[board_perms[nb][2]]];
+		int scores[MAX_PLAYERS];
+		for (j = 0; j < n_players; ++j)
+		{
+			int score = 0;
+			for (nb = 0; nb < n_board_perms; ++nb)
+				for (np = 0; np < n_pocket_perms; ++np)
+					// Aldanor: don't forget to use extra HR[...] for 5/6-card eval
+					score = MAX(score, HR[HR[HR[board_paths[nb] + 
+						player_cards[pocket_perms[0][np]]] + 
+							player_cards[pocket_perms[1][np]]]]);
+			scores[j] = score;
+			if (score > best_score)
+			{
+				best_score = score;
+				tied = 1;
+			}
+			else if (score == best_score)
+				tied++;
+			player_cards += 4;
+		}
+		double delta_ev = 1.0 / tied;
+		for (j = 0; j < n_players; j++)
+			if (scores[j] == best_score)
+				ev[j] += delta_ev;
+	}
+	for (i = 0; i < n_players; ++i)
 		ev[i] /= N;
 	return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//							PYTHON WRAPPERS
+//							PYTHON WRAPPERS
+////////////////////////////////////////////////////////////////////////////////
+
+#define RAISE_EXCEPTION(exception, message) {PyErr_SetString((exception), (message)); return NULL;}
+
+static PyObject *_rayeval_seed(PyObject *self, PyObject *args)
+{
+	unsigned long long seed, stream = 0;
+  	if (!PyArg_ParseTuple(args, "K|K", &seed, &stream))
+    	return NULL;
+    seed_random((uint64_t) seed, (uint64_t) stream);
+	Py_RETURN_NONE;
+}
+
+
+// version 1 files don't record the kind, so they pass
+static int check_table_kind(const char *filename, int kind)
+{
+	table_info info;
+	if (read_table_info(filename, &info))
+		return -1;
+	if (kind == TABLE_KIND_9 && info.kind == TABLE_KIND_9_COMPACT)
+		return 0;
+	return (info.kind == TABLE_KIND_UNKNOWN || info.kind == kind) ? 0 : -1;
+}
+
+static PyObject *_rayeval_load_handranks_7(PyObject *self, PyObject *args)
+{
+	char *filename;
+	int use_mmap = 0, populate = 1, huge_pages = 0;
+  	if (!PyArg_ParseTuple(args, "s|iii", &filename, &use_mmap, &populate, &huge_pages))
+    	return NULL;
+    if (!HR && check_table_kind(filename, TABLE_KIND_7))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Not a valid 7-card hand ranks file.");
+    if (!HR)
+    {
+    	uint64_t t = stats_clock();
+	    if (!(HR = use_mmap ? smart_mmap(filename, populate != 0, huge_pages, &HR_backing) : 
+	    		smart_load(filename, huge_pages, &HR_backing)))
+	    	RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks from file.");
+	    STATS_load_seconds[0] = (stats_clock() - t) * 1e-9;
+    }
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_load_handranks_9(PyObject *self, PyObject *args)
+{
+	char *filename;
+	int use_mmap = 0, populate = 1, huge_pages = 0;
+  	if (!PyArg_ParseTuple(args, "s|iii", &filename, &use_mmap, &populate, &huge_pages))
+    	return NULL;
+    if (!HR9 && check_table_kind(filename, TABLE_KIND_9))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Not a valid 9-card hand ranks file.");
+    if (!HR9)
+    {
+    	uint64_t t = stats_clock();
+	    if (!(HR9 = use_mmap ? smart_mmap(filename, populate != 0, huge_pages, &HR9_backing) : 
+	    		smart_load(filename, huge_pages, &HR9_backing)))
+	    	RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [9] from file.");
+	    STATS_load_seconds[1] = (stats_clock() - t) * 1e-9;
+    }
+	update_hr9_layout();
+	Py_RETURN_NONE;
+}
+
+// POSIX shm segments are named after (path, user_id) just like SysV keys are ftok()'ed
+static int *load_table_to_shm(const char *filename, const char *path, int user_id, 
+	int posix, int huge_pages, int *backing)
+{
+	int *hr;
+	if (posix)
+	{
+		char name[64];
+		posix_shm_name(path, user_id, name, sizeof(name));
+		return posix_shm_load(name, filename, huge_pages, backing);
+	}
+	if (!(hr = smart_load_to_shm(filename, ftok(path, user_id), huge_pages, backing)))
+		return NULL;
+	return hr + 1;
+}
+
+static int *attach_table(const char *path, int user_id, int posix, int *backing)
+{
+	int *hr;
+	if (posix)
+	{
+		char name[64];
+		posix_shm_name(path, user_id, name, sizeof(name));
+		if ((hr = posix_shm_attach(name)))
+			*backing = BACKING_POSIX_SHM;
+		return hr;
+	}
+	if ((hr = attach_hr(ftok(path, user_id))))
+		*backing = BACKING_SHM;
+	return hr;
+}
+
+// unmaps a table obtained from shared memory of either kind
+static int detach_table(int **hr, int *backing)
+{
+	if (!*hr)
+		return 0;
+	if (*backing == BACKING_POSIX_SHM || *backing == BACKING_POSIX_SHM_THP)
+	{
+		if (posix_shm_detach(*hr) == -1)
+			return -1;
+	}
+	else if (*backing == BACKING_SHM || *backing == BACKING_SHM_HUGETLB)
+	{
+		if (shmdt(*hr - 1) == -1)
+		{
+			perror("shmdt");
+			return -1;
+		}
+	}
+	else
+		return -1;
+	*hr = NULL;
+	*backing = BACKING_NONE;
+	return 0;
+}
+
+static PyObject *_rayeval_load_handranks_7_to_shm(PyObject *self, PyObject *args)
+{
+    char *filename;
+    char *path;
+    int user_id, huge_pages = 0, posix = 0;
+    if (!PyArg_ParseTuple(args, "ssi|ii", &filename, &path, &user_id, &huge_pages, &posix))
+        return NULL;
+    if (!HR && check_table_kind(filename, TABLE_KIND_7))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Not a valid 7-card hand ranks file.");
+    if (!HR)
+    {
+    	uint64_t t = stats_clock();
+        if (!(HR = load_table_to_shm(filename, path, user_id, posix, huge_pages, &HR_backing)))
+            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks from file.");
+        STATS_load_seconds[0] = (stats_clock() - t) * 1e-9;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_load_handranks_9_to_shm(PyObject *self, PyObject *args)
+{
+    char *filename;
+    char *path;
+    int user_id, huge_pages = 0, posix = 0;
+  	if (!PyArg_ParseTuple(args, "ssi|ii", &filename, &path, &user_id, &huge_pages, &posix))
+    	return NULL;
+    if (!HR9 && check_table_kind(filename, TABLE_KIND_9))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Not a valid 9-card hand ranks file.");
+    if (!HR9)
+    {
+    	uint64_t t = stats_clock();
+	    if (!(HR9 = load_table_to_shm(filename, path, user_id, posix, huge_pages, &HR9_backing)))
+	    	RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [9] from file.");
+	    STATS_load_seconds[1] = (stats_clock() - t) * 1e-9;
+    }
+	update_hr9_layout();
+    Py_RETURN_NONE;
+}
+
+// INPUT:
+//		filename: str
+// OUTPUT:
+//		info: dict - version, kind (0 if unknown), length, sections and checksum
+static PyObject *_rayeval_handranks_info(PyObject *self, PyObject *args)
+{
+	char *filename;
+	table_info info;
+	if (!PyArg_ParseTuple(args, "s", &filename))
+		return NULL;
+	if (read_table_info(filename, &info))
+		RAISE_EXCEPTION(PyExc_ValueError, "Not a valid hand ranks file.");
+	return Py_BuildValue("{s:i,s:i,s:K,s:(KKK),s:K}", "version", info.version, "kind", info.kind,
+		"length", (unsigned long long) info.length, "sections", 
+		(unsigned long long) info.sections[0], (unsigned long long) info.sections[1],
+		(unsigned long long) info.sections[2], "checksum", (unsigned long long) info.checksum);
+}
+
+static PyObject *_rayeval_verify_handranks(PyObject *self, PyObject *args)
+{
+	char *filename;
+	int result;
+	if (!PyArg_ParseTuple(args, "s", &filename))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = verify_table_file(filename);
+	Py_END_ALLOW_THREADS
+	if (result)
+		Py_RETURN_FALSE;
+	Py_RETURN_TRUE;
+}
+
+static PyObject *_rayeval_generate_handranks_7(PyObject *self, PyObject *args)
+{
+	char *filename;
+	int test, n_threads = 0, result;
+  	if (!PyArg_ParseTuple(args, "si|i", &filename, &test, &n_threads))
+    	return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = raygen7(filename, (test != 0), n_threads);
+	Py_END_ALLOW_THREADS
+	if (result)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to generate hand ranks [7] file.");
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_generate_handranks_9(PyObject *self, PyObject *args)
+{
+	char *filename, *filename7;
+	int test, n_threads = 0, reorder = 0, result;
+  	if (!PyArg_ParseTuple(args, "ssi|ii", &filename, &filename7, &test, &n_threads, &reorder))
+    	return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = raygen9(filename, filename7, (test != 0), n_threads, (reorder != 0));
+	Py_END_ALLOW_THREADS
+	if (result)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to generate hand ranks [9] file.");
+	Py_RETURN_NONE;
+}
+
+
+// INPUT:
+//		filename: str - 9-card hand ranks file
+//		filename7: str - 7-card hand ranks file to check against
+//		n_threads: int - 0 for all cores
+//		n_samples: long - check random hands instead of all combinations
+//		shard, n_shards: int - check only every n_shards-th unit of work
+// OUTPUT:
+//		ok: bool
+static PyObject *_rayeval_test_handranks_9(PyObject *self, PyObject *args)
+{
+	char *filename, *filename7;
+	int n_threads = 0, shard = 0, n_shards = 1, result;
+	PY_LONG_LONG n_samples = 0;
+	if (!PyArg_ParseTuple(args, "ss|iLii", &filename, &filename7, &n_threads, &n_samples, 
+			&shard, &n_shards))
+		return NULL;
+	if (n_samples < 0)
+		RAISE_EXCEPTION(PyExc_ValueError, "Number of samples must be non-negative.");
+	if (n_shards < 1 || shard < 0 || shard >= n_shards)
+		RAISE_EXCEPTION(PyExc_ValueError, "Shard must be in [0, n_shards).");
+	Py_BEGIN_ALLOW_THREADS
+	result = test_all_handranks(filename, filename7, n_threads, n_samples, shard, n_shards);
+	Py_END_ALLOW_THREADS
+	if (result)
+		Py_RETURN_FALSE;
+	Py_RETURN_TRUE;
+}
+
+// INPUT:
+//		filename: str - 9-card hand ranks file
+//		filename_out: str - the same table with its blocks in breadth-first order
+static PyObject *_rayeval_reorder_handranks_9(PyObject *self, PyObject *args)
+{
+	char *filename, *filename_out;
+	int result;
+	if (!PyArg_ParseTuple(args, "ss", &filename, &filename_out))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = reorder_handranks_9(filename, filename_out);
+	Py_END_ALLOW_THREADS
+	if (result)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to reorder hand ranks [9].");
+	Py_RETURN_NONE;
+}
+
+// INPUT:
+//		filename: str - 9-card hand ranks file
+//		filename_out: str - compact 9-card hand ranks file
+//		n_samples: long - random hands to check the compact table on
+static PyObject *_rayeval_compact_handranks_9(PyObject *self, PyObject *args)
+{
+	char *filename, *filename_out;
+	PY_LONG_LONG n_samples = 1000000;
+	int result;
+	if (!PyArg_ParseTuple(args, "ss|L", &filename, &filename_out, &n_samples))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = compact_handranks_9(filename, filename_out, n_samples);
+	Py_END_ALLOW_THREADS
+	if (result)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to compact hand ranks [9].");
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_attach_handranks_7(PyObject *self, PyObject *args)
+{
+    char *path;
+    int user_id, posix = 0;
+  	if (!PyArg_ParseTuple(args, "si|i", &path, &user_id, &posix))
+    	return NULL;
+    if (!HR)
+    {
+    	uint64_t t = stats_clock();
+        if (!(HR = attach_table(path, user_id, posix, &HR_backing)))
+            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [7] from shared memory.");
+        STATS_load_seconds[0] = (stats_clock() - t) * 1e-9;
+    }
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_attach_handranks_9(PyObject *self, PyObject *args)
+{
+    char *path;
+    int user_id, posix = 0;
+  	if (!PyArg_ParseTuple(args, "si|i", &path, &user_id, &posix))
+        return NULL;
+    if (!HR9)
+    {
+    	uint64_t t = stats_clock();
+        if (!(HR9 = attach_table(path, user_id, posix, &HR9_backing)))
+            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [9] from shared memory.");
+        STATS_load_seconds[1] = (stats_clock() - t) * 1e-9;
+    }
+	update_hr9_layout();
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_detach_handranks_7(PyObject *self, PyObject *args)
+{
+    if (TABLE_users)
+        RAISE_EXCEPTION(PyExc_RuntimeError, "Can't detach hand ranks [7] while evaluations are using them.");
+    if (detach_table(&HR, &HR_backing) == -1)
+        RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to detach hand ranks [7] from shared memory.");
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_detach_handranks_9(PyObject *self, PyObject *args)
+{
+    if (TABLE_users)
+        RAISE_EXCEPTION(PyExc_RuntimeError, "Can't detach hand ranks [9] while evaluations are using them.");
+    if (detach_table(&HR9, &HR9_backing) == -1)
+        RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to detach hand ranks [9] from shared memory.");
+	update_hr9_layout();
+	Py_RETURN_NONE;
+}
+
+// INPUT:
+//		level: int (optional) - SIMD_SCALAR, SIMD_AVX2 or SIMD_AVX512, capped at
+//			what the CPU supports; -1 for the best one, omitted to keep the current one
+// OUTPUT:
+//		level: int - the level used by the batch and Monte Carlo table walks
+static PyObject *_rayeval_simd_level(PyObject *self, PyObject *args)
+{
+	int level = -2;
+	if (!PyArg_ParseTuple(args, "|i", &level))
+		return NULL;
+	if (level != -2)
+		set_simd_level(level);
+	return PyInt_FromLong((long) simd_level());
+}
+
+// INPUT:
+//		n_cards: int - 7 or 9
+// OUTPUT:
+//		backing: str - how the table is held in memory (heap, hugetlb, mmap, shm, ...)
+static PyObject *_rayeval_handranks_backing(PyObject *self, PyObject *args)
+{
+    int n_cards;
+    if (!PyArg_ParseTuple(args, "i", &n_cards))
+        return NULL;
+    if (n_cards != 7 && n_cards != 9)
+        RAISE_EXCEPTION(PyExc_ValueError, "Hand ranks must be 7- or 9-card.");
+    return PyString_FromString(backing_str(n_cards == 7 ? HR_backing : HR9_backing));
+}
+
+static PyObject *_rayeval_del_handranks_shm(PyObject *self, PyObject *args)
+{
+    char *path;
+    int user_id, posix = 0;
+  	if (!PyArg_ParseTuple(args, "si|i", &path, &user_id, &posix))
+        return NULL;
+    if (posix)
+    {
+        char name[64];
+        posix_shm_name(path, user_id, name, sizeof(name));
+        if (posix_shm_unlink(name) == -1)
+            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to remove hand ranks from shared memory.");
+        Py_RETURN_NONE;
+    }
+    if (del_shm(ftok(path, user_id)) == -1)
+        RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to detach hand ranks from shared memory.");
+	Py_RETURN_NONE;
+}
+
+static PyObject *_rayeval_is_loaded_to_shm(PyObject *self, PyObject *args)
+{
+    char *path;
+    int user_id, posix = 0;
+    if (!PyArg_ParseTuple(args, "si|i", &path, &user_id, &posix))
+        return NULL;
+    if (posix)
+    {
+        char name[64];
+        posix_shm_name(path, user_id, name, sizeof(name));
+        if (posix_shm_is_ready(name))
+            Py_RETURN_TRUE;
+        Py_RETURN_FALSE;
+    }
+    if (shmget(ftok(path, user_id), 1, 0600) < 0)
+        Py_RETURN_FALSE;
+    Py_RETURN_TRUE;
+}
+
+int *parse_board_and_pockets(char *game, PyObject *py_board, PyObject *py_pocket,
+	int *board, int *pocket, int *n_board, int *n_pocket, int *n_players, int *is_omaha)
+{
+	int i, pocket_size = 2;
+	static int ok = 1;
+	*is_omaha = 0;
+
+	if (!strcmp(game, "omaha"))
+		*is_omaha = 1;
+	else if (strcmp(game, "holdem"))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Game type must be holdem or omaha.");
+    pocket_size += 2 * (*is_omaha);
+
+  	if (!PyList_Check(py_board)) 
+    	RAISE_EXCEPTION(PyExc_TypeError, "Board must be a list.");
+  	if (!PyList_Check(py_pocket)) 
+    	RAISE_EXCEPTION(PyExc_TypeError, "Pockets must be a list.");
+
+    *n_pocket = (int) PyList_Size(py_pocket);
+    *n_board = (int) PyList_Size(py_board);
+    *n_players = *n_pocket / pocket_size;
+    if ((*n_players < 1) || (*n_players > MAX_PLAYERS))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Invalid number of players.");
+    if ((*n_players) * pocket_size != (*n_pocket))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Invalid number of pocket cards.");
+    if ((*n_board != 3) && (*n_board != 4) && (*n_board != 5))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Board must contain 3-5 cards.");
+
+    for (i = 0; i < (*n_pocket); i++)
+    {
+    	PyObject *item = PyList_GetItem(py_pocket, i);
+    	if (!PyInt_Check(item))
+	    	RAISE_EXCEPTION(PyExc_TypeError, "Pocket cards must be integers.");
+    	pocket[i] = (int) PyInt_AsLong(item);
+    	if ((pocket[i] < 0 || pocket[i] > 51) && pocket[i] != 255)
+	    	RAISE_EXCEPTION(PyExc_TypeError, "Pocket cards must be 0-51 or 255.");
+    }
+
+    for (i = 0; i < (*n_board); i++)
+    {
+    	PyObject *item = PyList_GetItem(py_board, i);
+    	if (!PyInt_Check(item))
+	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be integers.");
+    	board[i] = (int) PyInt_AsLong(item);
+    	if ((board[i] < 0 || board[i] > 51) && board[i] != 255)
+	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be 0-51 or 255.");
+    }
+
+    return &ok;
+}
+
+static PyObject *_rayeval_eval_hand(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_HAND);
+	char *game;
+	PyObject *py_board, *py_pocket;
+	int n_board, n_pocket, i, value;
+	int n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha;
+
+	if (!PyArg_ParseTuple(args, "sOO", &game, &py_board, &py_pocket))
+		return NULL;
+
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	if (n_players > 1)
+		RAISE_EXCEPTION(PyExc_ValueError, "One player expected, found more.");
+
+	for (i = 0; i < n_board; i++)
+		if (board[i] == 255)
+			RAISE_EXCEPTION(PyExc_ValueError, "Masked board is not allowed.");
+	for (i = 0; i < n_pocket; i++)
+		if (pocket[i] == 255)
+			RAISE_EXCEPTION(PyExc_ValueError, "Masked pocket is not allowed.");
+
+	if (is_omaha)
+		value = eval_hand_omaha(board, n_board, pocket);
+	else
+		value = eval_hand_holdem(board, n_board, pocket, n_pocket);
+	stats_add_evaluations(1);
+	return PyInt_FromLong((long)value);
+}
+
+typedef struct {
+	int is_omaha, n_hands, n_board, n_pocket, invalid;
+	unsigned char *boards, *pockets;
+	int32_t *ranks;
+} batch_job;
+
+// evaluates n hands of a job starting at first, walking all of them one level
+// at a time so that every step is a single gather over the chunk
+static void batch_chunk_run(batch_job *job, int first, int n)
+{
+	int cards[9][GATHER_CHUNK], state[GATHER_CHUNK], fs[GATHER_CHUNK], valid[GATHER_CHUNK];
+	int i, j, n_board = job->n_board, n_cards = job->n_board + job->n_pocket;
+	for (i = 0; i < n; i++)
+	{
+		unsigned char *b = job->boards + (first + i) * n_board, 
+			*p = job->pockets + (first + i) * job->n_pocket;
+		valid[i] = 1;
+		for (j = 0; j < n_board; j++)
+			valid[i] &= ((cards[j][i] = b[j] + 1) <= 52);
+		for (j = 0; j < job->n_pocket; j++)
+			valid[i] &= ((cards[n_board + j][i] = p[j] + 1) <= 52);
+		if (!valid[i])
+		{
+			for (j = 0; j < n_cards; j++)
+				cards[j][i] = j + 1; // any valid hand, so that the walk stays in the table
+			job->invalid++;
+		}
+	}
+	if (!job->is_omaha)
+	{
+		for (i = 0; i < n; i++)
+			state[i] = 53;
+		for (j = 0; j < n_cards; j++)
+			gather_step(HR, state, cards[j], n);
+		if (n_cards < 7)
+		{
+			// 5- and 6-card ranks are kept in the zero slot
+			memset(fs, 0, n * sizeof(int));
+			gather_step(HR, state, fs, n);
+		}
+	}
+	else
+	{
+		int fs0 = 106, snf0 = HR9[0] + 53, fo0 = HR9[1] + 56;
+		for (j = n_board; j < 5; j++)
+		{
+			fs0 = HR9[fs0]; 
+			snf0 = HR9[snf0]; 
+			fo0 = HR9[fo0];
+		}
+		for (i = 0; i < n; i++)
+		{
+			fs[i] = fs0;
+			state[i] = snf0;
+		}
+		for (j = 0; j < n_cards; j++)
+		{
+			gather_step(HR9, fs, cards[j], n);
+			gather_step(HR9, state, cards[j], n);
+		}
+		// flush ranks of the hands with a flush suit, the suit shift goes into the cards
+		int flushes[GATHER_CHUNK], sf[GATHER_CHUNK], shifted[GATHER_CHUNK], n_flushes = 0, f;
+		for (i = 0; i < n; i++)
+			if (fs[i] != 0)
+			{
+				sf[n_flushes] = fo0;
+				flushes[n_flushes++] = i;
+			}
+		for (j = 0; j < n_cards && n_flushes; j++)
+		{
+			for (f = 0; f < n_flushes; f++)
+				shifted[f] = cards[j][flushes[f]] + 4 - fs[flushes[f]];
+			gather_step(HR9, sf, shifted, n_flushes);
+		}
+		for (f = 0; f < n_flushes; f++)
+			state[flushes[f]] = MAX(state[flushes[f]], sf[f]);
+	}
+	for (i = 0; i < n; i++)
+		job->ranks[first + i] = valid[i] ? state[i] : 0;
+}
+
+static void *batch_job_run(void *arg)
+{
+	batch_job *job = (batch_job *) arg;
+	int board[5], pocket[4], i, j;
+	if (!job->is_omaha || !HR9_compact)
+	{
+		for (i = 0; i < job->n_hands; i += GATHER_CHUNK)
+			batch_chunk_run(job, i, MIN(GATHER_CHUNK, job->n_hands - i));
+		return NULL;
+	}
+	for (i = 0; i < job->n_hands; i++)
+	{
+		unsigned char *b = job->boards + i * job->n_board, *p = job->pockets + i * job->n_pocket;
+		int valid = 1;
+		for (j = 0; j < job->n_board; j++)
+			valid &= ((board[j] = b[j]) < 52);
+		for (j = 0; j < job->n_pocket; j++)
+			valid &= ((pocket[j] = p[j]) < 52);
+		if (!valid)
+		{
+			job->ranks[i] = 0;
+			job->invalid++;
+		}
+		else if (job->is_omaha)
+			job->ranks[i] = eval_hand_omaha(board, job->n_board, pocket);
+		else
+			job->ranks[i] = eval_hand_holdem(board, job->n_board, pocket, job->n_pocket);
+	}
+	return NULL;
+}
+
+static int check_buffer_format(Py_buffer *view, int itemsize, const char *formats)
+{
+	if (view->itemsize != itemsize)
+		return 0;
+	if (!view->format)
+		return 1;
+	const char *f = view->format;
+	while (*f && strchr("@=<>!", *f))
+		f++;
+	return *f && !f[1] && strchr(formats, *f);
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	boards: contiguous uint8 buffer, N x n_board (3-5 cards, 0-51)
+	pockets: contiguous uint8 buffer, N x 2 (holdem) or N x 4 (omaha)
+	ranks: writable contiguous int32 buffer, N
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+OUTPUT:
+	None, ranks are written into the ranks buffer
+*/
+static PyObject *_rayeval_eval_hands_batch(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_HANDS_BATCH);
+	char *game;
+	PyObject *py_boards, *py_pockets, *py_ranks;
+	Py_buffer boards, pockets, ranks;
+	int is_omaha, n_threads = 1, i, invalid = 0;
+
+	if (!PyArg_ParseTuple(args, "sOOO|i", &game, &py_boards, &py_pockets, &py_ranks, &n_threads))
+		return NULL;
+
+	if (!strcmp(game, "omaha"))
+		is_omaha = 1;
+	else if (!strcmp(game, "holdem"))
+		is_omaha = 0;
+	else
+    	RAISE_EXCEPTION(PyExc_ValueError, "Game type must be holdem or omaha.");
+
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	if (PyObject_GetBuffer(py_boards, &boards, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT))
+		return NULL;
+	if (PyObject_GetBuffer(py_pockets, &pockets, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT))
+	{
+		PyBuffer_Release(&boards);
+		return NULL;
+	}
+	if (PyObject_GetBuffer(py_ranks, &ranks, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE))
+	{
+		PyBuffer_Release(&boards);
+		PyBuffer_Release(&pockets);
+		return NULL;
+	}
+
+	const char *error = NULL;
+	int n_hands = (int) (ranks.len / 4), n_board = 0, n_pocket = 0;
+	if (!check_buffer_format(&boards, 1, "Bbc") || !check_buffer_format(&pockets, 1, "Bbc"))
+		error = "Boards and pockets must be uint8 buffers.";
+	else if (!check_buffer_format(&ranks, 4, "iIlL"))
+		error = "Ranks must be an int32 buffer.";
+	else if (n_hands == 0 || boards.len % n_hands || pockets.len % n_hands)
+		error = "Boards, pockets and ranks must have the same number of rows.";
+	else
+	{
+		n_board = (int) (boards.len / n_hands);
+		n_pocket = (int) (pockets.len / n_hands);
+		if (n_board < 3 || n_board > 5)
+			error = "Board must contain 3-5 cards.";
+		else if (n_pocket != (is_omaha ? 4 : 2))
+			error = "Invalid number of pocket cards.";
+	}
+
+	if (!error)
+	{
+		if (n_threads <= 0)
+			n_threads = get_num_cpus();
+		if (n_threads > n_hands)
+			n_threads = n_hands;
+
+		batch_job *jobs = (batch_job *) malloc(n_threads * sizeof(batch_job));
+		for (i = 0; i < n_threads; i++)
+		{
+			int first = (int) ((int64_t) n_hands * i / n_threads), 
+				last = (int) ((int64_t) n_hands * (i + 1) / n_threads);
+			jobs[i].is_omaha = is_omaha;
+			jobs[i].n_hands = last - first;
+			jobs[i].n_board = n_board;
+			jobs[i].n_pocket = n_pocket;
+			jobs[i].invalid = 0;
+			jobs[i].boards = (unsigned char *) boards.buf + (int64_t) first * n_board;
+			jobs[i].pockets = (unsigned char *) pockets.buf + (int64_t) first * n_pocket;
+			jobs[i].ranks = (int32_t *) ranks.buf + first;
+		}
+		TABLES_ACQUIRE();
+		Py_BEGIN_ALLOW_THREADS
+		run_threads(n_threads, batch_job_run, jobs, sizeof(batch_job));
+		Py_END_ALLOW_THREADS
+		TABLES_RELEASE();
+		for (i = 0; i < n_threads; i++)
+			invalid += jobs[i].invalid;
+		free(jobs);
+		if (invalid)
+			error = "Cards must be 0-51.";
+	}
+
+	PyBuffer_Release(&boards);
+	PyBuffer_Release(&pockets);
+	PyBuffer_Release(&ranks);
+	if (error)
+		RAISE_EXCEPTION(PyExc_ValueError, error);
+	stats_add_evaluations(n_hands);
+	Py_RETURN_NONE;
+}
+
+static PyObject *ev_list(const double *ev, int n)
+{
+   	PyObject *py_ev = PyList_New(n);
+   	for (int i = 0; i < n; i++)
+   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+	return py_ev;
+}
+
+// (ev, win, tie, categories, stderr, n_deals), see eval_mc
+static PyObject *mc_stats_tuple(const double *ev, const mc_stats *stats, int n_players)
+{
+	PyObject *py_categories = PyList_New(n_players);
+	for (int k = 0; k < n_players; k++)
+		PyList_SET_ITEM(py_categories, (Py_ssize_t) k, ev_list(stats->category[k], 10));
+	return Py_BuildValue("(NNNNNd)", ev_list(ev, n_players), ev_list(stats->win, n_players),
+		ev_list(stats->tie, n_players), py_categories, ev_list(stats->std_err, n_players),
+		stats->n_deals);
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int)
+	pockets: list (int)
+	iterations: int
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+	exact_threshold: int (optional, 0 by default) - enumerate all deals instead
+		of sampling if there are no more than that many of them
+	interleave: int (optional, MC_INTERLEAVE by default) - number of deals
+		walked in lockstep by every thread, 1 for one deal at a time
+	stratify: int (optional, 0 by default) - stratify the deals over the first
+		masked board card
+	seed: long (optional, -1 by default) - seed of the streams for common random
+		numbers across calls, -1 to draw it from the global generator
+	with_stats: int (optional, 0 by default) - tally the same deals by outcome 
+		and hand category too
+OUTPUT:
+	ev: list (doble)
+	or, with_stats: (ev, win, tie, categories, stderr, n_deals):
+		(list (double), list (double), list (double), list (list (double)), 
+		list (double), double) - the shares of the deals won outright, split
+		and ending in each hand category (0-9, see hand_rank_str) per player, 
+		the standard errors of the equities (0 if enumerated) and the deals
+*/
+static PyObject *_rayeval_eval_mc(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_MC);
+	char *game;
+	PyObject *py_board, *py_pocket, *py_ev;
+	int i, n_board, n_pocket, n_threads = 1, interleave = MC_INTERLEAVE, stratify = 0;
+	int iterations, n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha, with_stats = 0;
+	long long exact_threshold = 0, py_seed = -1;
+	double ev[MAX_PLAYERS];
+	mc_stats stats;
+
+	if (!PyArg_ParseTuple(args, "sOOi|iLiiLi", &game, &py_board, &py_pocket, &iterations, 
+		&n_threads, &exact_threshold, &interleave, &stratify, &py_seed, &with_stats))
+		return NULL;
+
+    if (iterations <= 0)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+    if (interleave < 1 || interleave > MC_MAX_INTERLEAVE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Interleave must be between 1 and 32.");
+
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+	int exact = (count_deals(board, n_board, pocket, n_players, is_omaha ? 4 : 2) <= 
+		(double) exact_threshold);
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	if (exact)
+		eval_exact(board, n_board, pocket, n_players, is_omaha, n_threads, ev, 
+			with_stats ? &stats : NULL);
+	else
+		eval_monte_carlo_parallel(iterations, board, n_board, pocket, n_players, is_omaha, 
+			n_threads, seed, ev, interleave, stratify, with_stats ? &stats : NULL);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+	if (with_stats)
+		return mc_stats_tuple(ev, &stats, n_players);
+   	py_ev = PyList_New(n_players);
+   	for (i = 0; i < n_players; i++)
+   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+
+   	return py_ev;
+}
+
+/*
+INPUT:
+	spots: list (tuple) - (game, board, pockets, iterations) per spot, see eval_mc
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+	exact_threshold, interleave, stratify, seed: see eval_mc, the same for all spots
+OUTPUT:
+	ev: list (list (double)) - per spot
+*/
+static PyObject *_rayeval_eval_mc_batch(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_MC_BATCH);
+	PyObject *py_spots, *py_result;
+	int i, k, n_spots, n_threads = 1, interleave = MC_INTERLEAVE, stratify = 0, n_pocket;
+	long long exact_threshold = 0, py_seed = -1;
+
+	if (!PyArg_ParseTuple(args, "O|iLiiL", &py_spots, &n_threads, &exact_threshold, 
+		&interleave, &stratify, &py_seed))
+		return NULL;
+  	if (!PyList_Check(py_spots))
+    	RAISE_EXCEPTION(PyExc_TypeError, "Spots must be a list.");
+    if (interleave < 1 || interleave > MC_MAX_INTERLEAVE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Interleave must be between 1 and 32.");
+
+	n_spots = (int) PyList_Size(py_spots);
+	mc_spot *spots = (mc_spot *) malloc(MAX(n_spots, 1) * sizeof(mc_spot));
+	const char *error = NULL;
+	for (i = 0; i < n_spots && !error; i++)
+	{
+		PyObject *py_spot = PyList_GetItem(py_spots, i), *py_board, *py_pocket;
+		char *game;
+		if (!PyTuple_Check(py_spot) || 
+			!PyArg_ParseTuple(py_spot, "sOOi", &game, &py_board, &py_pocket, &spots[i].N))
+		{
+			PyErr_Clear();
+			error = "Every spot must be a (game, board, pockets, iterations) tuple.";
+		}
+		else if (!parse_board_and_pockets(game, py_board, py_pocket, spots[i].board, spots[i].pocket, 
+			&spots[i].n_board, &n_pocket, &spots[i].n_players, &spots[i].is_omaha))
+		{
+			free(spots);
+			return NULL;
+		}
+		else if (spots[i].N <= 0)
+			error = "Iterations must be a positive integer.";
+		else if (!spots[i].is_omaha && !HR)
+			error = "Please load 7-card hand ranks first.";
+		else if (spots[i].is_omaha && !HR9)
+			error = "Please load 9-card hand ranks first.";
+	}
+	if (error)
+	{
+		free(spots);
+		RAISE_EXCEPTION(PyExc_ValueError, error);
+	}
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+	double *ev = (double *) malloc(MAX(n_spots, 1) * MAX_PLAYERS * sizeof(double));
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	// unseeded spots sample independently, seeded ones like eval_mc() with that seed
+	eval_monte_carlo_batch(n_spots, spots, n_threads, seed, py_seed < 0, (double) exact_threshold, 
+		interleave, stratify, ev);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+	py_result = PyList_New(n_spots);
+	for (i = 0; i < n_spots; i++)
+	{
+		PyObject *py_ev = PyList_New(spots[i].n_players);
+		for (k = 0; k < spots[i].n_players; k++)
+			PyList_SET_ITEM(py_ev, (Py_ssize_t) k, PyFloat_FromDouble(ev[i * MAX_PLAYERS + k]));
+		PyList_SET_ITEM(py_result, (Py_ssize_t) i, py_ev);
+	}
+	free(ev);
+	free(spots);
+	return py_result;
+}
+
+#define MC_ASYNC_CAPSULE "rayeval.mc_async"
+
+static void mc_async_capsule_free(PyObject *py_run)
+{
+	mc_async *run = (mc_async *) PyCapsule_GetPointer(py_run, MC_ASYNC_CAPSULE);
+	if (!run)
+		return;
+	// the run never takes the GIL, but it may have to finish a round first
+	Py_BEGIN_ALLOW_THREADS
+	mc_async_free(run);
+	Py_END_ALLOW_THREADS
+}
+
+static mc_async *parse_mc_async(PyObject *args, double *value)
+{
+	PyObject *py_run;
+	if (!PyArg_ParseTuple(args, value ? "Od" : "O", &py_run, value))
+		return NULL;
+	return (mc_async *) PyCapsule_GetPointer(py_run, MC_ASYNC_CAPSULE);
+}
+
+static const char *mc_async_states[] = {"running", "done", "cancelled", "timeout"};
+
+/*
+INPUT:
+	game, board, pockets, iterations, n_threads, interleave, stratify, seed: see eval_mc
+	timeout: float (optional, 0 by default) - stop after that many seconds, 0 for no limit
+	chunk: int (optional, MC_ASYNC_CHUNK by default) - deals per task
+OUTPUT:
+	run: capsule - the run, cancelled when it's released
+*/
+static PyObject *_rayeval_eval_mc_async(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_MC_ASYNC);
+	char *game;
+	PyObject *py_board, *py_pocket;
+	int n_board, n_pocket, n_threads = 1, interleave = MC_INTERLEAVE, stratify = 0, chunk = MC_ASYNC_CHUNK;
+	int iterations, n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha;
+	long long py_seed = -1;
+	double timeout = 0.0;
+
+	if (!PyArg_ParseTuple(args, "sOOi|iiiLdi", &game, &py_board, &py_pocket, &iterations, 
+		&n_threads, &interleave, &stratify, &py_seed, &timeout, &chunk))
+		return NULL;
+    if (iterations <= 0)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+    if (chunk <= 0)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Chunk must be a positive integer.");
+    if (interleave < 1 || interleave > MC_MAX_INTERLEAVE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Interleave must be between 1 and 32.");
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+	mc_async *run = mc_async_start(iterations, board, n_board, pocket, n_players, is_omaha, 
+		n_threads, seed, interleave, stratify, chunk, timeout);
+	if (!run)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to start a thread.");
+	return PyCapsule_New(run, MC_ASYNC_CAPSULE, mc_async_capsule_free);
+}
+
+/*
+INPUT:
+	run: capsule
+	timeout: float - seconds to wait for the run to stop, 0 or negative for no limit
+OUTPUT:
+	state: str - "running", "done", "cancelled" or "timeout"
+*/
+static PyObject *_rayeval_mc_async_wait(PyObject *self, PyObject *args)
+{
+	double timeout;
+	mc_async *run = parse_mc_async(args, &timeout);
+	if (!run)
+		return NULL;
+	int state;
+	Py_BEGIN_ALLOW_THREADS
+	state = mc_async_wait(run, timeout);
+	Py_END_ALLOW_THREADS
+	return PyString_FromString(mc_async_states[state]);
+}
+
+/*
+INPUT:
+	run: capsule
+OUTPUT:
+	(iterations, ev, state): (int, list (double), str) - deals done so far and their equities
+*/
+static PyObject *_rayeval_mc_async_progress(PyObject *self, PyObject *args)
+{
+	mc_async *run = parse_mc_async(args, NULL);
+	if (!run)
+		return NULL;
+	int i, state;
+	double ev[MAX_PLAYERS];
+	int n_done = mc_async_progress(run, ev, &state);
+   	PyObject *py_ev = PyList_New(run->n_players);
+   	for (i = 0; i < run->n_players; i++)
+   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+	return Py_BuildValue("(iNs)", n_done, py_ev, mc_async_states[state]);
+}
+
+// INPUT:
+//	run: capsule
+static PyObject *_rayeval_mc_async_cancel(PyObject *self, PyObject *args)
+{
+	mc_async *run = parse_mc_async(args, NULL);
+	if (!run)
+		return NULL;
+	run->cancelled = 1;
+	Py_RETURN_NONE;
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int)
+	ranges: list (tuple) - (cards, weights) per player: a list (int) of 2 or 4 
+		cards per combo, 0-51 or 255 for a random card, and a list (double) of 
+		the combo weights
+	iterations: int
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+	exact_threshold: float (optional, 0 by default) - enumerate all combos and 
+		deals instead of sampling if there are no more than that many of them
+	seed: long (optional, -1 by default) - see eval_mc
+OUTPUT:
+	(ev, exact): (list (double), bool)
+*/
+static PyObject *_rayeval_eval_range_equity(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_RANGE_EQUITY);
+	char *game;
+	PyObject *py_board, *py_ranges, *py_ev;
+	int i, k, n_board, n_pocket, n_players, n_threads = 1, iterations, is_omaha, exact, result;
+	int board[5], pocket[4 * MAX_PLAYERS];
+	long long py_seed = -1;
+	double exact_threshold = 0.0, ev[MAX_PLAYERS];
+	range_t ranges[MAX_PLAYERS];
+
+	if (!PyArg_ParseTuple(args, "sOOi|idL", &game, &py_board, &py_ranges, &iterations, 
+		&n_threads, &exact_threshold, &py_seed))
+		return NULL;
+    if (iterations <= 0)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+  	if (!PyList_Check(py_ranges))
+    	RAISE_EXCEPTION(PyExc_TypeError, "Ranges must be a list.");
+	n_players = (int) PyList_Size(py_ranges);
+	if (n_players < 1 || n_players > MAX_PLAYERS)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Invalid number of players.");
+
+	// the board goes through the usual checks along with a dummy pocket per player
+	PyObject *py_dummy = PyList_New(0);
+	for (i = 0; i < n_players * (strcmp(game, "omaha") ? 2 : 4); i++)
+	{
+		PyObject *item = PyInt_FromLong(255);
+		PyList_Append(py_dummy, item);
+		Py_DECREF(item);
+	}
+	int *ok = parse_board_and_pockets(game, py_board, py_dummy, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha);
+	Py_DECREF(py_dummy);
+	if (!ok)
+		return NULL;
+
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	int size = is_omaha ? 4 : 2, n_ranges = 0;
+	const char *error = NULL;
+	for (k = 0; k < n_players && !error; k++)
+	{
+		PyObject *py_range = PyList_GetItem(py_ranges, k), *py_cards, *py_weights;
+		if (!PyTuple_Check(py_range) || PyTuple_Size(py_range) != 2 ||
+			!PyList_Check(py_cards = PyTuple_GetItem(py_range, 0)) ||
+			!PyList_Check(py_weights = PyTuple_GetItem(py_range, 1)))
+		{
+			error = "Every range must be a tuple of two lists.";
+			break;
+		}
+		int n = (int) PyList_Size(py_weights);
+		if (PyList_Size(py_cards) != n * size)
+		{
+			error = "Invalid number of range cards.";
+			break;
+		}
+		int *cards = (int *) malloc(MAX(n, 1) * size * sizeof(int));
+		double *weights = (double *) malloc(MAX(n, 1) * sizeof(double));
+		for (i = 0; i < n * size && !error; i++)
+		{
+			PyObject *item = PyList_GetItem(py_cards, i);
+			cards[i] = PyInt_Check(item) ? (int) PyInt_AsLong(item) : -1;
+			if ((cards[i] < 0 || cards[i] > 51) && cards[i] != 255)
+				error = "Range cards must be 0-51 or 255.";
+		}
+		for (i = 0; i < n && !error; i++)
+		{
+			weights[i] = PyFloat_AsDouble(PyList_GetItem(py_weights, i));
+			if (PyErr_Occurred())
+			{
+				PyErr_Clear();
+				error = "Range weights must be numbers.";
+			}
+		}
+		if (!error && range_init(&ranges[k], n, size, cards, weights))
+			error = "Every range needs distinct cards in every combo and a positive total weight.";
+		if (!error)
+			n_ranges++;
+		free(cards);
+		free(weights);
+	}
+	if (error)
+	{
+		for (k = 0; k < n_ranges; k++)
+			range_free(&ranges[k]);
+		RAISE_EXCEPTION(PyExc_ValueError, error);
+	}
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	result = eval_range_equity(iterations, board, n_board, ranges, n_players, is_omaha, 
+		n_threads, seed, exact_threshold, ev, &exact);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+	for (k = 0; k < n_players; k++)
+		range_free(&ranges[k]);
+	if (result)
+		RAISE_EXCEPTION(PyExc_ValueError, "No combos of the ranges can be dealt together.");
+
+   	py_ev = PyList_New(n_players);
+   	for (i = 0; i < n_players; i++)
+   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+   	return Py_BuildValue("(NO)", py_ev, exact ? Py_True : Py_False);
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int)
+	pockets: list (int)
+	max_iterations: int - the iteration budget
+	target_stderr: float - stop once the standard error of every equity is at most that
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+	interleave: int (optional, MC_INTERLEAVE by default)
+	chunk: int (optional, MC_ADAPTIVE_CHUNK by default) - size of the first round
+	stratify, seed: see eval_mc
+OUTPUT:
+	(ev, stderr, iterations): (list (double), list (double), int)
+*/
+static PyObject *_rayeval_eval_mc_adaptive(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_MC_ADAPTIVE);
+	char *game;
+	PyObject *py_board, *py_pocket, *py_ev, *py_std_err;
+	int i, n_board, n_pocket, n_threads = 1, interleave = MC_INTERLEAVE, chunk = MC_ADAPTIVE_CHUNK;
+	int max_iterations, n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha, n_done = 0;
+	int stratify = 0;
+	long long py_seed = -1;
+	double target_stderr, ev[MAX_PLAYERS], std_err[MAX_PLAYERS];
+
+	if (!PyArg_ParseTuple(args, "sOOid|iiiiL", &game, &py_board, &py_pocket, &max_iterations, 
+		&target_stderr, &n_threads, &interleave, &chunk, &stratify, &py_seed))
+		return NULL;
+
+    if (max_iterations <= 1)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be an integer greater than 1.");
+    if (!(target_stderr >= 0.0))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Target standard error must be non-negative.");
+    if (interleave < 1 || interleave > MC_MAX_INTERLEAVE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Interleave must be between 1 and 32.");
+    if (chunk <= 1)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Chunk must be an integer greater than 1.");
+
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	eval_monte_carlo_adaptive(max_iterations, board, n_board, pocket, n_players, is_omaha, 
+		n_threads, seed, interleave, stratify, target_stderr, chunk, ev, std_err, &n_done);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+   	py_ev = PyList_New(n_players);
+   	py_std_err = PyList_New(n_players);
+   	for (i = 0; i < n_players; i++)
+   	{
+   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+   		PyList_SET_ITEM(py_std_err, (Py_ssize_t) i, PyFloat_FromDouble(std_err[i]));
+   	}
+   	return Py_BuildValue("(NNi)", py_ev, py_std_err, n_done);
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int)
+	pockets: list (int)
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+OUTPUT:
+	ev: list (doble) - exact equities over all deals of the masked cards
+*/
+static PyObject *_rayeval_eval_exact(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_EXACT);
+	char *game;
+	PyObject *py_board, *py_pocket, *py_ev;
+	int i, n_board, n_pocket, n_threads = 1;
+	int n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha;
+	double ev[MAX_PLAYERS];
+
+	if (!PyArg_ParseTuple(args, "sOO|i", &game, &py_board, &py_pocket, &n_threads))
+		return NULL;
+
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	eval_exact(board, n_board, pocket, n_players, is_omaha, n_threads, ev);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+   	py_ev = PyList_New(n_players);
+   	for (i = 0; i < n_players; i++)
+   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+
+   	return py_ev;
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int)
+	pockets: list (int)
+OUTPUT:
+	n_deals: float - number of distinct deals of the masked cards
+*/
+static PyObject *_rayeval_count_deals(PyObject *self, PyObject *args)
+{
+	char *game;
+	PyObject *py_board, *py_pocket;
+	int n_board, n_pocket, n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha;
+
+	if (!PyArg_ParseTuple(args, "sOO", &game, &py_board, &py_pocket))
+		return NULL;
+
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+
+	return PyFloat_FromDouble(count_deals(board, n_board, pocket, n_players, is_omaha ? 4 : 2));
+}
+
+/*
+INPUT:
+	game: string - holdem/omaha
+	board: list (int) - 3-5 cards, 0-51 or 255 for masked
+	pockets: list (int) - 2 or 4 cards per player, 0-51 or 255 for masked
+OUTPUT:
+	(board, pockets, n): (list (int), list (int), int) - the suit-relabelled 
+		representative of the class of the spot, the board and every pocket 
+		sorted with the masked cards last, and the number of spots in the class
+*/
+static PyObject *_rayeval_canonical_form(PyObject *self, PyObject *args)
+{
+	char *game;
+	PyObject *py_board, *py_pocket, *py_cards[2];
+	int i, n_board, n_pocket, n_players, is_omaha, cards[5 + 4 * MAX_PLAYERS], canonical[5 + 4 * MAX_PLAYERS];
+	int group_sizes[1 + MAX_PLAYERS];
+
+	if (!PyArg_ParseTuple(args, "sOO", &game, &py_board, &py_pocket))
+		return NULL;
+	if (!parse_board_and_pockets(game, py_board, py_pocket, cards, cards + 5, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+
+	memmove(cards + n_board, cards + 5, n_pocket * sizeof(int));
+	group_sizes[0] = n_board;
+	for (i = 0; i < n_players; i++)
+		group_sizes[i + 1] = n_pocket / n_players;
+	int n = suit_canonicalize(cards, group_sizes, 1 + n_players, canonical, NULL);
+
+	py_cards[0] = PyList_New(n_board);
+	py_cards[1] = PyList_New(n_pocket);
+	for (i = 0; i < n_board + n_pocket; i++)
+		PyList_SET_ITEM(py_cards[i >= n_board], (Py_ssize_t) (i >= n_board ? i - n_board : i), 
+			PyInt_FromLong(canonical[i]));
+	return Py_BuildValue("(NNi)", py_cards[0], py_cards[1], n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							TURN AND RIVER OUTS
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+	Omaha equity of a hero pocket against a random one on a flop, by turn card
+	and by turn and river cards, in a single pass over sampled villain pockets.
+
+	The flop and the hero are fixed, so the board walks for every turn and
+	river (the 9-card table is set-based, so (t, r) and (r, t) lead to the
+	same states) and the hero's scores are computed once up front. A trial
+	samples a villain pocket (and a river card unless the full matrix is 
+	asked for) and only walks the villain's 4 cards from each board state,
+	all of the boards at once with gather_step(). The same villain is used
+	for every turn card, so the turn EVs share their random numbers.
+
+	Turns related by a suit symmetry of the flop and the hero have the same
+	EVs, so only the smallest turn of every class is walked (with all of
+	its rivers) and the others are copied from it, rivers relabelled.
+*/
+
+typedef struct {
+	int fs, snf, flush[5]; // board walk states, flush[s] for flush suit s
+	int hero; // the hero's score on this board
+} outs_board;
+
+typedef struct {
+	const outs_board *boards; // boards[t * 52 + r] for the turn t and the river r, 0-51
+	int deck[52], n_deck, N, rivers;
+	int turn_class[52]; // the smallest turn of the class of every card
+	rng_t rng;
+	double sum[52 * 52]; // payoffs and counts by turn * 52 + river
+	int count[52 * 52];
+} outs_job;
+
+// walks the 4 pocket cards (1-52) of n boards from their 5-card states
+static void outs_walk_pocket(const outs_board *const *boards, const int *cards, int n,
+	int *fs, int *score, int *column, int *flushes, int *sf)
+{
+	int i, j, f, n_flushes = 0;
+	if (HR9_compact)
+	{
+		const int *nfs = HR9C.nodes[HR9C_FLUSH_SUITS], *nnf = HR9C.nodes[HR9C_NO_FLUSH],
+			*nfr = HR9C.nodes[HR9C_FLUSH_RANKS];
+		for (i = 0; i < n; i++)
+		{
+			int s_fs = boards[i]->fs, s_nf = boards[i]->snf;
+			for (j = 0; j < 3; j++)
+			{
+				s_fs = nfs[s_fs + hr9c_suit_class[cards[j]]];
+				s_nf = nnf[s_nf + hr9c_rank_class[cards[j]]];
+			}
+			s_fs = HR9C.leaves[HR9C_FLUSH_SUITS][s_fs + hr9c_suit_class[cards[3]]];
+			s_nf = HR9C.leaves[HR9C_NO_FLUSH][s_nf + hr9c_rank_class[cards[3]]];
+			if (s_fs != 0)
+			{
+				const unsigned char *flush_class = hr9c_flush_class[s_fs];
+				int s_fr = boards[i]->flush[s_fs];
+				for (j = 0; j < 3; j++)
+					s_fr = nfr[s_fr + flush_class[cards[j]]];
+				s_fr = HR9C.leaves[HR9C_FLUSH_RANKS][s_fr + flush_class[cards[3]]];
+				s_nf = MAX(s_nf, s_fr);
+			}
+			score[i] = s_nf;
+		}
+		return;
+	}
+	for (i = 0; i < n; i++)
+	{
+		fs[i] = boards[i]->fs;
+		score[i] = boards[i]->snf;
+	}
+	for (j = 0; j < 4; j++)
+	{
+		for (i = 0; i < n; i++)
+			column[i] = cards[j];
+		gather_step(HR9, fs, column, n);
+		gather_step(HR9, score, column, n);
+	}
+	for (i = 0; i < n; i++)
+		if (fs[i] != 0)
+		{
+			sf[n_flushes] = boards[i]->flush[fs[i]];
+			flushes[n_flushes++] = i;
+		}
+	for (j = 0; j < 4 && n_flushes; j++)
+	{
+		for (f = 0; f < n_flushes; f++)
+			column[f] = cards[j] + 4 - fs[flushes[f]];
+		gather_step(HR9, sf, column, n_flushes);
+	}
+	for (f = 0; f < n_flushes; f++)
+		score[flushes[f]] = MAX(score[flushes[f]], sf[f]);
+}
+
+static void *outs_job_run(void *arg)
+{
+	outs_job *job = (outs_job *) arg;
+	const int max_boards = 52 * 51 / 2;
+	const outs_board **boards = (const outs_board **) malloc(max_boards * sizeof(outs_board *));
+	int *turns = (int *) malloc(max_boards * sizeof(int)), *rivers = (int *) malloc(max_boards * sizeof(int));
+	int *fs = (int *) malloc(5 * max_boards * sizeof(int)), *score = fs + max_boards,
+		*column = fs + 2 * max_boards, *flushes = fs + 3 * max_boards, *sf = fs + 4 * max_boards;
+	int i, j, k, n_deck = job->n_deck;
+	memset(job->sum, 0, sizeof(job->sum));
+	memset(job->count, 0, sizeof(job->count));
+	for (i = 0; i < job->N; i++)
+	{
+		int sample[52], villain[4], river = -1, n = 0;
+		uint64_t used = 0;
+		random_sample_52_ross(n_deck, job->rivers ? 4 : 5, sample, &job->rng);
+		for (j = 0; j < 4; j++)
+		{
+			villain[j] = job->deck[sample[j]] + 1;
+			used |= 1LLU << job->deck[sample[j]];
+		}
+		if (!job->rivers)
+		{
+			river = job->deck[sample[4]];
+			used |= 1LLU << river;
+		}
+		for (j = 0; j < n_deck; j++)
+		{
+			int t = job->deck[j];
+			if (used & (1LLU << t))
+				continue;
+			if (!job->rivers && job->turn_class[t] != t)
+				continue;
+			if (!job->rivers)
+			{
+				turns[n] = t;
+				rivers[n] = river;
+				boards[n++] = job->boards + t * 52 + river;
+				continue;
+			}
+			for (k = j + 1; k < n_deck; k++)
+			{
+				int r = job->deck[k];
+				if ((used & (1LLU << r)) || (job->turn_class[t] != t && job->turn_class[r] != r))
+					continue;
+				turns[n] = t;
+				rivers[n] = r;
+				boards[n++] = job->boards + t * 52 + r;
+			}
+		}
+		outs_walk_pocket(boards, villain, n, fs, score, column, flushes, sf);
+		for (j = 0; j < n; j++)
+		{
+			int hero = boards[j]->hero;
+			double payoff = (hero > score[j]) ? 1.0 : ((hero == score[j]) ? 0.5 : 0.0);
+			int cell = turns[j] * 52 + rivers[j];
+			if (job->turn_class[turns[j]] == turns[j])
+			{
+				job->sum[cell] += payoff;
+				job->count[cell]++;
+			}
+			if (job->rivers && job->turn_class[rivers[j]] == rivers[j])
+			{
+				// the board is the same with the turn and the river swapped
+				cell = rivers[j] * 52 + turns[j];
+				job->sum[cell] += payoff;
+				job->count[cell]++;
+			}
+		}
+	}
+	free(boards);
+	free(turns);
+	free(rivers);
+	free(fs);
+	return NULL;
+}
+
+// walks board cards (0-51) from the given states
+static void outs_walk_board(const int *cards, int n, int *fs, int *snf, int *flush)
+{
+	int i, s;
+	for (i = 0; i < n; i++)
+	{
+		int c = cards[i] + 1;
+		if (HR9_compact)
+		{
+			*fs = HR9C.nodes[HR9C_FLUSH_SUITS][*fs + hr9c_suit_class[c]];
+			*snf = HR9C.nodes[HR9C_NO_FLUSH][*snf + hr9c_rank_class[c]];
+			for (s = 1; s <= 4; s++)
+				flush[s] = HR9C.nodes[HR9C_FLUSH_RANKS][flush[s] + hr9c_flush_class[s][c]];
+		}
+		else
+		{
+			*fs = HR9[*fs + c];
+			*snf = HR9[*snf + c];
+			for (s = 1; s <= 4; s++)
+				flush[s] = HR9[(4 - s) + flush[s] + c];
+		}
+	}
+}
+
+// the cards left after the flop and the hero, returns their number
+static int outs_deck(const int *flop, const int *hero, int *deck, uint64_t *dead)
+{
+	int i, n_deck = 0;
+	*dead = 0;
+	for (i = 0; i < 3; i++)
+		*dead |= 1LLU << flop[i];
+	for (i = 0; i < 4; i++)
+		*dead |= 1LLU << hero[i];
+	for (i = 0; i < 52; i++)
+		if (!(*dead & (1LLU << i)))
+			deck[n_deck++] = i;
+	return n_deck;
+}
+
+// the walk states and the hero's scores of all turns and rivers, to be freed
+outs_board *build_outs_boards(const int *flop, const int *hero)
+{
+	int i, j, deck[52];
+	uint64_t dead;
+	int n_deck = outs_deck(flop, hero, deck, &dead);
+
+	int fs0, snf0, flush0[5] = {0, 0, 0, 0, 0};
+	if (HR9_compact)
+	{
+		fs0 = HR9C.root[HR9C_FLUSH_SUITS];
+		snf0 = HR9C.root[HR9C_NO_FLUSH];
+		for (i = 1; i <= 4; i++)
+			flush0[i] = HR9C.root[HR9C_FLUSH_RANKS];
+	}
+	else
+	{
+		fs0 = 106;
+		snf0 = HR9[0] + 53;
+		for (i = 1; i <= 4; i++)
+			flush0[i] = HR9[1] + 56;
+	}
+	outs_walk_board(flop, 3, &fs0, &snf0, flush0);
+
+	outs_board *boards = (outs_board *) calloc(52 * 52, sizeof(outs_board));
+	const outs_board **hero_boards = (const outs_board **) calloc(52 * 52, sizeof(outs_board *));
+	int n_boards = 0, hero_cards[4], *work = (int *) malloc(5 * 52 * 52 * sizeof(int));
+	for (i = 0; i < 4; i++)
+		hero_cards[i] = hero[i] + 1;
+	for (i = 0; i < n_deck; i++)
+		for (j = i + 1; j < n_deck; j++)
+		{
+			int cards[2] = {deck[i], deck[j]};
+			outs_board *b = boards + deck[i] * 52 + deck[j];
+			b->fs = fs0;
+			b->snf = snf0;
+			memcpy(b->flush, flush0, sizeof(flush0));
+			outs_walk_board(cards, 2, &b->fs, &b->snf, b->flush);
+			hero_boards[n_boards++] = b;
+		}
+	outs_walk_pocket(hero_boards, hero_cards, n_boards, work, work + 52 * 52, 
+		work + 2 * 52 * 52, work + 3 * 52 * 52, work + 4 * 52 * 52);
+	for (i = 0; i < n_boards; i++)
+	{
+		outs_board *b = (outs_board *) hero_boards[i];
+		b->hero = work[52 * 52 + i];
+		int k = (int) (b - boards), mirrored = (k % 52) * 52 + k / 52;
+		boards[mirrored] = *b;
+	}
+	free(hero_boards);
+	free(work);
+	return boards;
+}
+
+// flop: 3 cards, hero: 4 cards, all 0-51 and distinct; boards: build_outs_boards() of them;
+// flop_ev: the hero's equity on the flop, turn_ev[t]: on turn t, -1 for the dead cards;
+// river_ev[t * 52 + r] (if not NULL): on turn t and river r, -1 for the dead cards;
+// with river_ev every trial goes over all turns and rivers, otherwise over all
+// turns with one sampled river
+int eval_outs_omaha_boards(const outs_board *boards, const int *flop, const int *hero, int N, 
+	int n_threads, uint64_t seed, double *flop_ev, double *turn_ev, double *river_ev)
+{
+	int i, k, t, r, deck[52];
+	uint64_t dead;
+	int n_deck = outs_deck(flop, hero, deck, &dead);
+	if (n_threads > N)
+		n_threads = N;
+	if (n_threads < 1)
+		n_threads = 1;
+
+	// turn_class[t] = sym[turn_perm[t]](t), the smallest image of t
+	int cards[7], group_sizes[2] = {3, 4}, sym[SUIT_PERMUTATIONS][4], turn_class[52], turn_perm[52];
+	memcpy(cards, flop, 3 * sizeof(int));
+	memcpy(cards + 3, hero, 4 * sizeof(int));
+	int n_sym = suit_symmetries(cards, group_sizes, 2, sym);
+	for (t = 0; t < 52; t++)
+	{
+		turn_class[t] = t;
+		turn_perm[t] = 0;
+		for (k = 1; k < n_sym; k++)
+			if (((t & ~3) | sym[k][t & 3]) < turn_class[t])
+			{
+				turn_class[t] = (t & ~3) | sym[k][t & 3];
+				turn_perm[t] = k;
+			}
+	}
+
+	outs_job *jobs = (outs_job *) malloc(n_threads * sizeof(outs_job));
+	for (i = 0; i < n_threads; i++)
+	{
+		jobs[i].boards = boards;
+		memcpy(jobs[i].deck, deck, sizeof(deck));
+		jobs[i].n_deck = n_deck;
+		jobs[i].N = N / n_threads + (i < (N % n_threads));
+		jobs[i].rivers = (river_ev != NULL);
+		memcpy(jobs[i].turn_class, turn_class, sizeof(turn_class));
+		rng_seed(&jobs[i].rng, seed, i);
+	}
+	run_threads(n_threads, outs_job_run, jobs, sizeof(outs_job));
+
+	double total_sum = 0.0, total_count = 0.0;
+	for (t = 0; t < 52; t++)
+	{
+		double turn_sum = 0.0, turn_count = 0.0;
+		const int *perm = sym[turn_perm[t]];
+		for (r = 0; r < 52; r++)
+		{
+			double cell_sum = 0.0, cell_count = 0.0;
+			int cell = turn_class[t] * 52 + ((r & ~3) | perm[r & 3]);
+			for (i = 0; i < n_threads; i++)
+			{
+				cell_sum += jobs[i].sum[cell];
+				cell_count += jobs[i].count[cell];
+			}
+			if (river_ev)
+				river_ev[t * 52 + r] = (dead & (1LLU << t)) || (dead & (1LLU << r)) || t == r ? -1.0 :
+					(cell_count > 0 ? cell_sum / cell_count : 0.0);
+			turn_sum += cell_sum;
+			turn_count += cell_count;
+		}
+		turn_ev[t] = (dead & (1LLU << t)) ? -1.0 : (turn_count > 0 ? turn_sum / turn_count : 0.0);
+		total_sum += turn_sum;
+		total_count += turn_count;
+	}
+	*flop_ev = total_count > 0 ? total_sum / total_count : 0.0;
+	free(jobs);
+	return 0;
+}
+
+int eval_outs_omaha(const int *flop, const int *hero, int N, int n_threads, uint64_t seed,
+	double *flop_ev, double *turn_ev, double *river_ev)
+{
+	outs_board *boards = build_outs_boards(flop, hero);
+	eval_outs_omaha_boards(boards, flop, hero, N, n_threads, seed, flop_ev, turn_ev, river_ev);
+	free(boards);
+	return 0;
+}
+
+// checks an Omaha flop (3 known cards, the others masked) and one hero pocket,
+// returns the error or NULL and the flop cards
+static const char *outs_query_error(const int *board, int n_board, const int *pocket, 
+	int n_players, int *flop)
+{
+	int i, n_flop = 0;
+	uint64_t seen = 0;
+	if (n_players != 1)
+		return "Number of players must be one.";
+	for (i = 0; i < n_board; i++)
+		if (board[i] != 255)
+		{
+			if (n_flop == 3)
+				return "Board must contain exactly 3 known cards.";
+			flop[n_flop++] = board[i];
+		}
+	if (n_flop != 3)
+		return "Board must contain exactly 3 known cards.";
+	for (i = 0; i < 4; i++)
+		if (pocket[i] == 255)
+			return "Masked pocket is not allowed.";
+	for (i = 0; i < 7; i++)
+	{
+		int c = (i < 3) ? flop[i] : pocket[i - 3];
+		if (seen & (1LLU << c))
+			return "Cards must be distinct.";
+		seen |= 1LLU << c;
+	}
+	return NULL;
+}
+
+static int *parse_outs_query(PyObject *py_board, PyObject *py_pocket, int *flop, int *pocket)
+{
+	int n_board, n_pocket, n_players, is_omaha, board[5];
+	static int ok = 1;
+	char game[] = "omaha";
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+	const char *error = outs_query_error(board, n_board, pocket, n_players, flop);
+	if (error)
+		RAISE_EXCEPTION(PyExc_ValueError, error);
+	return &ok;
+}
+
+// runs an outs query off the given boards (built for the call if NULL), 
+// returns the output of eval_turn_outs_vs_random_omaha (or with rivers set,
+// of eval_river_outs_vs_random_omaha)
+static PyObject *outs_query(const outs_board *boards, const int *flop, const int *pocket, 
+	int iterations, int n_threads, long long py_seed, int rivers)
+{
+	PyObject *py_result;
+	int i, j;
+	double flop_ev, turn_ev[52], *river_ev = NULL;
+
+	if (iterations <= 0)
+		RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+	if (!HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+	if (rivers)
+		river_ev = (double *) malloc(52 * 52 * sizeof(double));
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	if (boards)
+		eval_outs_omaha_boards(boards, flop, pocket, iterations, n_threads, seed, &flop_ev, turn_ev, river_ev);
+	else
+		eval_outs_omaha(flop, pocket, iterations, n_threads, seed, &flop_ev, turn_ev, river_ev);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+	if (!rivers)
+	{
+	   	py_result = PyList_New(53);
+		PyList_SET_ITEM(py_result, (Py_ssize_t) 0, PyFloat_FromDouble(flop_ev));
+	   	for (i = 0; i < 52; i++)
+			PyList_SET_ITEM(py_result, (Py_ssize_t) (i + 1), PyFloat_FromDouble(turn_ev[i]));
+	   	return py_result;
+	}
+	PyObject *py_turns = PyList_New(52), *py_rivers = PyList_New(52);
+   	for (i = 0; i < 52; i++)
+   	{
+		PyObject *py_row = PyList_New(52);
+		for (j = 0; j < 52; j++)
+			PyList_SET_ITEM(py_row, (Py_ssize_t) j, PyFloat_FromDouble(river_ev[i * 52 + j]));
+		PyList_SET_ITEM(py_turns, (Py_ssize_t) i, PyFloat_FromDouble(turn_ev[i]));
+		PyList_SET_ITEM(py_rivers, (Py_ssize_t) i, py_row);
+	}
+	free(river_ev);
+   	return Py_BuildValue("(dNN)", flop_ev, py_turns, py_rivers);
+}
+
+/*
+INPUT:
+	board: list (int) - 3 known cards, the others masked
+	pockets: list (int) - must contain 4 cards
+	iterations: int - number of villain pockets (and rivers) sampled
+	seed: long (optional, -1 by default) - -1 to draw it from the global generator
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+OUTPUT:
+	result: list (doble)
+		result[0] - flop ev
+		result[1-52] - ev by turn outs, -1 for the dead cards
+*/
+static PyObject *_eval_turn_outs_vs_random_omaha(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_OUTS);
+	PyObject *py_board, *py_pocket;
+	int iterations, n_threads = 1, flop[3], pocket[4 * MAX_PLAYERS];
+	long long py_seed = -1;
+
+	if (!PyArg_ParseTuple(args, "OOi|Li", &py_board, &py_pocket, &iterations, &py_seed, &n_threads))
+		return NULL;
+	if (!parse_outs_query(py_board, py_pocket, flop, pocket))
+		return NULL;
+	return outs_query(NULL, flop, pocket, iterations, n_threads, py_seed, 0);
+}
+
+/*
+INPUT:
+	board, pockets, iterations, seed, n_threads: see eval_turn_outs_vs_random_omaha,
+		but every sampled villain pocket is evaluated on all turns and rivers
+OUTPUT:
+	(flop_ev, turn_ev, river_ev): (double, list (double), list (list (double)))
+		turn_ev[t] - ev on turn t, river_ev[t][r] - ev on turn t and river r, 
+		-1 for the dead cards
+*/
+static PyObject *_eval_river_outs_vs_random_omaha(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_EVAL_OUTS);
+	PyObject *py_board, *py_pocket;
+	int iterations, n_threads = 1, flop[3], pocket[4 * MAX_PLAYERS];
+	long long py_seed = -1;
+
+	if (!PyArg_ParseTuple(args, "OOi|Li", &py_board, &py_pocket, &iterations, &py_seed, &n_threads))
+		return NULL;
+	if (!parse_outs_query(py_board, py_pocket, flop, pocket))
+		return NULL;
+	return outs_query(NULL, flop, pocket, iterations, n_threads, py_seed, 1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//							NUTS
+////////////////////////////////////////////////////////////////////////////////
+
+// The best pocket on a board: the board is walked once, then the pockets are 
+// enumerated in the order of their cards with the walk of every prefix of the
+// pocket shared by all the pockets that start with it; the first pocket with
+// the best score wins, just like in find_first_nuts_holdem().
+
+typedef struct {
+	int n_board, board[5], is_omaha;
+	int next_card; // -1 for the board itself, otherwise the card added to it
+	int score, pocket[4];
+} nuts_job;
+
+// omaha walk from the states after the board; level is the pocket card to walk
+static void nuts_omaha_pocket(nuts_job *job, uint64_t dead, const outs_board *w, int level, 
+	int start, int *pocket)
+{
+	for (int c = start; c < 52; c++)
+	{
+		if (dead & (1LLU << c))
+			continue;
+		pocket[level] = c;
+		if (level < 3)
+		{
+			outs_board next = *w;
+			outs_walk_board(&c, 1, &next.fs, &next.snf, next.flush);
+			nuts_omaha_pocket(job, dead, &next, level + 1, c + 1, pocket);
+			continue;
+		}
+		int fs, score;
+		if (HR9_compact)
+		{
+			fs = HR9C.leaves[HR9C_FLUSH_SUITS][w->fs + hr9c_suit_class[c + 1]];
+			score = HR9C.leaves[HR9C_NO_FLUSH][w->snf + hr9c_rank_class[c + 1]];
+			if (fs != 0)
+				score = MAX(score, (int) HR9C.leaves[HR9C_FLUSH_RANKS][w->flush[fs] + 
+					hr9c_flush_class[fs][c + 1]]);
+		}
+		else
+		{
+			fs = HR9[w->fs + c + 1];
+			score = HR9[w->snf + c + 1];
+			if (fs != 0)
+				score = MAX(score, HR9[(4 - fs) + w->flush[fs] + c + 1]);
+		}
+		if (score > job->score)
+		{
+			job->score = score;
+			memcpy(job->pocket, pocket, 4 * sizeof(int));
+		}
+	}
+}
+
+static void nuts_job_run(void *arg)
+{
+	nuts_job *job = (nuts_job *) arg;
+	int i, c1, c2, n_board = job->n_board, board[5];
+	uint64_t dead = 0;
+	memcpy(board, job->board, n_board * sizeof(int));
+	if (job->next_card >= 0)
+		board[n_board++] = job->next_card;
+	for (i = 0; i < n_board; i++)
+		dead |= 1LLU << board[i];
+	job->score = -1;
+	if (!job->is_omaha)
+	{
+		int path = 53;
+		for (i = 0; i < n_board; i++)
+			path = HR[path + board[i] + 1];
+		for (c1 = 0; c1 < 52; c1++)
+		{
+			if (dead & (1LLU << c1))
+				continue;
+			int path1 = HR[path + c1 + 1];
+			for (c2 = c1 + 1; c2 < 52; c2++)
+			{
+				if (dead & (1LLU << c2))
+					continue;
+				int score = HR[path1 + c2 + 1];
+				if (n_board < 5)
+					score = HR[score]; // 5- and 6-card ranks are kept in the zero slot
+				if (score > job->score)
+				{
+					job->score = score;
+					job->pocket[0] = c1;
+					job->pocket[1] = c2;
+				}
+			}
+		}
+		return;
+	}
+	outs_board w;
+	if (HR9_compact)
+	{
+		w.fs = HR9C.root[HR9C_FLUSH_SUITS];
+		w.snf = HR9C.root[HR9C_NO_FLUSH];
+		int flush = HR9C.root[HR9C_FLUSH_RANKS];
+		for (i = n_board; i < 5; i++) // the skipped board cards
+		{
+			w.fs = HR9C.nodes[HR9C_FLUSH_SUITS][w.fs];
+			w.snf = HR9C.nodes[HR9C_NO_FLUSH][w.snf];
+			flush = HR9C.nodes[HR9C_FLUSH_RANKS][flush];
+		}
+		for (i = 1; i <= 4; i++)
+			w.flush[i] = flush;
+	}
+	else
+	{
+		w.fs = 106;
+		w.snf = HR9[0] + 53;
+		int flush = HR9[1] + 56;
+		for (i = n_board; i < 5; i++)
+		{
+			w.fs = HR9[w.fs];
+			w.snf = HR9[w.snf];
+			flush = HR9[flush];
+		}
+		for (i = 1; i <= 4; i++)
+			w.flush[i] = flush;
+	}
+	outs_walk_board(board, n_board, &w.fs, &w.snf, w.flush);
+	int pocket[4];
+	nuts_omaha_pocket(job, dead, &w, 0, 0, pocket);
+}
+
+// board: 3-5 distinct cards, 0-51; nuts[0] is the board itself, if next isn't 0
+// and the board has less than 5 cards, nuts[1 + c] is it with card c added 
+// (score -1 for the cards on the board). May be called with the GIL released.
+int find_nuts(const int *board, int n_board, int is_omaha, int next, int n_threads, nuts_job *nuts)
+{
+	int i, n_jobs = 1;
+	if (n_board < 3 || n_board > 5)
+		return 1;
+	next = next && (n_board < 5);
+	for (i = 0; i < (next ? 53 : 1); i++)
+	{
+		nuts[i].n_board = n_board;
+		memcpy(nuts[i].board, board, n_board * sizeof(int));
+		nuts[i].is_omaha = is_omaha;
+		nuts[i].next_card = i - 1;
+		nuts[i].score = -1;
+	}
+	nuts_job *jobs = (nuts_job *) malloc(53 * sizeof(nuts_job));
+	jobs[0] = nuts[0];
+	for (i = 1; next && i < 53; i++)
+	{
+		int c = i - 1, on_board = 0;
+		for (int j = 0; j < n_board; j++)
+			on_board = on_board || (board[j] == c);
+		if (!on_board)
+			jobs[n_jobs++] = nuts[i];
+	}
+	pool_run(n_threads, n_jobs, nuts_job_run, jobs, sizeof(nuts_job));
+	for (i = 0; i < n_jobs; i++)
+		nuts[jobs[i].next_card + 1] = jobs[i];
+	free(jobs);
+	return 0;
+}
+
+static PyObject *nuts_pocket_list(const nuts_job *nuts)
+{
+	int size = nuts->is_omaha ? 4 : 2;
+	PyObject *py_pocket = PyList_New(size);
+	for (int i = 0; i < size; i++)
+		PyList_SET_ITEM(py_pocket, (Py_ssize_t) i, PyInt_FromLong((long) nuts->pocket[i]));
+	return py_pocket;
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int) - 3-5 cards, 0-51
+	next: int (optional, 0 by default) - the nuts for every next card too
+	n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+OUTPUT:
+	(pocket, score, next_nuts): (list (int), int, list)
+		pocket - the first pocket that makes the best hand on the board and its score
+		next_nuts - if next was set and the board has less than 5 cards, a list of 52
+			(pocket, score) tuples for the board with every card added, None for 
+			the cards on the board; otherwise None
+*/
+static PyObject *_rayeval_find_nuts(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_FIND_NUTS);
+	char *game;
+	PyObject *py_board, *py_pocket, *py_next;
+	int i, n_board, n_pocket, n_players, is_omaha, next = 0, n_threads = 1;
+	int board[5], pocket[4 * MAX_PLAYERS];
+	nuts_job nuts[53];
+	uint64_t seen = 0;
+
+	if (!PyArg_ParseTuple(args, "sO|ii", &game, &py_board, &next, &n_threads))
+		return NULL;
+	py_pocket = PyList_New(0);
+	for (i = 0; i < (strcmp(game, "omaha") ? 2 : 4); i++)
+	{
+		PyObject *item = PyInt_FromLong(255);
+		PyList_Append(py_pocket, item);
+		Py_DECREF(item);
+	}
+	int *ok = parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha);
+	Py_DECREF(py_pocket);
+	if (!ok)
+		return NULL;
+	for (i = 0; i < n_board; i++)
+	{
+		if (board[i] == 255)
+			RAISE_EXCEPTION(PyExc_ValueError, "Masked board is not allowed.");
+		if (seen & (1LLU << board[i]))
+			RAISE_EXCEPTION(PyExc_ValueError, "Cards must be distinct.");
+		seen |= 1LLU << board[i];
+	}
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	find_nuts(board, n_board, is_omaha, next, n_threads, nuts);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+
+	if (next && n_board < 5)
+	{
+		py_next = PyList_New(52);
+		for (i = 0; i < 52; i++)
+		{
+			PyObject *item = Py_None;
+			if (nuts[i + 1].score >= 0)
+				item = Py_BuildValue("(Ni)", nuts_pocket_list(nuts + i + 1), nuts[i + 1].score);
+			else
+				Py_INCREF(item);
+			PyList_SET_ITEM(py_next, (Py_ssize_t) i, item);
+		}
+	}
+	else
+	{
+		py_next = Py_None;
+		Py_INCREF(py_next);
+	}
+	return Py_BuildValue("(NiN)", nuts_pocket_list(nuts), nuts[0].score, py_next);
+}
+
+
+// INPUT:
+// 		board: list(int)
+// OUTPUT:
+//		result: list (int) size 2 - 2 cards of the nuts
+static PyObject *_find_first_nuts_holdem(PyObject *self, PyObject *args)
+{
+	int board[5], result_pocket[2];
+
+	PyObject *py_board;
+	if (!PyArg_ParseTuple(args, "O", &py_board))
+		return NULL;
+
+	if (!PyList_Check(py_board)) 
+    	RAISE_EXCEPTION(PyExc_TypeError, "Board must be a list.");
+
+ 	int n_board = (int) PyList_Size(py_board);
+
+    if (n_board != 3 && n_board != 4 && n_board != 5)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Board must contain 3-5 cards.");
+
+    for (int i = 0; i < n_board; i++)
+    {
+    	PyObject *item = PyList_GetItem(py_board, i);
+    	if (!PyInt_Check(item))
+	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be integers.");
+    	board[i] = (int) PyInt_AsLong(item);
+    	if (board[i] < 0 || board[i] > 51)
+	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be 0-51.");
+    }
+
+	if (HR)
+	{
+		nuts_job nuts;
+		find_nuts(board, n_board, 0, 0, 1, &nuts);
+		result_pocket[0] = nuts.pocket[0];
+		result_pocket[1] = nuts.pocket[1];
+	}
+	else
+		find_first_nuts_holdem(board, n_board, result_pocket);
+
+	PyObject *py_result = PyList_New(2);
+
+	PyList_SET_ITEM(py_result, (Py_ssize_t) 0, PyInt_FromLong((long)result_pocket[0]));
+	PyList_SET_ITEM(py_result, (Py_ssize_t) 1, PyInt_FromLong((long)result_pocket[1]));
+
+    return py_result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//							HAND CLASSIFICATION
+////////////////////////////////////////////////////////////////////////////////
+
+// Native versions of hand_draw_outs_i(), draw_type_i() and made_hand_type_i()
+// of rayeval.py with the same rules: the board texture is read off rank and 
+// suit bit masks, the hands are scored in the HR/HR9 tables.
+
+// the best kinds of hands a board allows, see first_nuts_type() in rayeval.py
+#define TEXTURE_SET			0
+#define TEXTURE_STRAIGHT	1
+#define TEXTURE_FLUSH		2
+#define TEXTURE_FULL_HOUSE	3
+
+// hand_rank >> 12
+#define CATEGORY_HIGH_CARD	1
+#define CATEGORY_ONE_PAIR	2
+#define CATEGORY_STRAIGHT	5
+#define CATEGORY_FLUSH		6
+
+static const char *draw_types[] = {"ND", "WD", "GD", "SD"};
+static const char *made_hand_types[] = {"WMH", "OP", "TPGK", "2P+"};
+
+// the ranks (0-12) of n cards, highest first
+static void sorted_ranks(const int *cards, int n, int *ranks)
+{
+	int i, j;
+	for (i = 0; i < n; i++)
+	{
+		int r = cards[i] >> 2;
+		for (j = i; j > 0 && ranks[j - 1] < r; j--)
+			ranks[j] = ranks[j - 1];
+		ranks[j] = r;
+	}
+}
+
+static int board_texture(const int *board, int n)
+{
+	int i, ranks[6], suits[4] = {0, 0, 0, 0};
+	unsigned rank_mask = 0;
+	for (i = 0; i < n; i++)
+	{
+		unsigned bit = 1u << (board[i] >> 2);
+		if (rank_mask & bit)
+			return TEXTURE_FULL_HOUSE;
+		rank_mask |= bit;
+		suits[board[i] & 3]++;
+	}
+	if (suits[0] > 2 || suits[1] > 2 || suits[2] > 2 || suits[3] > 2)
+		return TEXTURE_FLUSH;
+	if (n <= 5)
+	{
+		sorted_ranks(board, n, ranks);
+		for (i = 0; i + 2 < n; i++)
+			if (ranks[i] - ranks[i + 2] < 5)
+				return TEXTURE_STRAIGHT;
+	}
+	return TEXTURE_SET;
+}
+
+// see is_first_nuts() in rayeval.py, the board already has the draw's texture
+static int is_first_nuts(const int *board, int n_board, const int *pocket, int n_pocket, int draw)
+{
+	int i, ranks[6] = {0};
+	unsigned rank_mask = 0, suit_masks[4] = {0, 0, 0, 0};
+	for (i = 0; i < n_board + n_pocket; i++)
+	{
+		int card = (i < n_board) ? board[i] : pocket[i - n_board];
+		rank_mask |= 1u << (card >> 2);
+		suit_masks[card & 3] |= 1u << (card >> 2);
+	}
+	if (draw == TEXTURE_FLUSH)
+	{
+		// the top three cards of a suit with more than two of them are A, K and Q
+		const unsigned akq = (1u << 12) | (1u << 11) | (1u << 10);
+		for (i = 0; i < 4; i++)
+			if ((suit_masks[i] & akq) == akq)
+				return 1;
+		return 0;
+	}
+	sorted_ranks(board, n_board, ranks);
+	int si = -1;
+	if (ranks[0] - ranks[2] < 5)
+		si = 0;
+	else if (n_board == 4 && ranks[1] - ranks[3] < 5)
+		si = 1;
+	else if (n_board == 5 && ranks[2] - ranks[4] < 5)
+		si = 2;
+	if (si < 0)
+		return 0;
+	int nut_card = ranks[si + 2] + 4;
+	for (i = 0; i < 5; i++)
+		if (nut_card - i > 12 || !(rank_mask & (1u << (nut_card - i))))
+			return 0;
+	return 1;
+}
+
+static int hand_category(const int *board, int n_board, const int *pocket, int is_omaha)
+{
+	int value = is_omaha ? eval_hand_omaha((int *) board, n_board, (int *) pocket) : 
+		eval_hand_holdem((int *) board, n_board, (int *) pocket, 2);
+	return value >> 12;
+}
+
+// outs of the next card that change the texture of a 3- or 4-card board to the 
+// draw's and make the hand that kind, and how many of them make the nuts
+static void draw_outs(const int *board, int n_board, const int *pocket, int is_omaha, int draw,
+	int *outs, int *nut_outs)
+{
+	int i, cards[6], n_pocket = is_omaha ? 4 : 2;
+	int category = (draw == TEXTURE_FLUSH) ? CATEGORY_FLUSH : CATEGORY_STRAIGHT;
+	uint64_t dead = 0;
+	*outs = *nut_outs = 0;
+	if (n_board > 4)
+		return;
+	memcpy(cards, board, n_board * sizeof(int));
+	for (i = 0; i < n_board; i++)
+		dead |= 1LLU << board[i];
+	for (i = 0; i < n_pocket; i++)
+		dead |= 1LLU << pocket[i];
+	int texture = board_texture(board, n_board);
+	for (int c = 0; c < 52; c++)
+	{
+		if (dead & (1LLU << c))
+			continue;
+		cards[n_board] = c;
+		int next = board_texture(cards, n_board + 1);
+		if (next == texture || next != draw)
+			continue;
+		if (hand_category(cards, n_board + 1, pocket, is_omaha) != category)
+			continue;
+		(*outs)++;
+		*nut_outs += is_first_nuts(cards, n_board + 1, pocket, n_pocket, draw);
+	}
+}
+
+// see made_hand_type_i() in rayeval.py
+static int made_hand_type(const int *board, int n_board, const int *pocket, int is_omaha)
+{
+	int i, n_pocket = is_omaha ? 4 : 2, board_ranks[5], pocket_ranks[4];
+	int category = hand_category(board, n_board, pocket, is_omaha);
+	if (category > CATEGORY_ONE_PAIR)
+		return 3;
+	if (category < CATEGORY_ONE_PAIR)
+		return 0;
+	sorted_ranks(board, n_board, board_ranks);
+	sorted_ranks(pocket, n_pocket, pocket_ranks);
+	int pocket_pair = -1, top_paired = 0;
+	for (i = 1; i < n_pocket && pocket_pair < 0; i++)
+		if (pocket_ranks[i] == pocket_ranks[i - 1])
+			pocket_pair = pocket_ranks[i];
+	if (pocket_pair > board_ranks[0])
+		return 1;
+	for (i = 0; i < n_pocket; i++)
+		top_paired = top_paired || (pocket_ranks[i] == board_ranks[0]);
+	if (top_paired && (pocket_ranks[0] == 12 || pocket_ranks[0] == 11 || pocket_ranks[1] == 11))
+		return 2;
+	return 0;
+}
+
+typedef struct {
+	int straight_outs, straight_nut_outs, flush_outs, flush_nut_outs;
+	int draw_type, made_hand_type; // indices in draw_types and made_hand_types
+} hand_class;
+
+void classify_hand(const int *board, int n_board, const int *pocket, int is_omaha, hand_class *h)
+{
+	draw_outs(board, n_board, pocket, is_omaha, TEXTURE_STRAIGHT, &h->straight_outs, &h->straight_nut_outs);
+	draw_outs(board, n_board, pocket, is_omaha, TEXTURE_FLUSH, &h->flush_outs, &h->flush_nut_outs);
+	int outs = h->straight_outs + h->flush_outs, nut_outs = h->straight_nut_outs + h->flush_nut_outs;
+	if (outs == 0)
+		h->draw_type = 0;
+	else if (outs < 8 || (outs < 11 && nut_outs < 4))
+		h->draw_type = 1;
+	else if (outs < 11)
+		h->draw_type = 2;
+	else
+		h->draw_type = 3;
+	h->made_hand_type = made_hand_type(board, n_board, pocket, is_omaha);
+}
+
+/*
+INPUT:
+	game: "omaha" | "holdem"
+	board: list (int) - 3-5 known cards
+	pocket: list (int) - one known pocket
+OUTPUT:
+	(straight_outs, straight_nut_outs, flush_outs, flush_nut_outs, draw_type, made_hand_type):
+		(int, int, int, int, str, str) - no outs on a 5-card board
+*/
+static PyObject *_rayeval_classify_hand(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_CLASSIFY_HAND);
+	char *game;
+	PyObject *py_board, *py_pocket;
+	int i, n_board, n_pocket, n_players, is_omaha, board[5], pocket[4 * MAX_PLAYERS];
+	uint64_t seen = 0;
+	hand_class h;
+
+	if (!PyArg_ParseTuple(args, "sOO", &game, &py_board, &py_pocket))
+		return NULL;
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return NULL;
+	if (n_players > 1)
+		RAISE_EXCEPTION(PyExc_ValueError, "One player expected, found more.");
+	for (i = 0; i < n_board + n_pocket; i++)
+	{
+		int card = (i < n_board) ? board[i] : pocket[i - n_board];
+		if (card == 255)
+			RAISE_EXCEPTION(PyExc_ValueError, "Masked cards are not allowed.");
+		if (seen & (1LLU << card))
+			RAISE_EXCEPTION(PyExc_ValueError, "Cards must be distinct.");
+		seen |= 1LLU << card;
+	}
+	if (!is_omaha && !HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (is_omaha && !HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+
+	classify_hand(board, n_board, pocket, is_omaha, &h);
+	return Py_BuildValue("(iiiiss)", h.straight_outs, h.straight_nut_outs, h.flush_outs, 
+		h.flush_nut_outs, draw_types[h.draw_type], made_hand_types[h.made_hand_type]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+//							PREFLOP TABLES
 ////////////////////////////////////////////////////////////////////////////////
 
-#define RAISE_EXCEPTION(exception, message) {PyErr_SetString((exception), (message)); return NULL;}
+/*
+	Heads-up preflop equities, in the hand ranks file format (kind 
+	TABLE_KIND_PREFLOP) so that they load and map the same way. Every pocket 
+	has its own entry, at the colex rank of its cards (see combo_index()), 
+	the equity times PREFLOP_SCALE, -1 where the pockets share cards:
 
-static PyObject *_rayeval_seed(PyObject *self, PyObject *args)
+		sections[0]: hold'em pocket vs a random pocket, 1326 entries
+		sections[1]: hold'em pocket a vs pocket b at a * 1326 + b
+		sections[2]: omaha pocket vs a random pocket, 270725 entries
+
+	Only one pocket (or pair of pockets) per class under suit relabelling is
+	evaluated, 169 and 16432 of them vs random, and of the pairs only one of
+	(a, b) and (b, a), the other being its complement.
+*/
+
+// colex rank of k (up to 4) distinct cards among C(52, k)
+static int combo_index(const int *cards, int k)
 {
-	unsigned int seed;
-  	if (!PyArg_ParseTuple(args, "i", &seed))
-    	return NULL;
-    srand(seed);
-	Py_RETURN_NONE;
+	int i, j, c[4], index = 0;
+	for (i = 0; i < k; i++)
+	{
+		for (j = i; j > 0 && c[j - 1] > cards[i]; j--)
+			c[j] = c[j - 1];
+		c[j] = cards[i];
+	}
+	for (i = 0; i < k; i++)
+	{
+		int n = 1;
+		for (j = 0; j <= i; j++)
+			n = n * (c[i] - j) / (j + 1);
+		index += n;
+	}
+	return index;
+}
+
+static void preflop_spot(mc_spot *spot, const int *pocket, const int *opponent, int is_omaha, int N)
+{
+	int i, size = is_omaha ? 4 : 2;
+	for (i = 0; i < 5; i++)
+		spot->board[i] = 255;
+	spot->n_board = 5;
+	for (i = 0; i < size; i++)
+	{
+		spot->pocket[i] = pocket[i];
+		spot->pocket[size + i] = opponent ? opponent[i] : 255;
+	}
+	spot->n_players = 2;
+	spot->is_omaha = is_omaha;
+	spot->N = N;
 }
 
+static int preflop_scaled(double ev)
+{
+	return (int) (ev * PREFLOP_SCALE + 0.5);
+}
 
-static PyObject *_rayeval_load_handranks_7(PyObject *self, PyObject *args)
+static int push_preflop_spot(mc_spot **spots, int *n_spots, int *capacity, const int *pocket, 
+	const int *opponent, int is_omaha, int N)
+{
+	if (*n_spots == *capacity)
+	{
+		*capacity = 2 * (*capacity);
+		*spots = (mc_spot *) realloc(*spots, *capacity * sizeof(mc_spot));
+	}
+	preflop_spot(*spots + *n_spots, pocket, opponent, is_omaha, N);
+	return (*n_spots)++;
+}
+
+// the spot of the class of the pocket, at the index of its canonical form
+static int preflop_class_spot(const int *spot_of, const int *cards, int size)
+{
+	int canonical[4];
+	suit_canonicalize(cards, &size, 1, canonical, NULL);
+	return spot_of[combo_index(canonical, size)];
+}
+
+// Evaluates the tables with N deals per class (the hold'em ones enumerated
+// if exact_holdem is set) on the thread pool, table holds PREFLOP_TABLE_SIZE 
+// ints; returns the number of classes evaluated. May be called with the GIL
+// released.
+int build_preflop_tables(int *table, int N, int exact_holdem, int n_threads, uint64_t seed)
+{
+	const int n_pairs = PREFLOP_HOLDEM_COMBOS * PREFLOP_HOLDEM_COMBOS;
+	int a, b, i, e, n_spots = 0, capacity = 1024, sizes[2] = {2, 2}, c[4], cards[4], canonical[4];
+	// the spot of every entry, in the layout of the table: -1 where the pockets
+	// share cards, -2 - spot where the entry is the complement of spot's
+	int *spot_of = (int *) malloc(PREFLOP_TABLE_SIZE * sizeof(int));
+	int *vs_random = spot_of, *vs_pocket = spot_of + PREFLOP_HOLDEM_COMBOS, 
+		*omaha = vs_pocket + n_pairs;
+	int *combos = (int *) malloc(2 * PREFLOP_HOLDEM_COMBOS * sizeof(int));
+	mc_spot *spots = (mc_spot *) malloc(capacity * sizeof(mc_spot));
+
+	for (a = 1, i = 0; a < 52; a++)
+		for (b = 0; b < a; b++, i++)
+		{
+			combos[2 * i] = b;
+			combos[2 * i + 1] = a;
+		}
+
+	// the class representatives first, then every other entry points to its class
+	for (a = 0; a < PREFLOP_HOLDEM_COMBOS; a++)
+	{
+		suit_canonicalize(combos + 2 * a, sizes, 1, canonical, NULL);
+		vs_random[a] = memcmp(canonical, combos + 2 * a, 2 * sizeof(int)) ? -1 :
+			push_preflop_spot(&spots, &n_spots, &capacity, combos + 2 * a, NULL, 0, N);
+	}
+	for (a = 0; a < PREFLOP_HOLDEM_COMBOS; a++)
+		vs_random[a] = preflop_class_spot(vs_random, combos + 2 * a, 2);
+
+	for (e = 0; e < n_pairs; e++)
+	{
+		int *pa = combos + 2 * (e / PREFLOP_HOLDEM_COMBOS), *pb = combos + 2 * (e % PREFLOP_HOLDEM_COMBOS);
+		vs_pocket[e] = -1;
+		if (pa[0] == pb[0] || pa[0] == pb[1] || pa[1] == pb[0] || pa[1] == pb[1])
+			continue;
+		memcpy(cards, pa, 2 * sizeof(int));
+		memcpy(cards + 2, pb, 2 * sizeof(int));
+		suit_canonicalize(cards, sizes, 2, canonical, NULL);
+		if (memcmp(canonical, cards, sizeof(cards)))
+			continue;
+		memcpy(c, pb, 2 * sizeof(int));
+		memcpy(c + 2, pa, 2 * sizeof(int));
+		suit_canonicalize(c, sizes, 2, canonical, NULL);
+		for (i = 0; i < 4 && canonical[i] == cards[i]; i++)
+			;
+		if (i == 4 || canonical[i] > cards[i]) // the smaller of (a, b) and (b, a) is evaluated
+			vs_pocket[e] = push_preflop_spot(&spots, &n_spots, &capacity, pa, pb, 0, N);
+	}
+	for (e = 0; e < n_pairs; e++)
+	{
+		int *pa = combos + 2 * (e / PREFLOP_HOLDEM_COMBOS), *pb = combos + 2 * (e % PREFLOP_HOLDEM_COMBOS);
+		if (pa[0] == pb[0] || pa[0] == pb[1] || pa[1] == pb[0] || pa[1] == pb[1])
+			continue;
+		for (i = 0; i < 2; i++)
+		{
+			memcpy(cards + 2 * i, pa, 2 * sizeof(int));
+			memcpy(cards + 2 - 2 * i, pb, 2 * sizeof(int));
+			suit_canonicalize(cards, sizes, 2, canonical, NULL);
+			int spot = vs_pocket[combo_index(canonical, 2) * PREFLOP_HOLDEM_COMBOS + combo_index(canonical + 2, 2)];
+			if (spot >= 0)
+			{
+				vs_pocket[e] = i ? -2 - spot : spot;
+				break;
+			}
+		}
+	}
+	int n_holdem_spots = n_spots;
+
+	for (c[3] = 3, e = 0; c[3] < 52; c[3]++)
+		for (c[2] = 2; c[2] < c[3]; c[2]++)
+			for (c[1] = 1; c[1] < c[2]; c[1]++)
+				for (c[0] = 0; c[0] < c[1]; c[0]++, e++)
+				{
+					int size = 4;
+					suit_canonicalize(c, &size, 1, canonical, NULL);
+					omaha[e] = memcmp(canonical, c, sizeof(c)) ? -1 :
+						push_preflop_spot(&spots, &n_spots, &capacity, c, NULL, 1, N);
+				}
+	for (c[3] = 3, e = 0; c[3] < 52; c[3]++)
+		for (c[2] = 2; c[2] < c[3]; c[2]++)
+			for (c[1] = 1; c[1] < c[2]; c[1]++)
+				for (c[0] = 0; c[0] < c[1]; c[0]++, e++)
+					omaha[e] = preflop_class_spot(omaha, c, 4);
+
+	double *ev = (double *) malloc(n_spots * MAX_PLAYERS * sizeof(double));
+	eval_monte_carlo_batch(n_holdem_spots, spots, n_threads, seed, 1, exact_holdem ? 1e300 : 0.0,
+		MC_INTERLEAVE, 0, ev);
+	// a seed of their own, so that omaha spot i doesn't sample the streams of hold'em spot i
+	eval_monte_carlo_batch(n_spots - n_holdem_spots, spots + n_holdem_spots, n_threads, 
+		seed ^ 0x9e3779b97f4a7c15ULL, 1, 0.0, MC_INTERLEAVE, 0, ev + n_holdem_spots * MAX_PLAYERS);
+	for (e = 0; e < PREFLOP_TABLE_SIZE; e++)
+	{
+		int spot = spot_of[e];
+		table[e] = (spot == -1) ? -1 : preflop_scaled(spot >= 0 ? 
+			ev[spot * MAX_PLAYERS] : ev[(-2 - spot) * MAX_PLAYERS + 1]);
+	}
+	free(ev);
+	free(spots);
+	free(combos);
+	free(spot_of);
+	return n_spots;
+}
+
+/*
+INPUT:
+	filename: string
+	N: int - deals per class
+	exact_holdem: int (optional, 0 by default) - 1 to enumerate the hold'em classes
+	n_threads: int (optional, 0 or negative to use all cores by default)
+	seed: long (optional, -1 by default) - -1 to draw it from the global generator
+OUTPUT:
+	n: int - number of classes evaluated
+*/
+static PyObject *_rayeval_generate_preflop_tables(PyObject *self, PyObject *args)
 {
 	char *filename;
-  	if (!PyArg_ParseTuple(args, "s", &filename))
-    	return NULL;
-    if (!HR)
-	    if (!(HR = smart_load(filename)))
-	    	RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks from file.");
-	Py_RETURN_NONE;
+	int N, exact_holdem = 0, n_threads = 0, n, result;
+	long long py_seed = -1;
+	if (!PyArg_ParseTuple(args, "si|iiL", &filename, &N, &exact_holdem, &n_threads, &py_seed))
+		return NULL;
+	if (N <= 0)
+		RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+	if (!HR)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	if (!HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+	uint64_t sections[3] = {0, PREFLOP_HOLDEM_COMBOS, 
+		PREFLOP_HOLDEM_COMBOS * (1 + PREFLOP_HOLDEM_COMBOS)};
+	int *table = (int *) malloc(PREFLOP_TABLE_SIZE * sizeof(int));
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	n = build_preflop_tables(table, N, exact_holdem, n_threads, seed);
+	result = smart_save(table, PREFLOP_TABLE_SIZE, filename, TABLE_KIND_PREFLOP, sections);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+	free(table);
+	if (result)
+		RAISE_EXCEPTION(PyExc_IOError, "Failed to write the preflop tables.");
+	return PyInt_FromLong(n);
 }
 
-static PyObject *_rayeval_load_handranks_9(PyObject *self, PyObject *args)
+static PyObject *_rayeval_load_preflop_tables(PyObject *self, PyObject *args)
 {
 	char *filename;
-  	if (!PyArg_ParseTuple(args, "s", &filename))
+	int use_mmap = 0, populate = 1;
+	table_info info;
+  	if (!PyArg_ParseTuple(args, "s|ii", &filename, &use_mmap, &populate))
     	return NULL;
-    if (!HR9)
-	    if (!(HR9 = smart_load(filename)))
-	    	RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [9] from file.");
+	if (PREFLOP)
+		Py_RETURN_NONE;
+	if (read_table_info(filename, &info) || info.kind != TABLE_KIND_PREFLOP || 
+		info.length != PREFLOP_TABLE_SIZE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Not a valid preflop tables file.");
+	if (!(PREFLOP = use_mmap ? smart_mmap(filename, populate != 0, 0, &PREFLOP_backing) : 
+			smart_load(filename, 0, &PREFLOP_backing)))
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load preflop tables from file.");
 	Py_RETURN_NONE;
 }
 
-static PyObject *_rayeval_load_handranks_7_to_shm(PyObject *self, PyObject *args)
+/*
+INPUT:
+	game: string - holdem/omaha
+	pocket: list (int) - 2 or 4 cards, 0-51
+	opponent: list (int) - another hold'em pocket, or empty for a random one
+OUTPUT:
+	ev: double - heads-up equity of the pocket
+*/
+static PyObject *_rayeval_preflop_equity(PyObject *self, PyObject *args)
 {
-    char *filename;
-    char *path;
-    int user_id;
-    if (!PyArg_ParseTuple(args, "ssi", &filename, &path, &user_id))
-        return NULL;
-    if (!HR)
-        if (!(HR = smart_load_to_shm(filename, ftok(path, user_id))))
-            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks from file.");
-    HR = HR + 1;
-    Py_RETURN_NONE;
+	stats_scope scope(STATS_PREFLOP_EQUITY);
+	char *game;
+	PyObject *py_pocket, *py_opponent;
+	int i, cards[4], is_omaha, size, n_opponent;
+	uint64_t seen = 0;
+	if (!PyArg_ParseTuple(args, "sOO", &game, &py_pocket, &py_opponent))
+		return NULL;
+	if (!PREFLOP)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load preflop tables first.");
+	if (!strcmp(game, "omaha"))
+		is_omaha = 1;
+	else if (!strcmp(game, "holdem"))
+		is_omaha = 0;
+	else
+		RAISE_EXCEPTION(PyExc_ValueError, "Game type must be holdem or omaha.");
+	size = is_omaha ? 4 : 2;
+	if (!PyList_Check(py_pocket) || PyList_Size(py_pocket) != size || !PyList_Check(py_opponent))
+		RAISE_EXCEPTION(PyExc_ValueError, "Invalid pocket size for selected game type.");
+	n_opponent = (int) PyList_Size(py_opponent);
+	if (n_opponent != 0 && (is_omaha || n_opponent != 2))
+		RAISE_EXCEPTION(PyExc_ValueError, "Opponent must be a hold'em pocket or random.");
+	for (i = 0; i < size + n_opponent; i++)
+	{
+		PyObject *item = (i < size) ? PyList_GetItem(py_pocket, i) : PyList_GetItem(py_opponent, i - size);
+		int card = PyInt_Check(item) ? (int) PyInt_AsLong(item) : -1;
+		if (card < 0 || card > 51)
+			RAISE_EXCEPTION(PyExc_ValueError, "Pocket cards must be 0-51.");
+		if (seen & (1LLU << card))
+			RAISE_EXCEPTION(PyExc_ValueError, "Cards must be distinct.");
+		seen |= 1LLU << card;
+		cards[i] = card;
+	}
+	int entry;
+	if (is_omaha)
+		entry = PREFLOP[PREFLOP_HOLDEM_COMBOS * (1 + PREFLOP_HOLDEM_COMBOS) + combo_index(cards, 4)];
+	else if (n_opponent)
+		entry = PREFLOP[PREFLOP_HOLDEM_COMBOS * (1 + combo_index(cards, 2)) + combo_index(cards + 2, 2)];
+	else
+		entry = PREFLOP[combo_index(cards, 2)];
+	return PyFloat_FromDouble((double) entry / PREFLOP_SCALE);
 }
 
-static PyObject *_rayeval_load_handranks_9_to_shm(PyObject *self, PyObject *args)
+////////////////////////////////////////////////////////////////////////////////
+//							EQUITY CACHE
+////////////////////////////////////////////////////////////////////////////////
+
+// The on-disk store behind rayeval.EquityCache, see cache_store_open(); the 
+// spots are expected in canonical form already, the in-process LRU in front 
+// of it uses the same keys.
+
+#define CACHE_STORE_CAPSULE "rayeval.cache_store"
+
+static void cache_store_capsule_free(PyObject *py_store)
 {
-    char *filename;
-    char *path;
-    int user_id;
-  	if (!PyArg_ParseTuple(args, "ssi", &filename, &path, &user_id))
-    	return NULL;
-    if (!HR9)
-	    if (!(HR9 = smart_load_to_shm(filename, ftok(path, user_id))))
-	    	RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [9] from file.");
-    HR9 = HR9 + 1;
-    Py_RETURN_NONE;
+	cache_store *c = (cache_store *) PyCapsule_GetPointer(py_store, CACHE_STORE_CAPSULE);
+	if (!c)
+		return;
+	cache_store_close(c);
+	free(c);
 }
 
-static PyObject *_rayeval_generate_handranks_7(PyObject *self, PyObject *args)
+// parses a (store, game, board, pockets, accuracy) prefix of the arguments into
+// the store and the key, returns the number of players or 0 on error
+static int parse_cache_query(PyObject *py_store, char *game, PyObject *py_board, PyObject *py_pocket,
+	cache_store **c, uint8_t *key)
+{
+	int i, n_board, n_pocket, n_players, is_omaha, board[5], pocket[4 * MAX_PLAYERS];
+	*c = (cache_store *) PyCapsule_GetPointer(py_store, CACHE_STORE_CAPSULE);
+	if (!*c)
+		return 0;
+	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
+		&n_board, &n_pocket, &n_players, &is_omaha))
+		return 0;
+	memset(key, 0, CACHE_KEY_SIZE);
+	key[0] = (uint8_t) is_omaha;
+	key[1] = (uint8_t) n_board;
+	key[2] = (uint8_t) n_players;
+	for (i = 0; i < n_board; i++)
+		key[3 + i] = (uint8_t) board[i];
+	for (i = 0; i < n_pocket; i++)
+		key[3 + n_board + i] = (uint8_t) pocket[i];
+	return n_players;
+}
+
+/*
+INPUT:
+	filename: string - created if it doesn't exist
+	n_slots: long - number of entries of a new file, rounded up to a power of two
+OUTPUT:
+	store: capsule - unmapped once garbage collected
+*/
+static PyObject *_rayeval_cache_open(PyObject *self, PyObject *args)
 {
 	char *filename;
-	int test;
-  	if (!PyArg_ParseTuple(args, "si", &filename, &test))
-    	return NULL;
-	if (raygen7(filename, (test != 0)))
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to generate hand ranks [7] file.");
-	Py_RETURN_NONE;
+	long long n_slots;
+	if (!PyArg_ParseTuple(args, "sL", &filename, &n_slots))
+		return NULL;
+	if (n_slots <= 0 || n_slots > (1LL << 40))
+		RAISE_EXCEPTION(PyExc_ValueError, "Number of slots must be a positive integer.");
+	cache_store *c = (cache_store *) malloc(sizeof(cache_store));
+	if (cache_store_open(c, filename, (uint64_t) n_slots))
+	{
+		free(c);
+		RAISE_EXCEPTION(PyExc_IOError, "Couldn't open the cache file.");
+	}
+	return PyCapsule_New(c, CACHE_STORE_CAPSULE, cache_store_capsule_free);
 }
 
-static PyObject *_rayeval_generate_handranks_9(PyObject *self, PyObject *args)
+/*
+INPUT:
+	store: capsule - see cache_open
+	game, board, pockets: see eval_mc, in canonical form
+	accuracy: long - the minimum number of deals, -1 for enumerated equities only
+OUTPUT:
+	ev: list (double) or None if not stored with that accuracy
+*/
+static PyObject *_rayeval_cache_get(PyObject *self, PyObject *args)
 {
-	char *filename, *filename7;
-	int test;
-  	if (!PyArg_ParseTuple(args, "ssi", &filename, &filename7, &test))
-    	return NULL;
-	if (raygen9(filename, filename7, (test != 0)))
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to generate hand ranks [9] file.");
+	stats_scope scope(STATS_CACHE);
+	char *game;
+	PyObject *py_store, *py_board, *py_pocket;
+	long long accuracy;
+	uint8_t key[CACHE_KEY_SIZE];
+	double ev[MAX_PLAYERS];
+	cache_store *c;
+
+	if (!PyArg_ParseTuple(args, "OsOOL", &py_store, &game, &py_board, &py_pocket, &accuracy))
+		return NULL;
+	int n_players = parse_cache_query(py_store, game, py_board, py_pocket, &c, key);
+	if (!n_players)
+		return NULL;
+	if (!cache_store_get(c, key, (accuracy < 0) ? CACHE_EXACT : (uint64_t) accuracy, ev, n_players))
+		Py_RETURN_NONE;
+	PyObject *py_ev = PyList_New(n_players);
+	for (int i = 0; i < n_players; i++)
+		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+	return py_ev;
+}
+
+/*
+INPUT:
+	store, game, board, pockets, accuracy: see cache_get
+	ev: list (double) - one per player
+OUTPUT:
+	None
+*/
+static PyObject *_rayeval_cache_put(PyObject *self, PyObject *args)
+{
+	stats_scope scope(STATS_CACHE);
+	char *game;
+	PyObject *py_store, *py_board, *py_pocket, *py_ev;
+	long long accuracy;
+	uint8_t key[CACHE_KEY_SIZE];
+	double ev[MAX_PLAYERS];
+	cache_store *c;
+
+	if (!PyArg_ParseTuple(args, "OsOOLO", &py_store, &game, &py_board, &py_pocket, &accuracy, &py_ev))
+		return NULL;
+	int n_players = parse_cache_query(py_store, game, py_board, py_pocket, &c, key);
+	if (!n_players)
+		return NULL;
+	if (!PyList_Check(py_ev) || PyList_Size(py_ev) != n_players)
+		RAISE_EXCEPTION(PyExc_ValueError, "Equities must be a list of one float per player.");
+	for (int i = 0; i < n_players; i++)
+	{
+		ev[i] = PyFloat_AsDouble(PyList_GetItem(py_ev, i));
+		if (ev[i] == -1.0 && PyErr_Occurred())
+			return NULL;
+	}
+	cache_store_put(c, key, (accuracy < 0) ? CACHE_EXACT : (uint64_t) accuracy, ev, n_players);
 	Py_RETURN_NONE;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//							SCENARIOS
+////////////////////////////////////////////////////////////////////////////////
 
-static PyObject *_rayeval_attach_handranks_7(PyObject *self, PyObject *args)
+// A spot parsed and checked once, to be evaluated many times over. The outs
+// queries also keep the walk states and the hero's scores of every turn and 
+// river, rebuilt only if HR9 changes. Queries read them with the GIL released,
+// so they are reference counted (under the GIL): a rebuild swaps in new ones 
+// and the old ones go once the last query reading them is done.
+
+typedef struct {
+	int refs;
+	int generation; // HR9_generation the boards were built with
+	outs_board *boards;
+} outs_cache;
+
+static void outs_cache_release(outs_cache *cache)
 {
-    char *path;
-    int user_id;
-  	if (!PyArg_ParseTuple(args, "si", &path, &user_id))
-    	return NULL;
-    if (!HR)
-        if (!(HR = attach_hr(ftok(path, user_id))))
-            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [7] from shared memory.");
-	Py_RETURN_NONE;
+	if (cache && --cache->refs == 0)
+	{
+		free(cache->boards);
+		free(cache);
+	}
 }
 
-static PyObject *_rayeval_attach_handranks_9(PyObject *self, PyObject *args)
+typedef struct {
+	PyObject_HEAD
+	mc_spot spot;
+	double n_deals;
+	int flop[3];
+	const char *outs_error; // why outs queries don't apply, NULL if they do
+	outs_cache *outs;
+} scenario_object;
+
+static int scenario_init(scenario_object *self, PyObject *args, PyObject *kwds)
 {
-    char *path;
-    int user_id;
-  	if (!PyArg_ParseTuple(args, "si", &path, &user_id))
-        return NULL;
-    if (!HR9)
-        if (!(HR9 = attach_hr(ftok(path, user_id))))
-            RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to load hand ranks [9] from shared memory.");
-	Py_RETURN_NONE;
+	char *game;
+	PyObject *py_board, *py_pocket;
+	int i, n_pocket;
+	uint64_t seen = 0;
+	mc_spot *spot = &self->spot;
+
+	if (!PyArg_ParseTuple(args, "sOO", &game, &py_board, &py_pocket))
+		return -1;
+	if (!parse_board_and_pockets(game, py_board, py_pocket, spot->board, spot->pocket, 
+		&spot->n_board, &n_pocket, &spot->n_players, &spot->is_omaha))
+		return -1;
+	for (i = 0; i < spot->n_board + n_pocket; i++)
+	{
+		int card = (i < spot->n_board) ? spot->board[i] : spot->pocket[i - spot->n_board];
+		if (card == 255)
+			continue;
+		if (seen & (1LLU << card))
+		{
+			PyErr_SetString(PyExc_ValueError, "Cards must be distinct.");
+			return -1;
+		}
+		seen |= 1LLU << card;
+	}
+	spot->N = 0;
+	self->n_deals = count_deals(spot->board, spot->n_board, spot->pocket, spot->n_players, 
+		spot->is_omaha ? 4 : 2);
+	self->outs_error = spot->is_omaha ? 
+		outs_query_error(spot->board, spot->n_board, spot->pocket, spot->n_players, self->flop) :
+		"Outs are only evaluated for omaha.";
+	outs_cache_release(self->outs);
+	self->outs = NULL;
+	return 0;
 }
 
-static PyObject *_rayeval_detach_handranks_7(PyObject *self, PyObject *args)
+static void scenario_dealloc(scenario_object *self)
 {
-    if (shmdt(HR - 1) == -1)
-    {
-        perror("shmdt");
-        RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to detach hand ranks [7] from shared memory.");
-    }
-	Py_RETURN_NONE;
+	outs_cache_release(self->outs);
+	Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
-static PyObject *_rayeval_detach_handranks_9(PyObject *self, PyObject *args)
+static int scenario_check_tables(scenario_object *self)
 {
-    if (shmdt(HR9 - 1) == -1)
-    {
-        perror("shmdt");
-        RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to detach hand ranks [9] from shared memory.");
-    }
-	Py_RETURN_NONE;
+	if (!self->spot.is_omaha && !HR)
+		PyErr_SetString(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
+	else if (self->spot.is_omaha && !HR9)
+		PyErr_SetString(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+	else
+		return 1;
+	return 0;
 }
 
-static PyObject *_rayeval_del_handranks_shm(PyObject *self, PyObject *args)
+// INPUT: iterations, n_threads, exact_threshold, interleave, stratify, seed, with_stats: see eval_mc
+// OUTPUT: ev: list (double) or, with_stats, see eval_mc
+static PyObject *scenario_eval_mc(scenario_object *self, PyObject *args)
 {
-    char *path;
-    int user_id;
-  	if (!PyArg_ParseTuple(args, "si", &path, &user_id))
-        return NULL;
-    if (del_shm(ftok(path, user_id)) == -1)
-        RAISE_EXCEPTION(PyExc_RuntimeError, "Failed to detach hand ranks from shared memory.");
-	Py_RETURN_NONE;
+	stats_scope scope(STATS_SCENARIO);
+	int iterations, n_threads = 1, interleave = MC_INTERLEAVE, stratify = 0, with_stats = 0;
+	long long exact_threshold = 0, py_seed = -1;
+	double ev[MAX_PLAYERS];
+	mc_spot *spot = &self->spot;
+	mc_stats stats;
+
+	if (!PyArg_ParseTuple(args, "i|iLiiLi", &iterations, &n_threads, &exact_threshold, 
+		&interleave, &stratify, &py_seed, &with_stats))
+		return NULL;
+    if (iterations <= 0)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+    if (interleave < 1 || interleave > MC_MAX_INTERLEAVE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Interleave must be between 1 and 32.");
+	if (!scenario_check_tables(self))
+		return NULL;
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+	int exact = (self->n_deals <= (double) exact_threshold);
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	if (exact)
+		eval_exact(spot->board, spot->n_board, spot->pocket, spot->n_players, spot->is_omaha, 
+			n_threads, ev, with_stats ? &stats : NULL);
+	else
+		eval_monte_carlo_parallel(iterations, spot->board, spot->n_board, spot->pocket, 
+			spot->n_players, spot->is_omaha, n_threads, seed, ev, interleave, stratify,
+			with_stats ? &stats : NULL);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+	if (with_stats)
+		return mc_stats_tuple(ev, &stats, spot->n_players);
+	return ev_list(ev, spot->n_players);
 }
 
-static PyObject *_rayeval_is_loaded_to_shm(PyObject *self, PyObject *args)
+// INPUT: max_iterations, target_stderr, n_threads, interleave, chunk, stratify, seed: see eval_mc_adaptive
+// OUTPUT: (ev, stderr, iterations): (list (double), list (double), int)
+static PyObject *scenario_eval_mc_adaptive(scenario_object *self, PyObject *args)
 {
-    char *path;
-    int user_id;
-    if (!PyArg_ParseTuple(args, "si", &path, &user_id))
-        return NULL;
-    if (shmget(ftok(path, user_id), 1, 0600) < 0)
-        Py_RETURN_FALSE;
-    Py_RETURN_TRUE;
+	stats_scope scope(STATS_SCENARIO);
+	int max_iterations, n_threads = 1, interleave = MC_INTERLEAVE, chunk = MC_ADAPTIVE_CHUNK;
+	int stratify = 0, n_done = 0;
+	long long py_seed = -1;
+	double target_stderr, ev[MAX_PLAYERS], std_err[MAX_PLAYERS];
+	mc_spot *spot = &self->spot;
+
+	if (!PyArg_ParseTuple(args, "id|iiiiL", &max_iterations, &target_stderr, &n_threads, 
+		&interleave, &chunk, &stratify, &py_seed))
+		return NULL;
+    if (max_iterations <= 1)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be an integer greater than 1.");
+    if (!(target_stderr >= 0.0))
+    	RAISE_EXCEPTION(PyExc_ValueError, "Target standard error must be non-negative.");
+    if (interleave < 1 || interleave > MC_MAX_INTERLEAVE)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Interleave must be between 1 and 32.");
+    if (chunk <= 1)
+    	RAISE_EXCEPTION(PyExc_ValueError, "Chunk must be an integer greater than 1.");
+	if (!scenario_check_tables(self))
+		return NULL;
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	uint64_t seed = (py_seed < 0) ? random_stream_seed() : (uint64_t) py_seed;
+
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	eval_monte_carlo_adaptive(max_iterations, spot->board, spot->n_board, spot->pocket, 
+		spot->n_players, spot->is_omaha, n_threads, seed, interleave, stratify, target_stderr, 
+		chunk, ev, std_err, &n_done);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+	return Py_BuildValue("(NNi)", ev_list(ev, spot->n_players), ev_list(std_err, spot->n_players), n_done);
+}
+
+// INPUT: n_threads: int (optional, 1 by default; 0 or negative to use all cores)
+// OUTPUT: ev: list (double)
+static PyObject *scenario_eval_exact(scenario_object *self, PyObject *args)
+{
+	stats_scope scope(STATS_SCENARIO);
+	int n_threads = 1;
+	double ev[MAX_PLAYERS];
+	mc_spot *spot = &self->spot;
+	if (!PyArg_ParseTuple(args, "|i", &n_threads))
+		return NULL;
+	if (!scenario_check_tables(self))
+		return NULL;
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	eval_exact(spot->board, spot->n_board, spot->pocket, spot->n_players, spot->is_omaha, n_threads, ev);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
+	return ev_list(ev, spot->n_players);
+}
+
+static PyObject *scenario_outs(scenario_object *self, PyObject *args, int rivers)
+{
+	stats_scope scope(STATS_SCENARIO);
+	int iterations, n_threads = 1;
+	long long py_seed = -1;
+	if (!PyArg_ParseTuple(args, "i|Li", &iterations, &py_seed, &n_threads))
+		return NULL;
+	if (self->outs_error)
+		RAISE_EXCEPTION(PyExc_ValueError, self->outs_error);
+	if (!HR9)
+		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+	if (!self->outs || self->outs->generation != HR9_generation)
+	{
+		outs_cache *cache = (outs_cache *) malloc(sizeof(outs_cache));
+		cache->refs = 1;
+		cache->generation = HR9_generation;
+		cache->boards = build_outs_boards(self->flop, self->spot.pocket);
+		outs_cache_release(self->outs);
+		self->outs = cache;
+	}
+	outs_cache *cache = self->outs;
+	cache->refs++;
+	PyObject *result = outs_query(cache->boards, self->flop, self->spot.pocket, iterations, 
+		n_threads, py_seed, rivers);
+	outs_cache_release(cache);
+	return result;
+}
+
+// INPUT: iterations, seed, n_threads: see eval_turn_outs_vs_random_omaha
+// OUTPUT: see eval_turn_outs_vs_random_omaha
+static PyObject *scenario_eval_turn_outs(scenario_object *self, PyObject *args)
+{
+	return scenario_outs(self, args, 0);
+}
+
+// INPUT: iterations, seed, n_threads: see eval_river_outs_vs_random_omaha
+// OUTPUT: see eval_river_outs_vs_random_omaha
+static PyObject *scenario_eval_river_outs(scenario_object *self, PyObject *args)
+{
+	return scenario_outs(self, args, 1);
+}
+
+static PyObject *scenario_get_game(scenario_object *self, void *closure)
+{
+	return PyString_FromString(self->spot.is_omaha ? "omaha" : "holdem");
+}
+
+static PyObject *scenario_get_board(scenario_object *self, void *closure)
+{
+	PyObject *py_board = PyList_New(self->spot.n_board);
+	for (int i = 0; i < self->spot.n_board; i++)
+		PyList_SET_ITEM(py_board, (Py_ssize_t) i, PyInt_FromLong(self->spot.board[i]));
+	return py_board;
+}
+
+static PyObject *scenario_get_pockets(scenario_object *self, void *closure)
+{
+	int n = self->spot.n_players * (self->spot.is_omaha ? 4 : 2);
+	PyObject *py_pocket = PyList_New(n);
+	for (int i = 0; i < n; i++)
+		PyList_SET_ITEM(py_pocket, (Py_ssize_t) i, PyInt_FromLong(self->spot.pocket[i]));
+	return py_pocket;
+}
+
+static PyObject *scenario_get_n_players(scenario_object *self, void *closure)
+{
+	return PyInt_FromLong(self->spot.n_players);
 }
 
-int *parse_board_and_pockets(char *game, PyObject *py_board, PyObject *py_pocket,
-	int *board, int *pocket, int *n_board, int *n_pocket, int *n_players, int *is_omaha)
+static PyObject *scenario_get_n_deals(scenario_object *self, void *closure)
 {
-	int i, pocket_size = 2;
-	static int ok = 1;
-	*is_omaha = 0;
+	return PyFloat_FromDouble(self->n_deals);
+}
 
-	if (!strcmp(game, "omaha"))
-		*is_omaha = 1;
-	else if (strcmp(game, "holdem"))
-    	RAISE_EXCEPTION(PyExc_ValueError, "Game type must be holdem or omaha.");
-    pocket_size += 2 * (*is_omaha);
+static PyMethodDef scenario_methods[] = {
+	{"eval_mc", (PyCFunction) scenario_eval_mc, METH_VARARGS, ""},
+	{"eval_mc_adaptive", (PyCFunction) scenario_eval_mc_adaptive, METH_VARARGS, ""},
+	{"eval_exact", (PyCFunction) scenario_eval_exact, METH_VARARGS, ""},
+	{"eval_turn_outs", (PyCFunction) scenario_eval_turn_outs, METH_VARARGS, ""},
+	{"eval_river_outs", (PyCFunction) scenario_eval_river_outs, METH_VARARGS, ""},
+	{NULL, NULL, 0, NULL}
+};
 
-  	if (!PyList_Check(py_board)) 
-    	RAISE_EXCEPTION(PyExc_TypeError, "Board must be a list.");
-  	if (!PyList_Check(py_pocket)) 
-    	RAISE_EXCEPTION(PyExc_TypeError, "Pockets must be a list.");
+static PyGetSetDef scenario_getset[] = {
+	{(char *) "game", (getter) scenario_get_game, NULL, NULL, NULL},
+	{(char *) "board", (getter) scenario_get_board, NULL, NULL, NULL},
+	{(char *) "pockets", (getter) scenario_get_pockets, NULL, NULL, NULL},
+	{(char *) "n_players", (getter) scenario_get_n_players, NULL, NULL, NULL},
+	{(char *) "n_deals", (getter) scenario_get_n_deals, NULL, NULL, NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
 
-    *n_pocket = (int) PyList_Size(py_pocket);
-    *n_board = (int) PyList_Size(py_board);
-    *n_players = *n_pocket / pocket_size;
-    if ((*n_players < 1) || (*n_players > MAX_PLAYERS))
-    	RAISE_EXCEPTION(PyExc_ValueError, "Invalid number of players.");
-    if ((*n_players) * pocket_size != (*n_pocket))
-    	RAISE_EXCEPTION(PyExc_ValueError, "Invalid number of pocket cards.");
-    if ((*n_board != 3) && (*n_board != 4) && (*n_board != 5))
-    	RAISE_EXCEPTION(PyExc_ValueError, "Board must contain 3-5 cards.");
+static PyTypeObject scenario_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_rayeval.Scenario",			// tp_name
+	sizeof(scenario_object),		// tp_basicsize
+};
 
-    for (i = 0; i < (*n_pocket); i++)
-    {
-    	PyObject *item = PyList_GetItem(py_pocket, i);
-    	if (!PyInt_Check(item))
-	    	RAISE_EXCEPTION(PyExc_TypeError, "Pocket cards must be integers.");
-    	pocket[i] = (int) PyInt_AsLong(item);
-    	if ((pocket[i] < 0 || pocket[i] > 51) && pocket[i] != 255)
-	    	RAISE_EXCEPTION(PyExc_TypeError, "Pocket cards must be 0-51 or 255.");
-    }
 
-    for (i = 0; i < (*n_board); i++)
-    {
-    	PyObject *item = PyList_GetItem(py_board, i);
-    	if (!PyInt_Check(item))
-	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be integers.");
-    	board[i] = (int) PyInt_AsLong(item);
-    	if ((board[i] < 0 || board[i] > 51) && board[i] != 255)
-	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be 0-51 or 255.");
-    }
+////////////////////////////////////////////////////////////////////////////////
+//							BENCHMARKS
+////////////////////////////////////////////////////////////////////////////////
 
-    return &ok;
-}
+/*
+	Timings of the hot paths, done natively so that the Python overhead isn't
+	part of them. Every case is run repeats times and the best run is kept;
+	the deals are drawn from a fixed seed, so the same build on the same 
+	machine is timed on the same work every time. See raybench.py.
+*/
 
-static PyObject *_rayeval_eval_hand(PyObject *self, PyObject *args)
-{
-	char *game;
-	PyObject *py_board, *py_pocket;
-	int n_board, n_pocket, i, value;
-	int n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha;
+#define BENCH_HANDS 		(1 << 16) // precomputed hands cycled through by the eval cases
+#define BENCH_MAX_RESULTS 	64
+#define BENCH_SEED 			0x5EEDBE7C4ULL
 
-	if (!PyArg_ParseTuple(args, "sOO", &game, &py_board, &py_pocket))
-		return NULL;
+typedef struct {
+	char name[32], params[64];
+	double ops, seconds; // seconds of the best repeat
+} bench_result;
 
-	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
-		&n_board, &n_pocket, &n_players, &is_omaha))
-		return NULL;
+typedef struct {
+	bench_result results[BENCH_MAX_RESULTS];
+	int n_results, repeats;
+	double scale;
+} bench_suite;
 
-	if (!is_omaha && !HR)
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
-	if (is_omaha && !HR9)
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+// times fn(ctx, ops) repeats times, fn returns the elapsed seconds of its own
+// timed part so that the setup isn't counted
+static void bench_add(bench_suite *suite, const char *name, const char *params, 
+	double (*fn)(void *, long long), void *ctx, double ops)
+{
+	if (suite->n_results == BENCH_MAX_RESULTS)
+		return;
+	long long n = MAX(1LL, (long long) (ops * suite->scale));
+	bench_result *r = suite->results + suite->n_results++;
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	snprintf(r->params, sizeof(r->params), "%s", params);
+	r->ops = (double) n;
+	r->seconds = 0.0;
+	for (int i = 0; i < suite->repeats; i++)
+	{
+		double t = (*fn)(ctx, n);
+		r->seconds = (i == 0) ? t : MIN(r->seconds, t);
+	}
+}
 
-	if (n_players > 1)
-		RAISE_EXCEPTION(PyExc_ValueError, "One player expected, found more.");
+static volatile int bench_sink; // keeps the results of the timed loops alive
 
-	for (i = 0; i < n_board; i++)
-		if (board[i] == 255)
-			RAISE_EXCEPTION(PyExc_ValueError, "Masked board is not allowed.");
-	for (i = 0; i < n_pocket; i++)
-		if (pocket[i] == 255)
-			RAISE_EXCEPTION(PyExc_ValueError, "Masked pocket is not allowed.");
+typedef struct {
+	int hands[BENCH_HANDS][9]; // 7-card: 1-52; 9-card: 0-51, the board then the pocket
+	int n_hands;
+} bench_hands;
 
-	if (is_omaha)
+// 1 if some suit has 3 board and 2 pocket cards, i.e. the flush walk is taken
+static int omaha_flush_possible(const int *cards)
+{
+	int board[4] = {0, 0, 0, 0}, pocket[4] = {0, 0, 0, 0};
+	for (int i = 0; i < 5; i++)
+		board[cards[i] & 3]++;
+	for (int i = 5; i < 9; i++)
+		pocket[cards[i] & 3]++;
+	for (int s = 0; s < 4; s++)
+		if (board[s] >= 3 && pocket[s] >= 2)
+			return 1;
+	return 0;
+}
+
+// 7-card hands if flush is -1, else 9-card hands with or without a possible flush
+static void bench_deal_hands(bench_hands *h, int flush, rng_t *rng)
+{
+	int sample[52];
+	h->n_hands = 0;
+	while (h->n_hands < BENCH_HANDS)
 	{
-		int fs = 106, snf = HR9[0] + 53, fo = HR9[1] + 56;
-		if (n_board < 5) { fs = HR9[fs]; snf = HR9[snf]; fo = HR9[fo]; }
-		if (n_board < 4) { fs = HR9[fs]; snf = HR9[snf]; fo = HR9[fo]; }
-		for (i = 0; i < n_board; i++)
-		{
-			fs = HR9[fs + board[i] + 1]; 
-			snf = HR9[snf + board[i] + 1];
-		}
-		for (i = 0; i < n_pocket; i++)
-		{
-			fs = HR9[fs + pocket[i] + 1];
-			snf = HR9[snf + pocket[i] + 1];
-		}
-		value = snf;
-		if (fs != 0)
-		{
-			int *HR9_f = HR9 + (4 - fs);
-			int flush_score = fo;
-			for (i = 0; i < n_board; i++)
-				flush_score = HR9_f[flush_score + board[i] + 1]; 
-			for (i = 0; i < n_pocket; i++)
-				flush_score = HR9_f[flush_score + pocket[i] + 1];
-			value = (flush_score > value) ? flush_score : value;
-		}
-		return PyInt_FromLong((long)value);
+		random_sample_52_ross(52, 9, sample, rng);
+		if (flush == -1)
+			for (int i = 0; i < 7; i++)
+				h->hands[h->n_hands][i] = sample[i] + 1;
+		else if (omaha_flush_possible(sample) == flush)
+			memcpy(h->hands[h->n_hands], sample, 9 * sizeof(int));
+		else
+			continue;
+		h->n_hands++;
 	}
-	else
+}
+
+static double bench_eval_7(void *ctx, long long ops)
+{
+	const bench_hands *h = (const bench_hands *) ctx;
+	int sum = 0;
+	double t = monotonic_seconds();
+	for (long long i = 0; i < ops; i++)
 	{
-		value = 53;
-		for (i = 0; i < n_board; i++)
-			value = HR[value + board[i] + 1];
-		for (i = 0; i < n_pocket; i++)
-			value = HR[value + pocket[i] + 1];
-		if (n_board + n_pocket < 7)
-			value = HR[value];
-		return PyInt_FromLong((long)value);
+		const int *c = h->hands[i & (BENCH_HANDS - 1)];
+		sum += HR[HR[HR[HR[HR[HR[HR[53 + c[0]] + c[1]] + c[2]] + c[3]] + c[4]] + c[5]] + c[6]];
 	}
+	t = monotonic_seconds() - t;
+	bench_sink = sum;
+	return t;
 }
 
-/*
-INPUT:
-	game: "omaha" | "holdem"
-	board: list (int)
-	pockets: list (int)
-	iterations: int
-OUTPUT:
-	ev: list (doble)
-*/
-static PyObject *_rayeval_eval_mc(PyObject *self, PyObject *args)
+static double bench_eval_9(void *ctx, long long ops)
 {
-	char *game;
-	PyObject *py_board, *py_pocket, *py_ev;
-	int i, n_board, n_pocket;
-	int iterations, n_players, board[5], pocket[4 * MAX_PLAYERS], is_omaha;
-	double ev[MAX_PLAYERS];
-
-	if (!PyArg_ParseTuple(args, "sOOi", &game, &py_board, &py_pocket, &iterations))
-		return NULL;
+	bench_hands *h = (bench_hands *) ctx;
+	int sum = 0;
+	double t = monotonic_seconds();
+	for (long long i = 0; i < ops; i++)
+	{
+		int *c = h->hands[i & (BENCH_HANDS - 1)];
+		sum += eval_hand_omaha(c, 5, c + 5);
+	}
+	t = monotonic_seconds() - t;
+	bench_sink = sum;
+	return t;
+}
 
-    if (iterations <= 0)
-    	RAISE_EXCEPTION(PyExc_ValueError, "Iterations must be a positive integer.");
+typedef struct {
+	int board[5], n_board, pocket[4 * MAX_PLAYERS], n_players, is_omaha, interleave;
+} bench_mc;
 
-	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
-		&n_board, &n_pocket, &n_players, &is_omaha))
-		return NULL;
+static double bench_eval_mc(void *ctx, long long ops)
+{
+	bench_mc *b = (bench_mc *) ctx;
+	double ev[MAX_PLAYERS];
+	double t = monotonic_seconds();
+	eval_monte_carlo_parallel((int) ops, b->board, b->n_board, b->pocket, b->n_players, 
+		b->is_omaha, 1, BENCH_SEED, ev, b->interleave, 0);
+	t = monotonic_seconds() - t;
+	bench_sink = (int) (ev[0] * 1000);
+	return t;
+}
 
-	if (!is_omaha && !HR)
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 7-card hand ranks first.");
-	if (is_omaha && !HR9)
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
+typedef struct {
+	int n, k;
+} bench_sample;
 
-	if (is_omaha)
-   		eval_monte_carlo_omaha(iterations, board, n_board, pocket, n_players, ev);
-   	else
-   		eval_monte_carlo_holdem(iterations, board, n_board, pocket, n_players, ev);
+static double bench_sample_ross(void *ctx, long long ops)
+{
+	bench_sample *b = (bench_sample *) ctx;
+	int out[52], sum = 0;
+	rng_t rng;
+	rng_seed(&rng, BENCH_SEED, 0);
+	double t = monotonic_seconds();
+	for (long long i = 0; i < ops; i++)
+	{
+		random_sample_52_ross(b->n, b->k, out, &rng);
+		sum += out[0];
+	}
+	t = monotonic_seconds() - t;
+	bench_sink = sum;
+	return t;
+}
 
-   	py_ev = PyList_New(n_players);
-   	for (i = 0; i < n_players; i++)
-   		PyList_SET_ITEM(py_ev, (Py_ssize_t) i, PyFloat_FromDouble(ev[i]));
+typedef struct {
+	const char *filename, *shm_name;
+	int method; // BACKING_HEAP: fread, BACKING_MMAP: populated mmap, BACKING_POSIX_SHM: attach
+	int failed;
+} bench_load;
 
-   	return py_ev;
+// ops loads of the whole table; the page cache is warm after the first repeat
+static double bench_load_table(void *ctx, long long ops)
+{
+	bench_load *b = (bench_load *) ctx;
+	table_info info;
+	double t = monotonic_seconds();
+	for (long long i = 0; i < ops && !b->failed; i++)
+	{
+		int backing = BACKING_NONE, *hr = NULL;
+		if (read_table_info(b->filename, &info))
+			b->failed = 1;
+		else if (b->method == BACKING_HEAP)
+		{
+			if (!(hr = smart_load(b->filename, 0, &backing)))
+				b->failed = 1;
+			free_table(hr, (size_t) info.length * sizeof(int), 0, backing);
+		}
+		else if (b->method == BACKING_MMAP)
+		{
+			if (!(hr = smart_mmap(b->filename, true, 0, &backing)))
+				b->failed = 1;
+			else
+				munmap((char *) hr - info.data_offset, 
+					(size_t) (info.data_offset + info.length * sizeof(int)));
+		}
+		else if (!(hr = posix_shm_attach(b->shm_name)) || posix_shm_detach(hr))
+			b->failed = 1;
+	}
+	return monotonic_seconds() - t;
 }
 
-// INPUT:
-// 		board: list(int)
-// OUTPUT:
-//		result: list (int) size 2 - 2 cards of the nuts
-static PyObject *_find_first_nuts_holdem(PyObject *self, PyObject *args)
+static void bench_tables(bench_suite *suite, const char *table, const char *filename)
 {
-	int board[5], result_pocket[2];
-
-	PyObject *py_board;
-	if (!PyArg_ParseTuple(args, "O", &py_board))
-		return NULL;
+	static const int methods[3] = {BACKING_HEAP, BACKING_MMAP, BACKING_POSIX_SHM};
+	static const char *method_names[3] = {"fread", "mmap", "shm_attach"};
+	char shm_name[64], params[64];
+	snprintf(shm_name, sizeof(shm_name), "/rayeval.bench.%d", (int) getpid());
+	int *shm = NULL, backing;
+	for (int m = 0; m < 3; m++)
+	{
+		bench_load b = {filename, shm_name, methods[m], 0};
+		if (methods[m] == BACKING_POSIX_SHM && !(shm = posix_shm_load(shm_name, filename, 0, &backing)))
+			continue;
+		snprintf(params, sizeof(params), "table=%s,method=%s", table, method_names[m]);
+		bench_add(suite, "load_table", params, bench_load_table, &b, 1.0 / suite->scale);
+		if (b.failed)
+			suite->n_results--;
+	}
+	if (shm)
+	{
+		posix_shm_detach(shm);
+		posix_shm_unlink(shm_name);
+	}
+}
 
-	if (!PyList_Check(py_board)) 
-    	RAISE_EXCEPTION(PyExc_TypeError, "Board must be a list.");
+typedef struct {
+	const char *filename;
+	int n_threads, phase; // 0: the IDs only, 1: the whole table
+	int failed;
+} bench_generate;
 
- 	int n_board = (int) PyList_Size(py_board);
+static double bench_generate_7(void *ctx, long long ops)
+{
+	bench_generate *b = (bench_generate *) ctx;
+	// the generators report their progress, keep it out of the output
+	std::streambuf *out = std::cout.rdbuf(NULL);
+	double t = monotonic_seconds();
+	for (long long i = 0; i < ops; i++)
+	{
+		if (b->phase == 0)
+		{
+			std::vector<int64_t> ids;
+			generate_ids(2e6, ids, make_id, b->n_threads, 7, 0);
+		}
+		else if (raygen7(b->filename, false, b->n_threads))
+			b->failed = 1;
+	}
+	t = monotonic_seconds() - t;
+	std::cout.rdbuf(out);
+	std::cout.clear();
+	return t;
+}
 
-    if (n_board != 3 && n_board != 4 && n_board != 5)
-    	RAISE_EXCEPTION(PyExc_ValueError, "Board must contain 3-5 cards.");
+// holdem (is_omaha 0) or omaha spots: a known hero pocket against random ones
+static void bench_mc_spots(bench_suite *suite, int is_omaha, const int *players, int n_counts)
+{
+	static const int hero[2][4] = {{48, 45, 255, 255}, {48, 45, 40, 37}}; // AcKd, AcKdQcJd
+	static const int board[5] = {2, 19, 33, 10, 255}; // 2h 6s Td 4h *
+	static const char *streets[3] = {"preflop", "flop", "turn"};
+	int pocket_size = is_omaha ? 4 : 2;
+	char params[64];
+	for (int p = 0; p < n_counts; p++)
+		for (int s = 0; s < 3; s++)
+		{
+			bench_mc b;
+			b.n_board = 5;
+			b.n_players = players[p];
+			b.is_omaha = is_omaha;
+			b.interleave = MC_INTERLEAVE;
+			int n_known = (s == 0) ? 0 : s + 2, n_masked = 5 - n_known;
+			for (int i = 0; i < 5; i++)
+				b.board[i] = (i < n_known) ? board[i] : 255;
+			for (int i = 0; i < pocket_size * b.n_players; i++)
+				b.pocket[i] = (i < pocket_size) ? hero[is_omaha][i] : 255;
+			n_masked += pocket_size * (b.n_players - 1);
+			snprintf(params, sizeof(params), "street=%s,players=%d,masked=%d", 
+				streets[s], b.n_players, n_masked);
+			bench_add(suite, is_omaha ? "eval_mc_omaha" : "eval_mc_holdem", params, 
+				bench_eval_mc, &b, is_omaha ? 2e5 : 5e5);
+		}
+}
 
-    for (int i = 0; i < n_board; i++)
-    {
-    	PyObject *item = PyList_GetItem(py_board, i);
-    	if (!PyInt_Check(item))
-	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be integers.");
-    	board[i] = (int) PyInt_AsLong(item);
-    	if (board[i] < 0 || board[i] > 51)
-	    	RAISE_EXCEPTION(PyExc_TypeError, "Board cards must be 0-51.");
-    }
+// runs the suite; the evaluation cases need the tables loaded, the load cases
+// the file names, generation is only timed if asked for (it takes seconds)
+void run_benchmarks(bench_suite *suite, const char *filename7, const char *filename9, 
+	const char *generate_to, int n_threads)
+{
+	rng_t rng;
+	rng_seed(&rng, BENCH_SEED, 0);
+	bench_hands *h = (bench_hands *) malloc(sizeof(bench_hands));
+	if (HR)
+	{
+		bench_deal_hands(h, -1, &rng);
+		bench_add(suite, "eval_hand_7", "", bench_eval_7, h, 2e7);
+	}
+	if (HR9)
+	{
+		bench_deal_hands(h, 1, &rng);
+		bench_add(suite, "eval_hand_9", "flush=1", bench_eval_9, h, 5e6);
+		bench_deal_hands(h, 0, &rng);
+		bench_add(suite, "eval_hand_9", "flush=0", bench_eval_9, h, 5e6);
+	}
+	free(h);
 
-	find_first_nuts_holdem(board, n_board, result_pocket);
+	static const int holdem_players[3] = {2, 6, 9}, omaha_players[2] = {2, 6};
+	if (HR)
+		bench_mc_spots(suite, 0, holdem_players, 3);
+	if (HR9)
+		bench_mc_spots(suite, 1, omaha_players, 2);
 
-	PyObject *py_result = PyList_New(2);
+	static const int sample_sizes[3] = {2, 5, 9};
+	for (int i = 0; i < 3; i++)
+	{
+		char params[64];
+		bench_sample b = {48, sample_sizes[i]};
+		snprintf(params, sizeof(params), "n=%d,k=%d", b.n, b.k);
+		bench_add(suite, "random_sample_52_ross", params, bench_sample_ross, &b, 1e7);
+	}
 
-	PyList_SET_ITEM(py_result, (Py_ssize_t) 0, PyInt_FromLong((long)result_pocket[0]));
-	PyList_SET_ITEM(py_result, (Py_ssize_t) 1, PyInt_FromLong((long)result_pocket[1]));
+	if (filename7 && *filename7)
+		bench_tables(suite, "7", filename7);
+	if (filename9 && *filename9)
+		bench_tables(suite, "9", filename9);
 
-    return py_result;
+	if (generate_to && *generate_to)
+	{
+		char params[64];
+		snprintf(params, sizeof(params), "phase=ids,threads=%d", n_threads);
+		bench_generate ids = {generate_to, n_threads, 0, 0};
+		bench_add(suite, "generate_handranks_7", params, bench_generate_7, &ids, 1.0 / suite->scale);
+		snprintf(params, sizeof(params), "phase=table,threads=%d", n_threads);
+		bench_generate table = {generate_to, n_threads, 1, 0};
+		bench_add(suite, "generate_handranks_7", params, bench_generate_7, &table, 1.0 / suite->scale);
+		if (table.failed)
+			suite->n_results--;
+		unlink(generate_to);
+	}
 }
 
 /*
 INPUT:
-	board: list (int)
-	pockets: list (int) - must contain 4 cards
-	iterations: int
+	filename7, filename9: str - hand ranks files to time the loading of, '' to skip
+	scale: double - multiplies the number of operations of every case
+	repeats: int - runs of every case, the best one is kept
+	generate_to: str - scratch file to time the 7-card table generation with, '' to skip
+	n_threads: int - generation threads
 OUTPUT:
-	result: list (doble)
-		result[0] - flop ev
-		result[1-52] - ev by turn outs
+	results: list (tuple (name, params, ops, seconds)) - params is a comma 
+		separated key=value string, seconds are those of the best repeat
 */
-static PyObject *_eval_turn_outs_vs_random_omaha(PyObject *self, PyObject *args)
+static PyObject *_rayeval_benchmark(PyObject *self, PyObject *args)
 {
-	PyObject *py_board, *py_pocket, *py_result;
-	int i, n_board, n_pocket, n_players, iterations;
-	int board[5], pocket[4 * MAX_PLAYERS], is_omaha, turnouts[52];
-	char game[] = "omaha";
-	double ev[MAX_PLAYERS];
-
-	if (!PyArg_ParseTuple(args, "OOi", &py_board, &py_pocket, &iterations))
+	char *filename7, *filename9, *generate_to;
+	double scale;
+	int repeats, n_threads;
+	if (!PyArg_ParseTuple(args, "ssdisi", &filename7, &filename9, &scale, &repeats, 
+		&generate_to, &n_threads))
 		return NULL;
+	if (scale <= 0 || repeats < 1)
+		RAISE_EXCEPTION(PyExc_ValueError, "Scale and repeats must be positive.");
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
 
-	if (!parse_board_and_pockets(game, py_board, py_pocket, board, pocket, 
-		&n_board, &n_pocket, &n_players, &is_omaha))
-		return NULL;
-
-	if (!HR9)
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Please load 9-card hand ranks first.");
-
-	if (n_players != 1)
-		RAISE_EXCEPTION(PyExc_RuntimeError, "Number of players must be one.");
+	bench_suite *suite = (bench_suite *) calloc(1, sizeof(bench_suite));
+	suite->scale = scale;
+	suite->repeats = repeats;
+	TABLES_ACQUIRE();
+	Py_BEGIN_ALLOW_THREADS
+	run_benchmarks(suite, filename7, filename9, generate_to, n_threads);
+	Py_END_ALLOW_THREADS
+	TABLES_RELEASE();
 
-	// Villain spectre is all possible pockets
-	pocket[4] = pocket[5] = pocket[6] = pocket[7] = 255;
-
-	// Calculate possible turn outs
-	uint64_t deck = new_deck();
-	for (i = 0; i < n_board; i++)
-		if (board[i] != 255)
-			extract_cards(&deck, board[i]);
-	for (i = 0; i < 4; i++)
-		if (pocket[i] != 255)
-			extract_cards(&deck, pocket[i]);
-	for (int i = 0; i < 52; i++)
-		if (deck & (1LLU << i))
-			turnouts[i] = i;
-		else
-			turnouts[i] = -1;
+	PyObject *py_results = PyList_New(suite->n_results);
+	for (int i = 0; i < suite->n_results; i++)
+	{
+		bench_result *r = suite->results + i;
+		PyList_SET_ITEM(py_results, (Py_ssize_t) i, 
+			Py_BuildValue("(ssdd)", r->name, r->params, r->ops, r->seconds));
+	}
+	free(suite);
+	return py_results;
+}
 
-   	py_result = PyList_New(53);
+/*
+INPUT:
+	enabled: int - 1 to start counting, 0 to stop
+	hardware: int - 1 to also open the cache and dTLB miss counters
+OUTPUT:
+	hardware: bool - whether the hardware counters are counting
+*/
+static PyObject *_rayeval_stats_enable(PyObject *self, PyObject *args)
+{
+	int enabled, hardware = 0;
+	if (!PyArg_ParseTuple(args, "i|i", &enabled, &hardware))
+		return NULL;
+	STATS_enabled = enabled != 0;
+	if (!enabled || !hardware)
+		stats_hw_close();
+	else
+		stats_hw_open();
+	return PyBool_FromLong(STATS_hw_fd[0] != -1);
+}
 
-   	eval_monte_carlo_omaha(iterations, board, n_board, pocket, 2, ev);
-	PyList_SET_ITEM(py_result, (Py_ssize_t) 0, PyFloat_FromDouble(ev[0]));
+static PyObject *_rayeval_stats_reset(PyObject *self, PyObject *args)
+{
+	stats_reset();
+	Py_RETURN_NONE;
+}
 
-   	for (i = 0; i < 52; i++)
+/*
+OUTPUT:
+	stats: dict - enabled, calls and seconds per entry point, deals, evaluations,
+		sample_seconds and walk_seconds (estimated from timed_deals), tables 
+		(backing and load_seconds of '7' and '9'), hardware (cache_misses and 
+		dtlb_misses, None if not counting)
+*/
+static PyObject *_rayeval_stats(PyObject *self, PyObject *args)
+{
+	PyObject *calls = PyDict_New(), *seconds = PyDict_New(), *tables, *hardware;
+	for (int i = 0; i < STATS_ENTRIES; i++)
 	{
-		if (turnouts[i] != -1)
-		{
-			board[3] = turnouts[i];
-	   		eval_monte_carlo_omaha(iterations, board, n_board, pocket, 2, ev);
-			PyList_SET_ITEM(py_result, (Py_ssize_t) (i + 1), PyFloat_FromDouble(ev[0]));
-		}
-		else
-		{
-			PyList_SET_ITEM(py_result, (Py_ssize_t) (i + 1), PyFloat_FromDouble(-1.0));
-		}
+		PyObject *c = PyLong_FromUnsignedLongLong(STATS.calls[i]);
+		PyObject *t = PyFloat_FromDouble(STATS.ns[i] * 1e-9);
+		PyDict_SetItemString(calls, stats_entry_names[i], c);
+		PyDict_SetItemString(seconds, stats_entry_names[i], t);
+		Py_DECREF(c);
+		Py_DECREF(t);
 	}
-
-   	return py_result;
+	tables = Py_BuildValue("{s:{s:s,s:d},s:{s:s,s:d}}", 
+		"7", "backing", backing_str(HR_backing), "load_seconds", STATS_load_seconds[0],
+		"9", "backing", backing_str(HR9_backing), "load_seconds", STATS_load_seconds[1]);
+	if (STATS_hw_fd[0] != -1)
+	{
+		uint64_t values[STATS_HW_COUNTERS];
+		stats_hw_read(values);
+		hardware = Py_BuildValue("{s:K,s:K}", "cache_misses", (unsigned long long) values[0],
+			"dtlb_misses", (unsigned long long) values[1]);
+	}
+	else
+	{
+		Py_INCREF(Py_None);
+		hardware = Py_None;
+	}
+	return Py_BuildValue("{s:O,s:N,s:N,s:K,s:K,s:K,s:d,s:d,s:N,s:N}", 
+		"enabled", STATS_enabled ? Py_True : Py_False, "calls", calls, "seconds", seconds, 
+		"deals", (unsigned long long) STATS.deals, 
+		"evaluations", (unsigned long long) STATS.evaluations,
+		"timed_deals", (unsigned long long) STATS.timed_deals,
+		"sample_seconds", STATS.sample_ns * 1e-9, "walk_seconds", STATS.walk_ns * 1e-9,
+		"tables", tables, "hardware", hardware);
 }
 
 
@@ -777,6 +5719,11 @@ static PyMethodDef _rayeval_methods[] = {
 	{"seed", (PyCFunction) _rayeval_seed, METH_VARARGS, ""},
 	{"generate_handranks_7", (PyCFunction) _rayeval_generate_handranks_7, METH_VARARGS, ""},
 	{"generate_handranks_9", (PyCFunction) _rayeval_generate_handranks_9, METH_VARARGS, ""},
+	{"test_handranks_9", (PyCFunction) _rayeval_test_handranks_9, METH_VARARGS, ""},
+	{"compact_handranks_9", (PyCFunction) _rayeval_compact_handranks_9, METH_VARARGS, ""},
+	{"reorder_handranks_9", (PyCFunction) _rayeval_reorder_handranks_9, METH_VARARGS, ""},
+	{"handranks_info", (PyCFunction) _rayeval_handranks_info, METH_VARARGS, ""},
+	{"verify_handranks", (PyCFunction) _rayeval_verify_handranks, METH_VARARGS, ""},
 	{"load_handranks_7", (PyCFunction) _rayeval_load_handranks_7, METH_VARARGS, ""},
     {"load_handranks_7_to_shm", (PyCFunction) _rayeval_load_handranks_7_to_shm, METH_VARARGS, ""},
 	{"load_handranks_9", (PyCFunction) _rayeval_load_handranks_9, METH_VARARGS, ""},
@@ -786,17 +5733,55 @@ static PyMethodDef _rayeval_methods[] = {
     {"detach_handranks_7", (PyCFunction) _rayeval_detach_handranks_7, METH_VARARGS, ""},
     {"detach_handranks_9", (PyCFunction) _rayeval_detach_handranks_9, METH_VARARGS, ""},
     {"del_handranks_shm", (PyCFunction) _rayeval_del_handranks_shm, METH_VARARGS, ""},
+    {"handranks_backing", (PyCFunction) _rayeval_handranks_backing, METH_VARARGS, ""},
     {"is_loaded_to_shm", (PyCFunction) _rayeval_is_loaded_to_shm, METH_VARARGS, ""},
 	{"eval_mc", (PyCFunction) _rayeval_eval_mc, METH_VARARGS, ""},
+	{"eval_mc_async", (PyCFunction) _rayeval_eval_mc_async, METH_VARARGS, ""},
+	{"mc_async_wait", (PyCFunction) _rayeval_mc_async_wait, METH_VARARGS, ""},
+	{"mc_async_progress", (PyCFunction) _rayeval_mc_async_progress, METH_VARARGS, ""},
+	{"mc_async_cancel", (PyCFunction) _rayeval_mc_async_cancel, METH_VARARGS, ""},
+	{"eval_mc_batch", (PyCFunction) _rayeval_eval_mc_batch, METH_VARARGS, ""},
+	{"eval_range_equity", (PyCFunction) _rayeval_eval_range_equity, METH_VARARGS, ""},
 	{"eval_hand", (PyCFunction) _rayeval_eval_hand, METH_VARARGS, ""},
+	{"eval_hands_batch", (PyCFunction) _rayeval_eval_hands_batch, METH_VARARGS, ""},
+	{"eval_mc_adaptive", (PyCFunction) _rayeval_eval_mc_adaptive, METH_VARARGS, ""},
+	{"simd_level", (PyCFunction) _rayeval_simd_level, METH_VARARGS, ""},
+	{"eval_exact", (PyCFunction) _rayeval_eval_exact, METH_VARARGS, ""},
+	{"count_deals", (PyCFunction) _rayeval_count_deals, METH_VARARGS, ""},
+	{"canonical_form", (PyCFunction) _rayeval_canonical_form, METH_VARARGS, ""},
+	{"generate_preflop_tables", (PyCFunction) _rayeval_generate_preflop_tables, METH_VARARGS, ""},
+	{"load_preflop_tables", (PyCFunction) _rayeval_load_preflop_tables, METH_VARARGS, ""},
+	{"preflop_equity", (PyCFunction) _rayeval_preflop_equity, METH_VARARGS, ""},
+	{"cache_open", (PyCFunction) _rayeval_cache_open, METH_VARARGS, ""},
+	{"cache_get", (PyCFunction) _rayeval_cache_get, METH_VARARGS, ""},
+	{"cache_put", (PyCFunction) _rayeval_cache_put, METH_VARARGS, ""},
+	{"benchmark", (PyCFunction) _rayeval_benchmark, METH_VARARGS, ""},
+	{"stats", (PyCFunction) _rayeval_stats, METH_NOARGS, ""},
+	{"stats_enable", (PyCFunction) _rayeval_stats_enable, METH_VARARGS, ""},
+	{"stats_reset", (PyCFunction) _rayeval_stats_reset, METH_NOARGS, ""},
 	{"test", (PyCFunction) _rayeval_test, METH_NOARGS, ""},
+	{"classify_hand", (PyCFunction) _rayeval_classify_hand, METH_VARARGS, ""},
+	{"find_nuts", (PyCFunction) _rayeval_find_nuts, METH_VARARGS, ""},
 	{"eval_turn_outs_vs_random_omaha", (PyCFunction) _eval_turn_outs_vs_random_omaha, METH_VARARGS, ""},
+	{"eval_river_outs_vs_random_omaha", (PyCFunction) _eval_river_outs_vs_random_omaha, METH_VARARGS, ""},
 	{"find_first_nuts_holdem", (PyCFunction) _find_first_nuts_holdem, METH_VARARGS, ""},
 	{NULL, NULL, 0, NULL}
 };
 
 PyMODINIT_FUNC init_rayeval(void)
 {
-	init_random_int_52();
-	Py_InitModule("_rayeval", _rayeval_methods);
+	init_random();
+	set_simd_level(-1);
+	PyObject *module = Py_InitModule("_rayeval", _rayeval_methods);
+	scenario_type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+	scenario_type.tp_doc = "Spot parsed once: Scenario(game, board, pockets)";
+	scenario_type.tp_new = PyType_GenericNew;
+	scenario_type.tp_init = (initproc) scenario_init;
+	scenario_type.tp_dealloc = (destructor) scenario_dealloc;
+	scenario_type.tp_methods = scenario_methods;
+	scenario_type.tp_getset = scenario_getset;
+	if (!module || PyType_Ready(&scenario_type) < 0)
+		return;
+	Py_INCREF(&scenario_type);
+	PyModule_AddObject(module, "Scenario", (PyObject *) &scenario_type);
 }
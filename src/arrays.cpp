@@ -1969,3 +1969,63 @@ int perm7[21][5] = {
   { 1, 3, 4, 5, 6 },
   { 2, 3, 4, 5, 6 }
 };
+
+/*
+** card classes of the compact 9-card table, indexed by cards 1-52 (0 skips
+** a board card): the rank 1-13 for the non-flush block, the suit 1-4 for 
+** the flush suit block and, per flush suit, the rank 2-14 of the cards of 
+** that suit (1 for the other suits) for the flush rank block
+*/
+unsigned char hr9c_rank_class[53] = {
+	0,
+	1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4,
+	4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7,
+	7, 7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10,
+	10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13
+};
+
+unsigned char hr9c_suit_class[53] = {
+	0,
+	1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4, 1,
+	2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4, 1, 2,
+	3, 4, 1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3,
+	4, 1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4
+};
+
+unsigned char hr9c_flush_class[5][53] = {
+  {
+	0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+  },
+  {
+	0,
+	2, 1, 1, 1, 3, 1, 1, 1, 4, 1, 1, 1, 5,
+	1, 1, 1, 6, 1, 1, 1, 7, 1, 1, 1, 8, 1,
+	1, 1, 9, 1, 1, 1, 10, 1, 1, 1, 11, 1, 1,
+	1, 12, 1, 1, 1, 13, 1, 1, 1, 14, 1, 1, 1
+  },
+  {
+	0,
+	1, 2, 1, 1, 1, 3, 1, 1, 1, 4, 1, 1, 1,
+	5, 1, 1, 1, 6, 1, 1, 1, 7, 1, 1, 1, 8,
+	1, 1, 1, 9, 1, 1, 1, 10, 1, 1, 1, 11, 1,
+	1, 1, 12, 1, 1, 1, 13, 1, 1, 1, 14, 1, 1
+  },
+  {
+	0,
+	1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 4, 1, 1,
+	1, 5, 1, 1, 1, 6, 1, 1, 1, 7, 1, 1, 1,
+	8, 1, 1, 1, 9, 1, 1, 1, 10, 1, 1, 1, 11,
+	1, 1, 1, 12, 1, 1, 1, 13, 1, 1, 1, 14, 1
+  },
+  {
+	0,
+	1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 4, 1,
+	1, 1, 5, 1, 1, 1, 6, 1, 1, 1, 7, 1, 1,
+	1, 8, 1, 1, 1, 9, 1, 1, 1, 10, 1, 1, 1,
+	11, 1, 1, 1, 12, 1, 1, 1, 13, 1, 1, 1, 14
+  }
+};
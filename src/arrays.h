@@ -3,4 +3,7 @@ extern short unique5[];
 extern int products[];
 extern short values[];
 extern int primes[13];
-extern int perm7[21][5];
\ No newline at end of file
+extern int perm7[21][5];
+extern unsigned char hr9c_rank_class[53];
+extern unsigned char hr9c_suit_class[53];
+extern unsigned char hr9c_flush_class[5][53];
\ No newline at end of file
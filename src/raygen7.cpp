@@ -2,9 +2,13 @@
 #include <iomanip>
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 #include "arrays.h"
 #include "rayutils.h"
+#include "raythreads.h"
+#include "raygen9.h"
 
 void init_deck(int *deck)
 {
@@ -58,11 +62,9 @@ short eval_7hand(int *hand)
 	return best;
 }
 
-int n_cards = 0;
-
 int64_t make_id(int64_t id_in, int new_card) 
 {
-	int n_suit[4 + 1], n_rank[13 + 1], n, done = 0, needsuited;
+	int n_suit[4 + 1], n_rank[13 + 1], n, n_cards, done = 0, needsuited;
 	int cards[8];  // intentially keep an extra one as 0 end
 	
 	memset(cards, 0, sizeof(cards));
@@ -125,43 +127,6 @@ int64_t make_id(int64_t id_in, int new_card)
 		 ((int64_t) cards[6] << 48));    
 }
 
-int save_id(int64_t id, int64_t *ids, int64_t *max_id, int *num_ids) 
-{
-	if (id == 0)
-		return 0; 
-
-	if (id >= (*max_id))
-	{           		
-		if (id > (*max_id))
-		{        
-			ids[(*num_ids)++] = id;
-			(*max_id) = id;
-		}
-		return (*num_ids) - 1;
-	}
-
-	// pseudo bsearch
-	int holdtest, low = 0, high = (*num_ids) - 1;
-	int64_t testval;
-
-	while (high - low > 1) 
-	{
-		holdtest = (high + low + 1) / 2;
-		testval = ids[holdtest] - id;
-		if (testval > 0) 
-			high = holdtest;
-		else if (testval < 0) 
-			low = holdtest;
-		else 
-			return holdtest;
-	}
-	memmove(&ids[high + 1], &ids[high], ((*num_ids) - high) * sizeof(ids[0]));  
-
-	ids[high] = id;
-	(*num_ids)++;        
-	return high;
-}
-
 int do_eval(int64_t id_in)
 {
 	int n, handrank = 0, wcard, rank, suit, suititerator = 0, holdrank,
@@ -238,65 +203,143 @@ int do_eval(int64_t id_in)
 	return handrank;
 }
 
-int raygen7(const char *filename, bool test=true)
+int count_cards_7(int64_t id)
 {
-	int card, count = 0, num_ids = 1, n, id_slot, max_handrank = 0, handTypeSum[10], holdid;
-	int64_t ID, max_id = 0LLU;
-	int *_HR = (int *) malloc(32487834 * sizeof(int));
-	int64_t *ids = (int64_t *) malloc(612978 * sizeof(int64_t));
+	int n = 0;
+	for (; n < 7 && ((id >> (8 * n)) & 0xff); n++);
+	return n;
+}
 
-	memset(handTypeSum, 0, sizeof(handTypeSum));
-	memset((long long *) ids, 0LLU, sizeof(ids));
-	memset((int *) _HR, 0, sizeof(_HR));
+struct eval_job {
+	const int64_t *ids;
+	int begin, end;
+	int *values;
+	bool failed;
+};
+
+// evaluates a slice of the 7-card IDs
+void *eval_job_run(void *arg)
+{
+	eval_job *job = (eval_job *) arg;
+	for (int i = job->begin; i < job->end; i++)
+		if ((job->values[i] = do_eval(job->ids[i])) == -1)
+			job->failed = true;
+	return NULL;
+}
+
+struct fill_job {
+	const std::vector<int64_t> *ids;
+	int begin, end, n_nodes;
+	const int *values;
+	int *hand_ranks;
+	volatile long *n_done;
+	bool report;
+	bool failed;
+};
+
+// fills the rows of a slice of the IDs, rows of different IDs never overlap
+void *fill_job_run(void *arg)
+{
+	fill_job *job = (fill_job *) arg;
+	const std::vector<int64_t> &ids = *job->ids;
+	int i, card, num_cards, value, n = job->n_nodes;
+	int64_t id, new_id;
+	int *_HR = job->hand_ranks;
 
-	for (n = 0; ids[n] || n == 0; n++)
-	{  
+	for (i = job->begin; i < job->end; i++)
+	{
+		id = ids[i];
+		num_cards = count_cards_7(id);
 		for (card = 1; card < 53; card++)
-		{	 
-			ID = make_id(ids[n], card);
-			if (n_cards < 7) 
-				holdid = save_id(ID, ids, &max_id, &num_ids);
-		}
-		if ((n + 2) % 19 == 0)
-			std::cout << "\rGenerating card IDs...  " << std::fixed << std::setw(6) <<
-				(n + 1) << " / 612977";
-	}
-	std::cout << "\n";
-	for (n = 0; ids[n] || n == 0; n++)
-	{  
-		for (card = 1; card < 53; card++) 
 		{
-			ID = make_id(ids[n], card);
-			if (n_cards < 7)
-				id_slot = save_id(ID, ids, &max_id, &num_ids) * 53 + 53;
+			new_id = make_id(id, card);
+			// the IDs are sorted, so the index is found by bisection
+			if (num_cards + 1 == 7) // 7 cards: the hand rank, 0 if the id is not valid
+				value = new_id ? job->values[std::lower_bound(ids.begin() + n, ids.end(), 
+					new_id) - (ids.begin() + n)] : 0;
+			else if (new_id)
+				value = (int) (std::lower_bound(ids.begin(), ids.begin() + n, new_id) - 
+					ids.begin()) * 53 + 53;
 			else
-				id_slot = do_eval(ID);
-			if (id_slot == -1)
-			{
-				std::cout << "    Error: problem with n_cards = " << n_cards << ".\n";
-				free(_HR); free(ids); _HR = 0; ids = 0; return 1;
-			}
-			max_handrank = n * 53 + card + 53;
-			_HR[max_handrank] = id_slot;
+				value = 53; // < 7 cards and id is not valid
+			_HR[i * 53 + card + 53] = value;
 		}
-		if (n_cards == 6 || n_cards == 7) 
-		{  
-			int value = do_eval(ids[n]);
-			if (value == -1)
-			{
-				std::cout << "    Error: problem with n_cards = " << n_cards << ".\n";
-				free(_HR); free(ids); _HR = 0; ids = 0; return 1;
-			}
-			_HR[n * 53 + 53] = value;
+		if (num_cards == 5 || num_cards == 6)
+		{
+			if ((value = do_eval(id)) == -1)
+				job->failed = true;
+			_HR[i * 53 + 53] = value;
 		}
-		if ((n + 2) % 19 == 0)
-			std::cout << "\rSetting hand ranks...  " << std::fixed << std::setw(6) <<
-				(n + 1) << " / 612977";
+		if ((i + 1 - job->begin) % 4096 == 0)
+		{
+			long done = __sync_add_and_fetch(job->n_done, 4096);
+			if (job->report)
+				std::cout << "\rSetting hand ranks...  " << std::fixed << std::setw(6) <<
+					done << " / " << n;
+		}
+	}
+	return NULL;
+}
+
+int raygen7(const char *filename, bool test, int n_threads)
+{
+	int count = 0, n, n_leaves, i, handTypeSum[10];
+	bool failed = false;
+	std::vector<int64_t> ids;
+
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	memset(handTypeSum, 0, sizeof(handTypeSum));
+
+	// 0-7 cards, each level is expanded by every card and sorted; no board skipping;
+	// the 7-card IDs (bytes 0-6 used) come last and are the leaves of the table
+	generate_ids(2e6, ids, make_id, n_threads, 7, 0);
+	n = (int) (std::lower_bound(ids.begin(), ids.end(), 1LL << 48) - ids.begin());
+	n_leaves = (int) ids.size() - n;
+	std::cout << "\n";
+
+	// every distinct 7-card hand is evaluated once
+	std::cout << "Evaluating " << n_leaves << " 7-card hands...";
+	std::vector<int> values(n_leaves);
+	int n_jobs = MIN(n_threads, n_leaves);
+	std::vector<eval_job> eval_jobs(n_jobs);
+	for (i = 0; i < n_jobs; i++)
+	{
+		eval_job job = {&ids[n], (int) ((int64_t) n_leaves * i / n_jobs),
+			(int) ((int64_t) n_leaves * (i + 1) / n_jobs), &values[0], false};
+		eval_jobs[i] = job;
+	}
+	run_threads(n_jobs, eval_job_run, &eval_jobs[0], sizeof(eval_job));
+	for (i = 0; i < n_jobs; i++)
+		failed |= eval_jobs[i].failed;
+	std::cout << "\n";
+
+	int *_HR = (int *) calloc((size_t) n * 53 + 53, sizeof(int));
+	if (!_HR)
+		return 1;
+
+	n_jobs = MIN(n_threads, n);
+	volatile long n_done = 0;
+	std::vector<fill_job> jobs(n_jobs);
+	for (i = 0; i < n_jobs; i++)
+	{
+		fill_job job = {&ids, (int) ((int64_t) n * i / n_jobs),
+			(int) ((int64_t) n * (i + 1) / n_jobs), n, &values[0], _HR, &n_done, i == 0, false};
+		jobs[i] = job;
+	}
+	run_threads(n_jobs, fill_job_run, &jobs[0], sizeof(fill_job));
+	std::cout << "\rSetting hand ranks...  " << std::fixed << std::setw(6) << n << " / " << n;
+	for (i = 0; i < n_jobs; i++)
+		failed |= jobs[i].failed;
+	if (failed)
+	{
+		std::cout << "\n    Error: failed to evaluate a hand.\n";
+		free(_HR); _HR = 0; return 1;
 	}
-	std::cout << "\nThe highest hand rank: " << max_handrank << ".";
+	std::cout << "\nThe highest hand rank: " << ((n - 1) * 53 + 52 + 53) << ".";
 
-	int result = smart_save(_HR, 32487834, filename);
-	free(_HR); free(ids); _HR = 0; ids = 0;
+	int result = smart_save(_HR, n * 53 + 53, filename, TABLE_KIND_7);
+	free(_HR); _HR = 0;
 	if (result)
 		return result;
 
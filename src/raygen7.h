@@ -1,4 +1,6 @@
-int raygen7(const char *filename, bool test=true);
+int raygen7(const char *filename, bool test=true, int n_threads=0);
+
+int64_t make_id(int64_t id_in, int new_card);
 
 void init_deck(int *deck);
 void init_deck_another_way(int *deck);
@@ -76,9 +76,11 @@ HOW TO USE THE DATA FILE TO EVALUATE 7-, 8- AND 9-CARD OMAHA HANDS
 #include <tr1/unordered_map>
 #include <exception>
 #include <string.h>
+#include <sys/time.h>
 
 #include "rayutils.h"
 #include "arrays.h"
+#include "raythreads.h"
 
 const int ANY_CARD = 1;			// placeholder for flush ranks eval
 const int SKIP_BOARD = 53; 		// placeholder for 7-8 card hands
@@ -93,6 +95,8 @@ const int board_perms[10][3] = {
 }; 	
 const int n_pocket_perms = 6;
 
+const int PROGRESS_STEP = 1 << 16;	// IDs per progress counter update
+
 void skip_board(int *board, int &n_board)
 {
 	int temp[5] = {0, 0, 0, 0, 0};
@@ -427,39 +431,147 @@ int eval_no_flush(int64_t id)
 	we just start off from a different offset).
 */
 
-void generate_ids(size_t size, std::vector<int64_t> &id_list,
-	int64_t (*add_card_to_id) (int64_t, int))
+struct sort_job {
+	int64_t *first, *middle, *last;
+};
+
+void *sort_job_run(void *arg)
+{
+	sort_job *job = (sort_job *) arg;
+	if (job->middle)
+		std::inplace_merge(job->first, job->middle, job->last);
+	else
+		std::sort(job->first, job->last);
+	return NULL;
+}
+
+// merges adjacent sorted runs [bounds[i], bounds[i + 1]) pairwise, in parallel, 
+// until the whole vector is sorted
+void merge_sorted_runs(std::vector<int64_t> &v, std::vector<size_t> bounds)
+{
+	if (v.empty())
+		return;
+	while (bounds.size() > 2)
+	{
+		std::vector<sort_job> jobs;
+		std::vector<size_t> merged;
+		for (size_t i = 0; i + 2 < bounds.size(); i += 2)
+		{
+			sort_job job = {&v[0] + bounds[i], &v[0] + bounds[i + 1], &v[0] + bounds[i + 2]};
+			jobs.push_back(job);
+			merged.push_back(bounds[i]);
+		}
+		if (bounds.size() % 2 == 0) // odd number of runs, the last one waits
+			merged.push_back(bounds[bounds.size() - 2]);
+		merged.push_back(bounds.back());
+		run_threads((int) jobs.size(), sort_job_run, &jobs[0], sizeof(sort_job));
+		bounds.swap(merged);
+	}
+}
+
+void parallel_sort(std::vector<int64_t> &v, int n_threads)
+{
+	if (n_threads <= 1 || v.size() < (size_t) PROGRESS_STEP)
+	{
+		std::sort(v.begin(), v.end());
+		return;
+	}
+	std::vector<sort_job> jobs(n_threads);
+	std::vector<size_t> bounds(n_threads + 1);
+	for (int i = 0; i <= n_threads; i++)
+		bounds[i] = v.size() * i / n_threads;
+	for (int i = 0; i < n_threads; i++)
+	{
+		jobs[i].first = &v[0] + bounds[i];
+		jobs[i].middle = NULL;
+		jobs[i].last = &v[0] + bounds[i + 1];
+	}
+	run_threads(n_threads, sort_job_run, &jobs[0], sizeof(sort_job));
+	merge_sorted_runs(v, bounds);
+}
+
+struct expand_job {
+	const std::vector<int64_t> *ids;
+	size_t begin, end;
+	int min_card;
+	int64_t (*add_card_to_id) (int64_t, int);
+	std::vector<int64_t> result;
+	volatile long *n_done;
+	bool report;
+};
+
+// adds every possible card to a slice of the IDs, result is sorted and unique
+void *expand_job_run(void *arg)
+{
+	expand_job *job = (expand_job *) arg;
+	int64_t new_id;
+	long n = (long) job->ids->size();
+	for (size_t i = job->begin; i < job->end; i++)
+	{
+		int64_t id = (*job->ids)[i];
+		for (int new_card = job->min_card; new_card <= 52; new_card++)
+			if ((new_id = (*job->add_card_to_id)(id, new_card)) != 0)
+				job->result.push_back(new_id);
+		if ((i + 1 - job->begin) % PROGRESS_STEP == 0)
+		{
+			long done = __sync_add_and_fetch(job->n_done, PROGRESS_STEP);
+			if (job->report)
+				std::cout << "\r\t" << "Processing ID " << done << " / " << n << "...";
+		}
+		
+	}
+	__sync_add_and_fetch(job->n_done, (long) ((job->end - job->begin) % PROGRESS_STEP));
+	std::sort(job->result.begin(), job->result.end());
+	job->result.erase(std::unique(job->result.begin(), job->result.end()), job->result.end());
+	return NULL;
+}
 
+// expands the IDs level by level up to max_cards cards, the first n_skip cards may
+// also be skipped (card 0); the levels are concatenated into a single sorted list
+void generate_ids(size_t size, std::vector<int64_t> &id_list,
+	int64_t (*add_card_to_id) (int64_t, int), int n_threads, int max_cards, int n_skip)
 {
 	std::vector<int64_t> id_queue_1, id_queue_2;
-	int64_t new_id = 0;
 	id_list.reserve(size);
 	id_list.clear();
 	id_list.push_back(0LL);
-	id_queue_1.reserve(size);
-	id_queue_2.reserve(size);
 	id_queue_1.push_back(0LL);
-	for (int n_cards = 1; n_cards <= 8; n_cards++)
+	for (int n_cards = 1; n_cards <= max_cards; n_cards++)
 	{
 		std::cout << "\nGenerating " << n_cards << "-card IDs:\n";
 
-		int n1 = (int) id_queue_1.size(); // LOL, if we don't do this, expect nasty bugs
-		for (int i = 0; i < n1; i++)
+		// each thread expands, sorts and uniques its own slice of the queue
+		size_t n1 = id_queue_1.size();
+		int n_jobs = (int) MIN((size_t) n_threads, n1);
+		volatile long n_done = 0;
+		std::vector<expand_job> jobs(n_jobs);
+		for (int i = 0; i < n_jobs; i++)
+		{
+			jobs[i].ids = &id_queue_1;
+			jobs[i].begin = n1 * i / n_jobs;
+			jobs[i].end = n1 * (i + 1) / n_jobs;
+			jobs[i].min_card = (n_cards <= n_skip) ? 0 : 1; // board skipping
+			jobs[i].add_card_to_id = add_card_to_id;
+			jobs[i].n_done = &n_done;
+			jobs[i].report = (i == 0);
+		}
+		run_threads(n_jobs, expand_job_run, &jobs[0], sizeof(expand_job));
+		std::cout << "\r\t" << "Processing ID " << n1 << " / " << n1 << "...";
+
+		size_t size = 0;
+		std::vector<size_t> bounds(1, 0);
+		for (int i = 0; i < n_jobs; i++)
+			bounds.push_back(size += jobs[i].result.size());
+		id_queue_2.reserve(size);
+		for (int i = 0; i < n_jobs; i++)
 		{
-			std::cout << "\r\t" << "Processing ID " << i + 1 << " / " <<
-				n1 << "...";
-
-			int64_t id = id_queue_1[i];
-			int min_card = (n_cards <= 2) ? 0 : 1; // board skipping
-			for (int new_card = min_card; new_card <= 52; new_card++)
-				if ((new_id = (*add_card_to_id)(id, new_card)) != 0)
-					id_queue_2.push_back(new_id);
+			id_queue_2.insert(id_queue_2.end(), jobs[i].result.begin(), jobs[i].result.end());
+			std::vector<int64_t>().swap(jobs[i].result);
 		}
-		std::cout << "\n\t" << id_queue_1.size() << ", " << id_queue_2.size() << "\n";
-		size_t size = id_queue_2.size();
-		std::cout << "\n\tGenerated " << id_queue_2.size() << " IDs." <<
+		std::cout << "\n\t" << n1 << ", " << size << "\n";
+		std::cout << "\n\tGenerated " << size << " IDs." <<
 			"\n\tSorting and dropping duplicates...";
-		std::sort(id_queue_2.begin(), id_queue_2.end());
+		merge_sorted_runs(id_queue_2, bounds);
 		id_queue_2.erase(std::unique(id_queue_2.begin(), id_queue_2.end()), 
 			id_queue_2.end());
 		std::cout << " dropped " << (size - id_queue_2.size()) << " IDS.";
@@ -471,7 +583,7 @@ void generate_ids(size_t size, std::vector<int64_t> &id_list,
 		id_queue_2.clear();
 	}
 	std::cout << "\n\tFinished: generated " << id_list.size() << " IDs, sorting....";
-	std::sort(id_list.begin(), id_list.end());
+	parallel_sort(id_list, n_threads);
 	std::vector<int64_t>().swap(id_queue_1);
 	std::vector<int64_t>().swap(id_queue_2);
 }
@@ -506,37 +618,32 @@ void generate_ids(size_t size, std::vector<int64_t> &id_list,
 		suit 3:         --   --  --   [1]  --   --   --   [2]  --   --   -- 
 */
 
-void process_ids(std::vector<int64_t> ids, int offset, int offset_value,
-	std::vector<int> &hand_ranks, int64_t (*add_card_to_id)(int64_t, int),
-	int (*eval_id)(int64_t), int n_dummy, int dummy_card,
-	std::tr1::unordered_map<int, int> map=std::tr1::unordered_map<int, int>())
-{
-	// offset + 0: special value
-	// offset + 1-52: loop back to offset + 0
-	// offset + 53: starting point
-	// offset + 54+: normal operation
+struct process_job {
+	const std::vector<int64_t> *ids;
+	int begin, end;
+	int offset, block_size, dummy_card;
+	int *hand_ranks;
+	int64_t (*add_card_to_id)(int64_t, int);
+	int (*eval_id)(int64_t);
+	const std::tr1::unordered_map<int, int> *map;
+	volatile long *n_done;
+	bool report;
+};
 
-	int n = (int) ids.size(), i, id_index, num_cards, new_card;
+// fills the blocks of a slice of the IDs, blocks of different IDs never overlap
+void *process_job_run(void *arg)
+{
+	process_job *job = (process_job *) arg;
+	const std::vector<int64_t> &ids = *job->ids;
+	int i, id_index, num_cards, new_card, n = (int) ids.size(),
+		offset = job->offset, block_size = job->block_size;
 	int64_t id, new_id;
-	int block_size = 53 + n_dummy;
-	std::tr1::unordered_map<int64_t, int> hash_table;
-
-	for (i = 0; i < n; i++)
-	{
-		std::cout << "\r\tCreating unordered map... " << (i + 1) << " / " << n;
-		hash_table.insert(std::tr1::unordered_map<int64_t, int>::value_type(ids[i], i));
-	}
-	std::cout << "\n";
+	int *hand_ranks = job->hand_ranks;
+	std::tr1::unordered_map<int, int>::const_iterator it;
 
-	hand_ranks[offset] = offset_value;
-	for (i = 1; i <= 52; i++)
-		hand_ranks[offset + i] = offset;
-	for (i = 53; i < block_size; i++)
-		hand_ranks[offset + i] = offset;
-	for (i = 0; i < n; i++)
+	for (i = job->begin; i < job->end; i++)
 	{
 		id = ids[i];
-		std::cout << "\r\tProcessing ID " << i + 1 << " out of " << n << " (" << id << ")..." ;
 		id_index = offset + block_size + i * block_size;
 		num_cards = count_cards(id);
 		hand_ranks[id_index] = offset; // safety backup
@@ -545,42 +652,88 @@ void process_ids(std::vector<int64_t> ids, int offset, int offset_value,
 		int dummy_value = -1;
 		for (new_card = min_card; new_card <= 52; new_card++)
 		{			
-			new_id = (*add_card_to_id)(id, new_card);
+			new_id = (*job->add_card_to_id)(id, new_card);
 			if (new_id && ((num_cards + 1) == 9))
 			{
-				int value = (*eval_id)(new_id);
-				hand_ranks[id_index + new_card] = map.count(value) ? map[value] : value;
+				int value = (*job->eval_id)(new_id);
+				hand_ranks[id_index + new_card] = 
+					((it = job->map->find(value)) != job->map->end()) ? it->second : value;
 			}
-			else if (new_id)
-				hand_ranks[id_index + new_card] = offset + block_size + 
-					hash_table[new_id] * block_size;
+			else if (new_id) // the IDs are sorted, so the index is found by bisection
+				hand_ranks[id_index + new_card] = offset + block_size + block_size * 
+					(int) (std::lower_bound(ids.begin(), ids.end(), new_id) - ids.begin());
 			else
 				hand_ranks[id_index + new_card] = offset; // < 9 cards and id is not valid
-			if (new_card == dummy_card)
+			if (new_card == job->dummy_card)
 				dummy_value = hand_ranks[id_index + new_card];
 		}
 		if (dummy_value != -1)		
 			for (new_card = 53; new_card < block_size; new_card++)
 				hand_ranks[id_index + new_card] = dummy_value;
+
+		if ((i + 1 - job->begin) % PROGRESS_STEP == 0)
+		{
+			long done = __sync_add_and_fetch(job->n_done, PROGRESS_STEP);
+			if (job->report)
+				std::cout << "\r\tProcessing ID " << done << " out of " << n << "...";
+		}
 	}
+	return NULL;
+}
+
+void process_ids(const std::vector<int64_t> &ids, int offset, int offset_value,
+	std::vector<int> &hand_ranks, int64_t (*add_card_to_id)(int64_t, int),
+	int (*eval_id)(int64_t), int n_dummy, int dummy_card,
+	const std::tr1::unordered_map<int, int> &map, int n_threads)
+{
+	// offset + 0: special value
+	// offset + 1-52: loop back to offset + 0
+	// offset + 53: starting point
+	// offset + 54+: normal operation
 
+	int n = (int) ids.size(), i;
+	int block_size = 53 + n_dummy;
+
+	hand_ranks[offset] = offset_value;
+	for (i = 1; i <= 52; i++)
+		hand_ranks[offset + i] = offset;
+	for (i = 53; i < block_size; i++)
+		hand_ranks[offset + i] = offset;
+
+	int n_jobs = MIN(n_threads, n);
+	volatile long n_done = 0;
+	std::vector<process_job> jobs(n_jobs);
+	for (i = 0; i < n_jobs; i++)
+	{
+		process_job job = {&ids, (int) ((int64_t) n * i / n_jobs), 
+			(int) ((int64_t) n * (i + 1) / n_jobs), offset, block_size, dummy_card,
+			&hand_ranks[0], add_card_to_id, eval_id, &map, &n_done, i == 0};
+		jobs[i] = job;
+	}
+	run_threads(n_jobs, process_job_run, &jobs[0], sizeof(process_job));
+	std::cout << "\r\tProcessing ID " << n << " out of " << n << "...";
 }
 
 // int generate_handranks(int *hand_ranks)
-int generate_handranks(std::vector<int> &hand_ranks)
+int generate_handranks(std::vector<int> &hand_ranks, int n_threads)
 {
 	std::vector<int64_t> id_fs, id_fr1, id_fr2, id_fr3, id_fr4, id_nf;
 
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	card_to_cactus(1, 1); // fills its lookup table before the workers get to it
+	std::cout << "\nUsing " << n_threads << " thread(s).";
+
 	std::cout << "\n====== PHASE 1 (GENERATE IDS) ======";
 
 	std::cout << "\n\n>> IDs for flush suits... \n";
-	generate_ids(100e3, id_fs, add_card_to_id_flush_suits);
+	generate_ids(100e3, id_fs, add_card_to_id_flush_suits, n_threads, 8, 2);
 
 	std::cout << "\n\n>> IDs for flush ranks (suit #4)... \n";	
-	generate_ids(10e6, id_fr4, add_card_to_id_flush_ranks_4);
+	generate_ids(10e6, id_fr4, add_card_to_id_flush_ranks_4, n_threads, 8, 2);
 
 	std::cout << "\n\n>> IDs for non-flush hands... \n";	
-	generate_ids(100e6, id_nf, add_card_to_id_no_flush);
+	generate_ids(100e6, id_nf, add_card_to_id_no_flush, n_threads, 8, 2);
 
 	int n_fs = (int) id_fs.size(), n_fr4 = (int) id_fr4.size(), 
 		n_nf = (int) id_nf.size();
@@ -602,19 +755,19 @@ int generate_handranks(std::vector<int> &hand_ranks)
 	std::tr1::unordered_map<int, int> map_fs;
 	map_fs.insert(std::tr1::unordered_map<int, int>::value_type(-1, 0));
 	process_ids(id_fs, offset_fs, offset_nf, hand_ranks,
-		add_card_to_id_flush_suits, eval_flush_suits, 0, 0, map_fs);
+		add_card_to_id_flush_suits, eval_flush_suits, 0, 0, map_fs, n_threads);
 
 	std::cout << "\n\nEvaluating flush ranks (suit #4 + dummies)...\n";
 	std::tr1::unordered_map<int, int> map_fr4;
 	map_fr4.insert(std::tr1::unordered_map<int, int>::value_type(-1, offset_fr4));
 	process_ids(id_fr4, offset_fr4, 0, hand_ranks,
-		add_card_to_id_flush_ranks_4, eval_flush_ranks, 3, 1, map_fr4);
+		add_card_to_id_flush_ranks_4, eval_flush_ranks, 3, 1, map_fr4, n_threads);
 
 	std::cout << "\n\nEvaluating non-flush hands...\n";
 	std::tr1::unordered_map<int, int> map_nf;
 	map_nf.insert(std::tr1::unordered_map<int, int>::value_type(-1, offset_nf));
 	process_ids(id_nf, offset_nf, 0, hand_ranks,
-		add_card_to_id_no_flush, eval_no_flush, 0, 0, map_nf);
+		add_card_to_id_no_flush, eval_no_flush, 0, 0, map_nf, n_threads);
 
 	// hand_ranks.resize(max_rank);
 
@@ -623,126 +776,478 @@ int generate_handranks(std::vector<int> &hand_ranks)
 	return max_rank;
 }
 
-int test_all_handranks(const char *filename, const char *filename7)
+// 9-card score of sorted cards c[0..8] (1-52, leading zeros skip board cards)
+int score_new_9(const int *HR_new, const int *c)
 {
-	int *HR_new = smart_load(filename);
-	int *HR_old = smart_load(filename7);
+	int fs = 106, score = HR_new[0] + 53, i;
+	for (i = 0; i < 9; i++)
+	{
+		fs = HR_new[fs + c[i]];
+		score = HR_new[score + c[i]];
+	}
+	if (fs != 0)
+	{
+		const int *HR_flush = HR_new + (4 - fs);
+		int score_flush = HR_new[1] + 56;
+		for (i = 0; i < 9; i++)
+			score_flush = HR_flush[score_flush + c[i]];
+		score = MAX(score, score_flush);
+	}
+	return score;
+}
 
-	int c[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-	int64_t n = 0;
-	int64_t N[3] = {133784560LL, 752538150LL,
-		3679075400LL}; // C(52, 7), C(52, 8), C(52, 9)
-	int min0[3] = {0,  0,  1};
-	int max0[3] = {0,  0,  52};
-	int min1[3] = {0,  1,  1};
-	int max1[3] = {0,  52, 52};
-	int n_board_perms[3] = {1, 4, 10};
-	int board_paths[10];
+// the same score as the best 2 + 3 combination looked up in the 7-card table,
+// k = number of board cards minus 3
+int score_old_9(const int *HR_old, const int *c, int k)
+{
+	int score = 0;
+	static const int n_board_perms[3] = {1, 4, 10};
+	for (int nb = 0; nb < n_board_perms[k]; nb++)
+	{
+		int board_path = HR_old[HR_old[HR_old[53 + 
+			c[(2 - k) + board_perms[nb][0]]] + 
+			c[(2 - k) + board_perms[nb][1]]] +
+			c[(2 - k) + board_perms[nb][2]]];
+		for (int np = 0; np < n_pocket_perms; np++)
+			score = MAX(score, HR_old[HR_old[HR_old[board_path + 
+				c[5 + pocket_perms[np][0]]] + c[5 + pocket_perms[np][1]]]]);
+	}
+	return score;
+}
+
+// C(n, k) for small arguments
+int64_t n_choose_k(int n, int k)
+{
+	if (k < 0 || k > n)
+		return 0;
+	int64_t r = 1;
+	for (int i = 1; i <= k; i++)
+		r = r * (n - k + i) / i;
+	return r;
+}
 
-	// int no_flush_offset = HR_new[0],
-	// 	flush_offset = HR_new[1];
+// a unit of the exhaustive check: all combinations sharing the first three slots
+struct verify_unit {
+	int k, c0, c1, c2;
+	int64_t size;
+};
 
-	for (int k = 0; k < 3; k++)
-	{
-		std::cout << "\nChecking all " << (7 + k) << "-card sorted combinations...\n";
-		n = 0;
+struct verify_ctx {
+	const int *HR_new, *HR_old;
+	const std::vector<verify_unit> *units;
+	volatile long next_unit;
+	volatile long long n_done;
+	long long n_total;
+	volatile int failed;
+	int fail_cards[9], fail_old, fail_new;
+	int64_t n_samples;
+	uint64_t seed;
+	double t_start;
+};
+
+struct verify_job {
+	verify_ctx *ctx;
+	int index, n_jobs;
+};
+
+double wall_time()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+void report_failure(verify_ctx *ctx, const int *c, int score_old, int score_new)
+{
+	if (!__sync_bool_compare_and_swap(&ctx->failed, 0, 1))
+		return;
+	memcpy(ctx->fail_cards, c, 9 * sizeof(int));
+	ctx->fail_old = score_old;
+	ctx->fail_new = score_new;
+}
+
+void report_progress(verify_ctx *ctx, long long done)
+{
+	double elapsed = wall_time() - ctx->t_start;
+	std::cout << "\r\t" << done << " / " << ctx->n_total << " combinations verified (" <<
+		(long long) (done / MAX(elapsed, 1e-3)) << " / s)" << std::flush;
+}
+
+// checks whole units pulled from the shared queue, the walks of the first
+// five cards are shared by all combinations below them
+int64_t verify_unit_run(verify_ctx *ctx, const verify_unit &u)
+{
+	const int *HR_new = ctx->HR_new, *HR_old = ctx->HR_old;
+	int c[9] = {u.c0, u.c1, u.c2, 0, 0, 0, 0, 0, 0}, k = u.k;
+	int board_paths[10];
+	const int n_board_perms[3] = {1, 4, 10};
+	int64_t n = 0;
 
-		for (c[0] = min0[k]; c[0] <= max0[k]; c[0]++)
+	int fs2 = HR_new[HR_new[HR_new[106 + c[0]] + c[1]] + c[2]];
+	int snf2 = HR_new[HR_new[HR_new[HR_new[0] + 53 + c[0]] + c[1]] + c[2]];
+	for (c[3] = c[2] + 1; c[3] <= 52; c[3]++)
+	{
+		int fs3 = HR_new[fs2 + c[3]];
+		int snf3 = HR_new[snf2 + c[3]];
+		for (c[4] = c[3] + 1; c[4] <= 52; c[4]++)
 		{
-			int fs0 = HR_new[106 + c[0]]; // flush suit
-			int snf0 = HR_new[HR_new[0] + 53 + c[0]]; // score no flush
-			for (c[1] = (min1[k] == 0) ? 0 : (c[0] + 1); c[1] <= max1[k]; c[1]++)
+			int fs4 = HR_new[fs3 + c[4]];
+			int snf4 = HR_new[snf3 + c[4]];
+
+			for (int nb = 0; nb < n_board_perms[k]; nb++)
+				board_paths[nb] = HR_old[HR_old[HR_old[53 + 
+					c[(2 - k) + board_perms[nb][0]]] + 
+					c[(2 - k) + board_perms[nb][1]]] +
+					c[(2 - k) + board_perms[nb][2]]];
+
+			for (c[5] = c[4] + 1; c[5] <= 52; c[5]++)
 			{
-				int fs1 = HR_new[fs0 + c[1]];
-				int snf1 = HR_new[snf0 + c[1]];
-				for (c[2] = c[1] + 1; c[2] <= 52; c[2]++)
+				int fs5 = HR_new[fs4 + c[5]];
+				int snf5 = HR_new[snf4 + c[5]];
+				for (c[6] = c[5] + 1; c[6] <= 52; c[6]++)
 				{
-					int fs2 = HR_new[fs1 + c[2]];
-					int snf2 = HR_new[snf1 + c[2]];
-					for (c[3] = c[2] + 1; c[3] <= 52; c[3]++)
+					int fs6 = HR_new[fs5 + c[6]];
+					int snf6 = HR_new[snf5 + c[6]];
+					for (c[7] = c[6] + 1; c[7] <= 52; c[7]++)
 					{
-						int fs3 = HR_new[fs2 + c[3]];
-						int snf3 = HR_new[snf2 + c[3]];
-						for (c[4] = c[3] + 1; c[4] <= 52; c[4]++)
+						int fs7 = HR_new[fs6 + c[7]];
+						int snf7 = HR_new[snf6 + c[7]];
+						for (c[8] = c[7] + 1; c[8] <= 52; c[8]++)
 						{
-							int fs4 = HR_new[fs3 + c[4]];
-							int snf4 = HR_new[snf3 + c[4]];
+							int fs = HR_new[fs7 + c[8]],
+								score_new = HR_new[snf7 + c[8]];
+							if (fs != 0)
+							{
+								const int *HR_flush = HR_new + (4 - fs);
+								int score_flush = HR_new[1] + 56;
+								for (int i = 0; i < 9; i++)
+									score_flush = HR_flush[score_flush + c[i]];
+								score_new = MAX(score_new, score_flush);
+							}
 
-							for (int nb = 0; nb < n_board_perms[k]; nb++)
-								board_paths[nb] = HR_old[HR_old[HR_old[53 + 
-									c[(2 - k) + board_perms[nb][0]]] + 
-									c[(2 - k) + board_perms[nb][1]]] +
-									c[(2 - k) + board_perms[nb][2]]];
+							int score_old = 0;
+							for (int np = 0; np < n_pocket_perms; np++)
+								for (int nb = 0; nb < n_board_perms[k]; nb++)
+									score_old = MAX(score_old, 
+										(HR_old[HR_old[HR_old[board_paths[nb] + 
+										c[5 + pocket_perms[np][0]]] + 
+										c[5 + pocket_perms[np][1]]]]));
 
-							for (c[5] = c[4] + 1; c[5] <= 52; c[5]++)
+							n++;
+							if (score_new != score_old)
 							{
-								int fs5 = HR_new[fs4 + c[5]];
-								int snf5 = HR_new[snf4 + c[5]];
-								for (c[6] = c[5] + 1; c[6] <= 52; c[6]++)
-								{
-									int fs6 = HR_new[fs5 + c[6]];
-									int snf6 = HR_new[snf5 + c[6]];
-									for (c[7] = c[6] + 1; c[7] <= 52; c[7]++)
-									{
-										int fs7 = HR_new[fs6 + c[7]];
-										int snf7 = HR_new[snf6 + c[7]];
-										for (c[8] = c[7] + 1; c[8] <= 52; c[8]++)
-										{
-											int fs = HR_new[fs7 + c[8]],
-												score_new = HR_new[snf7 + c[8]];
-											if (fs != 0)
-											{
-												int *HR_flush = HR_new + (4 - fs);
-												int score_flush = HR_new[1] + 56;
-												for (int i = 0; i < 9; i++)
-													score_flush = HR_flush[score_flush + c[i]];
-												score_new = MAX(score_new, score_flush);
-											}
-
-											int score_old = 0;
-											for (int np = 0; np < n_pocket_perms; np++)
-												for (int nb = 0; nb < n_board_perms[k]; nb++)
-													score_old = MAX(score_old, 
-														(HR_old[HR_old[HR_old[board_paths[nb] + 
-														c[5 + pocket_perms[np][0]]] + 
-														c[5 + pocket_perms[np][1]]]]));
-
-											n++;
-											if (score_new != score_old)
-											{
-												std::cout << "\n" << "(" << c[0];
-												for (int i = 1; i < 9; i++)
-													std::cout << ", " << c[i];
-												std::cout << "): old = " << score_old <<
-													", new = " << score_new << "\n";
-												goto fail;
-											}
-											else if ((n % 1000LL) == 0)
-											{
-												std::cout << "\r\t" << n << " / " << N[k] << 
-													" combinations verified";
-											}
-										}
-									}
-								}
+								report_failure(ctx, c, score_old, score_new);
+								return n;
 							}
 						}
 					}
 				}
 			}
 		}
-		std::cout << "\r\t" << n << " / " << N[k] << " combinations verified";
 	}
+	return n;
+}
+
+void *verify_job_run(void *arg)
+{
+	verify_job *job = (verify_job *) arg;
+	verify_ctx *ctx = job->ctx;
+	if (ctx->n_samples)
+	{
+		// random 7-, 8- and 9-card hands in turn, unlike the exhaustive check 
+		// the board and pocket cards aren't sorted relative to each other
+		rng_t rng;
+		int sample[52], c[9];
+		int64_t i, n = ctx->n_samples * (job->index + 1) / job->n_jobs - 
+			ctx->n_samples * job->index / job->n_jobs;
+		rng_seed(&rng, ctx->seed, (uint64_t) job->index);
+		for (i = 0; i < n && !ctx->failed; i++)
+		{
+			int k = (int) (i % 3), n_cards = 7 + k;
+			random_sample_52_ross(52, n_cards, sample, &rng);
+			memset(c, 0, sizeof(c));
+			for (int j = 0; j < n_cards; j++)
+				c[9 - n_cards + j] = sample[j] + 1;
+			int score_old = score_old_9(ctx->HR_old, c, k), 
+				score_new = score_new_9(ctx->HR_new, c);
+			if (score_new != score_old)
+				report_failure(ctx, c, score_old, score_new);
+			if ((i + 1) % PROGRESS_STEP == 0)
+			{
+				long long done = __sync_add_and_fetch(&ctx->n_done, (long long) PROGRESS_STEP);
+				if (job->index == 0)
+					report_progress(ctx, done);
+			}
+		}
+		__sync_add_and_fetch(&ctx->n_done, (long long) (i % PROGRESS_STEP));
+		return NULL;
+	}
+	long u, n_units = (long) ctx->units->size();
+	while (!ctx->failed && (u = __sync_fetch_and_add(&ctx->next_unit, 1L)) < n_units)
+	{
+		long long done = __sync_add_and_fetch(&ctx->n_done, 
+			(long long) verify_unit_run(ctx, (*ctx->units)[u]));
+		if (job->index == 0)
+			report_progress(ctx, done);
+	}
+	return NULL;
+}
+
+/*
+	Verifies the 9-card table against the 7-card one, either exhaustively
+	(all ~4.5 billion sorted 7-, 8- and 9-card combinations) or on n_samples
+	random hands. The exhaustive check is split into units by the first 
+	three slots; shard / n_shards selects every n_shards-th unit, so that 
+	the shards of several machines together cover all combinations.
+*/
+int test_all_handranks(const char *filename, const char *filename7, int n_threads,
+	long long n_samples, int shard, int n_shards)
+{
+	if (n_threads <= 0)
+		n_threads = get_num_cpus();
+	if (n_shards < 1 || shard < 0 || shard >= n_shards)
+	{
+		std::cout << "\ntest_all_handranks(): invalid shard " << shard << " / " << n_shards << "\n";
+		return 1;
+	}
+	int *HR_new = smart_load(filename);
+	int *HR_old = smart_load(filename7);
+	if (!HR_new || !HR_old)
+	{
+		free(HR_new); free(HR_old);
+		return 1;
+	}
+
+	const int min0[3] = {0,  0,  1};
+	const int max0[3] = {0,  0,  52};
+	const int min1[3] = {0,  1,  1};
+	const int max1[3] = {0,  52, 52};
+	std::vector<verify_unit> units;
+	long long n_total = 0;
+	if (!n_samples)
+	{
+		long index = 0;
+		for (int k = 0; k < 3; k++)
+			for (int c0 = min0[k]; c0 <= max0[k]; c0++)
+				for (int c1 = (min1[k] == 0) ? 0 : (c0 + 1); c1 <= max1[k]; c1++)
+					for (int c2 = c1 + 1; c2 <= 52; c2++, index++)
+					{
+						verify_unit u = {k, c0, c1, c2, n_choose_k(52 - c2, 6)};
+						if (u.size && (index % n_shards) == shard)
+						{
+							units.push_back(u);
+							n_total += u.size;
+						}
+					}
+		std::cout << "\nChecking " << n_total << " sorted 7-, 8- and 9-card combinations" <<
+			" (shard " << shard << " / " << n_shards << ") on " << n_threads << " thread(s)...\n";
+	}
+	else
+	{
+		n_total = n_samples;
+		std::cout << "\nChecking " << n_total << " random 7-, 8- and 9-card combinations" <<
+			" on " << n_threads << " thread(s)...\n";
+	}
+
+	verify_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.HR_new = HR_new;
+	ctx.HR_old = HR_old;
+	ctx.units = &units;
+	ctx.n_total = n_total;
+	ctx.n_samples = n_samples;
+	ctx.seed = random_stream_seed();
+	ctx.t_start = wall_time();
+	std::vector<verify_job> jobs(n_threads);
+	for (int i = 0; i < n_threads; i++)
+	{
+		jobs[i].ctx = &ctx;
+		jobs[i].index = i;
+		jobs[i].n_jobs = n_threads;
+	}
+	run_threads(n_threads, verify_job_run, &jobs[0], sizeof(verify_job));
+	report_progress(&ctx, ctx.n_done);
+	std::cout << " in " << std::setprecision(1) << std::fixed << 
+		(wall_time() - ctx.t_start) << " s";
+	free(HR_new); free(HR_old); HR_new = 0; HR_old = 0;
 
+	if (ctx.failed)
+	{
+		std::cout << "\n" << "(" << ctx.fail_cards[0];
+		for (int i = 1; i < 9; i++)
+			std::cout << ", " << ctx.fail_cards[i];
+		std::cout << "): old = " << ctx.fail_old << ", new = " << ctx.fail_new << "\n";
+		std::cout << "\nEpic fail.\n";
+		return 1;
+	}
 	std::cout << "\n\nAll combinations verified successfully.\n\n";
 	std::cout << "\nGreat success.\n";
-	free(HR_new); free(HR_old); HR_new = 0; HR_old = 0;
 	return 0;
+}
 
-fail: 
-	std::cout << "\nEpic fail.\n";
-	free(HR_new); free(HR_old); HR_new = 0; HR_old = 0;
-	return 1;
+/*
+
+	COMPACT TABLE
+
+	The transitions of a non-flush block only depend on the rank of the
+	card, those of a flush suit block on its suit and those of a flush
+	rank block on the rank if the card is of the flush suit. So the compact
+	table indexes blocks by card class (hr9c_*_class) instead of by card,
+	with 14, 5 and 15 entries per block. This leaves no back-pointers for
+	impossible cards and no dummy slots for the flush rank shifting. Each
+	section is stored level by level: 8 levels of int nodes, where the
+	entries are pre-scaled offsets of the next level's blocks, and then
+	the 16-bit leaf ranks (or flush suits). Block 0 of every level is a
+	sink for invalid paths, and its leaves are 0.
+
+	ints:	[0] HR9C_MAGIC
+			[1 + 3 * s], [2 + 3 * s], [3 + 3 * s]: node offset, leaf 
+				offset and root of section s (HR9C_FLUSH_SUITS, ...)
+			[HR9C_HEADER...] the sections' nodes and leaves
+
+*/
+
+struct compact_section {
+	int root, offset, block_size, n_blocks;
+	int width, cards[15];	// a card of every class, looked up in the original blocks
+};
+
+// converts a section breadth-first, blocks are numbered in the order they
+// are reached, so the blocks of one level are adjacent
+int compact_section_bfs(const int *hr, const compact_section &sec,
+	std::vector<int> &nodes, std::vector<uint16_t> &leaves)
+{
+	int w = sec.width;
+	std::vector<int> index(sec.n_blocks + 1, 0), level(1, sec.root), next;
+	nodes.assign(2 * w, 0); // the sink and the root
+	leaves.assign(w, 0); // the sink
+	index[(sec.root - sec.offset) / sec.block_size - 1] = w;
+	for (int depth = 0; depth < HR9C_DEPTH - 1; depth++)
+	{
+		next.clear();
+		for (size_t i = 0; i < level.size(); i++)
+		{
+			int node = index[(level[i] - sec.offset) / sec.block_size - 1];
+			for (int c = 0; c < w; c++)
+			{
+				int child = hr[level[i] + sec.cards[c]];
+				if (child == sec.offset)
+					continue; // impossible card, leave it pointing to the sink
+				int k = (child - sec.offset) / sec.block_size - 1;
+				if (k < 0 || k >= sec.n_blocks || (child - sec.offset) % sec.block_size)
+				{
+					std::cout << "\n\tBlock " << level[i] << " points outside of its section.\n";
+					return 1;
+				}
+				if (!index[k])
+				{
+					if (depth < HR9C_DEPTH - 2)
+					{
+						index[k] = (int) nodes.size();
+						nodes.resize(nodes.size() + w, 0);
+					}
+					else
+					{
+						index[k] = (int) leaves.size();
+						leaves.resize(leaves.size() + w, 0);
+					}
+					next.push_back(child);
+				}
+				nodes[node + c] = index[k];
+			}
+		}
+		level.swap(next);
+	}
+	for (size_t i = 0; i < level.size(); i++)
+	{
+		int leaf = index[(level[i] - sec.offset) / sec.block_size - 1];
+		for (int c = 0; c < w; c++)
+		{
+			// invalid paths end in offsets which aren't ranks
+			int value = hr[level[i] + sec.cards[c]];
+			leaves[leaf + c] = (value >= 0 && value <= 0xFFFF) ? (uint16_t) value : 0;
+		}
+	}
+	return 0;
+}
+
+int compact_handranks_9(const char *filename, const char *filename_out, long long n_samples)
+{
+	table_info info;
+	if (read_table_info(filename, &info))
+		return 1;
+	if (info.kind == TABLE_KIND_9_COMPACT)
+	{
+		std::cout << "\n\"" << filename << "\" is compact already.\n";
+		return 1;
+	}
+	int *hr = smart_load(filename);
+	if (!hr)
+		return 1;
+
+	int offset_fs = 53, offset_fr4 = hr[1], offset_nf = hr[0], i, s;
+	compact_section sections[3];
+	compact_section fs = {offset_fs + 53, offset_fs, 53, (offset_fr4 - offset_fs - 53) / 53, 5, {0}};
+	compact_section fr = {offset_fr4 + 56, offset_fr4, 56, (offset_nf - offset_fr4 - 56) / 56, 15, {0}};
+	compact_section nf = {offset_nf + 53, offset_nf, 53, (int) ((info.length - offset_nf - 53) / 53), 14, {0}};
+	for (i = 1; i <= 4; i++)
+		fs.cards[i] = i;
+	fr.cards[1] = 1; // the blocks are laid out for suit 4, so this is any other card
+	for (i = 2; i <= 14; i++)
+		fr.cards[i] = 4 * (i - 2) + 4;
+	for (i = 1; i <= 13; i++)
+		nf.cards[i] = 4 * (i - 1) + 1;
+	sections[HR9C_FLUSH_SUITS] = fs;
+	sections[HR9C_FLUSH_RANKS] = fr;
+	sections[HR9C_NO_FLUSH] = nf;
+
+	std::vector<int> compact(HR9C_HEADER, 0), nodes;
+	std::vector<uint16_t> leaves;
+	compact[0] = HR9C_MAGIC;
+	for (s = 0; s < 3; s++)
+	{
+		std::cout << "\nConverting section " << s << " (" << sections[s].n_blocks << " blocks)...";
+		if (compact_section_bfs(hr, sections[s], nodes, leaves))
+		{
+			free(hr);
+			return 1;
+		}
+		compact[1 + 3 * s] = (int) compact.size();
+		compact.insert(compact.end(), nodes.begin(), nodes.end());
+		compact[2 + 3 * s] = (int) compact.size();
+		leaves.resize(leaves.size() + (leaves.size() & 1), 0);
+		compact.resize(compact.size() + leaves.size() / 2);
+		memcpy(&compact[compact[2 + 3 * s]], &leaves[0], leaves.size() * sizeof(uint16_t));
+		compact[3 + 3 * s] = sections[s].width;
+		std::cout << " " << nodes.size() << " nodes, " << leaves.size() << " leaves.";
+	}
+	std::cout << "\nCompact table: " << compact.size() << " entries instead of " << info.length << ".";
+
+	// the conversion is exact, check it on random hands anyway
+	hr9c_t t;
+	hr9c_layout(&compact[0], &t);
+	rng_t rng;
+	rng_seed(&rng, random_stream_seed(), 0);
+	for (long long n = 0; n < n_samples; n++)
+	{
+		int sample[52], c[9], n_cards = 7 + (int) (n % 3);
+		random_sample_52_ross(52, n_cards, sample, &rng);
+		memset(c, 0, sizeof(c));
+		for (i = 0; i < n_cards; i++)
+			c[9 - n_cards + i] = sample[i] + 1;
+		if (eval_hr9c(&t, c) != score_new_9(hr, c))
+		{
+			std::cout << "\nMismatch on (" << c[0];
+			for (i = 1; i < 9; i++)
+				std::cout << ", " << c[i];
+			std::cout << "): " << score_new_9(hr, c) << " != " << eval_hr9c(&t, c) << "\n";
+			free(hr);
+			return 1;
+		}
+	}
+	free(hr);
+	const uint64_t offsets[3] = {(uint64_t) compact[1], (uint64_t) compact[4], (uint64_t) compact[7]};
+	return smart_save(&compact[0], compact.size(), filename_out, TABLE_KIND_9_COMPACT, offsets);
 }
 
 struct commas_locale : std::numpunct<char> 
@@ -751,13 +1256,136 @@ struct commas_locale : std::numpunct<char>
 	std::string do_grouping() const { return "\3"; }
 };
 
-int raygen9(const char *filename, const char *filename7, bool test=true)
+/*
+
+	CACHE-AWARE ORDER
+
+	process_ids() lays the blocks out in ID order, so the blocks visited by
+	one walk are scattered all over the table. Reordering renumbers the blocks
+	of every section breadth-first from its root: the upper levels, which every
+	walk goes through, end up packed at the start of the section, and the
+	children of a block are adjacent. Only the block order changes, the 
+	section offsets and roots stay where they are, so the table is walked 
+	exactly as before.
+
+*/
+
+// renumbers the blocks of a section in place, blocks are numbered from 0 at the root
+int reorder_section_bfs(int *hr, const compact_section &sec)
+{
+	int bs = sec.block_size, n = sec.n_blocks, i, c, k;
+	std::vector<int> index(n, -1), order(1, 0);
+	std::vector<char> depth(n, 0);
+	index[0] = 0;
+	for (size_t j = 0; j < order.size(); j++)
+	{
+		const int *block = hr + sec.root + bs * order[j];
+		if (depth[order[j]] == HR9C_DEPTH - 1)
+			continue; // the last level holds ranks
+		for (c = 0; c < bs; c++)
+		{
+			if (block[c] == sec.offset)
+				continue; // impossible card
+			k = (block[c] - sec.root) / bs;
+			if (block[c] < sec.root || k >= n || (block[c] - sec.root) % bs)
+			{
+				std::cout << "\n\tBlock " << sec.root + bs * order[j] << " points outside of its section.\n";
+				return 1;
+			}
+			if (index[k] == -1)
+			{
+				index[k] = (int) order.size();
+				depth[k] = depth[order[j]] + 1;
+				order.push_back(k);
+			}
+		}
+	}
+	for (k = 0; k < n; k++)
+		if (index[k] == -1)
+		{
+			// unreachable, kept at the end
+			index[k] = (int) order.size();
+			depth[k] = HR9C_DEPTH - 1;
+			order.push_back(k);
+		}
+
+	// repoint the transitions, then move the blocks along the permutation's cycles
+	for (k = 0; k < n; k++)
+	{
+		int *block = hr + sec.root + bs * k;
+		if (depth[k] < HR9C_DEPTH - 1)
+			for (c = 0; c < bs; c++)
+				if (block[c] != sec.offset)
+					block[c] = sec.root + bs * index[(block[c] - sec.root) / bs];
+	}
+	std::vector<int> tmp(bs);
+	std::vector<char> done(n, 0);
+	for (k = 0; k < n; k++)
+	{
+		if (done[k])
+			continue;
+		memcpy(&tmp[0], hr + sec.root + bs * k, bs * sizeof(int));
+		for (i = k; !done[i]; i = index[i])
+		{
+			done[i] = 1;
+			std::swap_ranges(tmp.begin(), tmp.end(), hr + sec.root + bs * index[i]);
+		}
+	}
+	return 0;
+}
+
+int reorder_handranks(int *hr, size_t size)
+{
+	int offset_fs = 53, offset_fr4 = hr[1], offset_nf = hr[0];
+	compact_section sections[3] = {
+		{offset_fs + 53, offset_fs, 53, (offset_fr4 - offset_fs - 53) / 53, 0, {0}},
+		{offset_fr4 + 56, offset_fr4, 56, (offset_nf - offset_fr4 - 56) / 56, 0, {0}},
+		{offset_nf + 53, offset_nf, 53, (int) ((size - offset_nf - 53) / 53), 0, {0}}
+	};
+	for (int s = 0; s < 3; s++)
+	{
+		std::cout << "\nReordering section " << s << " (" << sections[s].n_blocks << " blocks)...";
+		if (reorder_section_bfs(hr, sections[s]))
+			return 1;
+	}
+	std::cout << "\n";
+	return 0;
+}
+
+int reorder_handranks_9(const char *filename, const char *filename_out)
+{
+	table_info info;
+	if (read_table_info(filename, &info))
+		return 1;
+	if (info.kind == TABLE_KIND_9_COMPACT)
+	{
+		std::cout << "\n\"" << filename << "\" is compact, its blocks are in order already.\n";
+		return 1;
+	}
+	int *hr = smart_load(filename);
+	if (!hr)
+		return 1;
+	int result = reorder_handranks(hr, (size_t) info.length);
+	if (!result)
+	{
+		const uint64_t sections[3] = {53, (uint64_t) hr[1], (uint64_t) hr[0]};
+		result = smart_save(hr, (size_t) info.length, filename_out, TABLE_KIND_9, sections);
+	}
+	free(hr);
+	return result;
+}
+
+int raygen9(const char *filename, const char *filename7, bool test, int n_threads, bool reorder)
 {
 	std::vector<int> hand_ranks;
 	std::cout.imbue(std::locale(std::locale(), new commas_locale));
-	generate_handranks(hand_ranks);
-	smart_save(&hand_ranks[0], (int) hand_ranks.size(), filename);
+	generate_handranks(hand_ranks, n_threads);
+	if (reorder && reorder_handranks(&hand_ranks[0], hand_ranks.size()))
+		return 1;
+	const uint64_t sections[3] = {53, (uint64_t) hand_ranks[1], (uint64_t) hand_ranks[0]};
+	if (smart_save(&hand_ranks[0], hand_ranks.size(), filename, TABLE_KIND_9, sections))
+		return 1;
 	if (test && filename7)
-		return test_all_handranks(filename, filename7);
+		return test_all_handranks(filename, filename7, n_threads, 0, 0, 1);
 	return 0;
 }
@@ -1 +1,12 @@
-int raygen9(const char *filename, const char *filename7, bool test=true);
\ No newline at end of file
+#include <stdint.h>
+#include <vector>
+
+int raygen9(const char *filename, const char *filename7, bool test=true, int n_threads=0,
+	bool reorder=false);
+int test_all_handranks(const char *filename, const char *filename7, int n_threads=0,
+	long long n_samples=0, int shard=0, int n_shards=1);
+int compact_handranks_9(const char *filename, const char *filename_out, long long n_samples=1000000);
+int reorder_handranks_9(const char *filename, const char *filename_out);
+
+void generate_ids(size_t size, std::vector<int64_t> &id_list,
+	int64_t (*add_card_to_id) (int64_t, int), int n_threads, int max_cards=8, int n_skip=2);
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+#include "raysimd.h"
+
+/*
+	One step of n independent table walks: state[i] = hr[state[i] + cards[i]].
+
+	Walking many hands level by level turns every step into a gather, which
+	AVX2 and AVX-512 do 8 and 16 lanes at a time. The kernels are compiled
+	with target attributes, so the rest of the module doesn't need -mavx2, 
+	and the best one the CPU supports is picked at runtime. Table indices 
+	are below 2^31, so 32-bit gather offsets are enough.
+*/
+
+static void gather_step_scalar(const int *hr, int *state, const int *cards, int n)
+{
+	for (int i = 0; i < n; i++)
+		state[i] = hr[state[i] + cards[i]];
+}
+
+#ifdef SIMD_X86
+
+__attribute__((target("avx2")))
+static void gather_step_avx2(const int *hr, int *state, const int *cards, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i index = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (state + i)),
+			_mm256_loadu_si256((const __m256i *) (cards + i)));
+		_mm256_storeu_si256((__m256i *) (state + i), _mm256_i32gather_epi32(hr, index, 4));
+	}
+	for (; i < n; i++)
+		state[i] = hr[state[i] + cards[i]];
+}
+
+__attribute__((target("avx512f")))
+static void gather_step_avx512(const int *hr, int *state, const int *cards, int n)
+{
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m512i index = _mm512_add_epi32(_mm512_loadu_si512((const void *) (state + i)),
+			_mm512_loadu_si512((const void *) (cards + i)));
+		// the masked form with an explicit source, the plain one reads an undefined one
+		_mm512_storeu_si512((void *) (state + i), 
+			_mm512_mask_i32gather_epi32(_mm512_setzero_si512(), (__mmask16) 0xFFFF, index, hr, 4));
+	}
+	for (; i < n; i++)
+		state[i] = hr[state[i] + cards[i]];
+}
+
+#endif
+
+typedef void (*gather_step_fn)(const int *, int *, const int *, int);
+
+static int active_level = SIMD_SCALAR;
+static gather_step_fn active_step = gather_step_scalar;
+
+// the best level this CPU (and compiler) supports
+int simd_supported()
+{
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+#endif
+	return SIMD_SCALAR;
+}
+
+// caps the level at what is supported, returns the level in use;
+// not meant to be called while other threads are evaluating
+int set_simd_level(int level)
+{
+	level = (level < 0 || level > simd_supported()) ? simd_supported() : level;
+	active_step = gather_step_scalar;
+#ifdef SIMD_X86
+	if (level == SIMD_AVX2)
+		active_step = gather_step_avx2;
+	else if (level == SIMD_AVX512)
+		active_step = gather_step_avx512;
+#endif
+	return active_level = level;
+}
+
+int simd_level()
+{
+	return active_level;
+}
+
+// scalar until set_simd_level() is called at module init
+void gather_step(const int *hr, int *state, const int *cards, int n)
+{
+	active_step(hr, state, cards, n);
+}
@@ -0,0 +1,10 @@
+#define SIMD_SCALAR         0
+#define SIMD_AVX2           1
+#define SIMD_AVX512         2
+
+#define GATHER_CHUNK        256 // hands walked together by the batch evaluators
+
+int simd_supported();
+int simd_level();
+int set_simd_level(int level);
+void gather_step(const int *hr, int *state, const int *cards, int n);
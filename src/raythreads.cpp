@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rayutils.h"
+#include "raythreads.h"
+
+int get_num_cpus()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int) n : 1;
+}
+
+// runs worker() on n_threads threads, i-th thread gets (char *) args + i * arg_size;
+// the calling thread takes the first slice itself, returns when all of them are done
+int run_threads(int n_threads, void *(*worker)(void *), void *args, size_t arg_size)
+{
+	if (n_threads <= 1)
+	{
+		worker(args);
+		return 0;
+	}
+	pthread_t *threads = (pthread_t *) malloc((n_threads - 1) * sizeof(pthread_t));
+	int i, n_started = 0, result = 0;
+	for (i = 1; i < n_threads; i++)
+	{
+		if (pthread_create(&threads[n_started], NULL, worker, (char *) args + i * arg_size))
+		{
+			perror("pthread_create");
+			// run whatever failed to start on the calling thread
+			worker((char *) args + i * arg_size);
+			result = 1;
+		}
+		else
+			n_started++;
+	}
+	worker(args);
+	for (i = 0; i < n_started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	return result;
+}
+
+// A persistent pool of worker threads for batches of many small tasks. Every
+// participant (the pool threads and the calling thread) starts with its own
+// contiguous slice of the task indices, takes tasks from the front of it and, 
+// once it runs dry, steals the back half of the fullest slice left, so a few
+// long tasks don't hold up the short ones queued behind them.
+
+typedef struct {
+	pthread_mutex_t lock;
+	int head, tail; // tasks [head, tail) are left in this slice
+} pool_slice;
+
+typedef struct {
+	void (*task)(void *);
+	char *args;
+	size_t arg_size;
+	int n_workers;
+	pool_slice slices[POOL_MAX_THREADS];
+} pool_batch;
+
+static struct {
+	pthread_mutex_t lock, submit; // submit lets one batch run at a time
+	pthread_cond_t work, done;
+	pthread_t threads[POOL_MAX_THREADS];
+	unsigned started[POOL_MAX_THREADS]; // the generation every thread was started in
+	int n_threads; // pool threads, not counting the caller
+	pool_batch *batch;
+	unsigned generation; // bumped for every batch
+	int n_busy; // pool threads not done with the current batch yet
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, 
+	PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static int pool_next_task(pool_batch *batch, int id)
+{
+	pool_slice *own = batch->slices + id;
+	int i, task = -1;
+	pthread_mutex_lock(&own->lock);
+	if (own->head < own->tail)
+		task = own->head++;
+	pthread_mutex_unlock(&own->lock);
+	while (task < 0)
+	{
+		int victim = -1, most = 0;
+		for (i = 0; i < batch->n_workers; i++)
+		{
+			int left = batch->slices[i].tail - batch->slices[i].head; // a racy peek is fine here
+			if (i != id && left > most)
+			{
+				most = left;
+				victim = i;
+			}
+		}
+		if (victim < 0)
+			return -1;
+		pool_slice *other = batch->slices + victim;
+		int head = 0, tail = 0;
+		pthread_mutex_lock(&other->lock);
+		if (other->head < other->tail)
+		{
+			tail = other->tail;
+			head = other->head + (other->tail - other->head) / 2;
+			other->tail = head;
+		}
+		pthread_mutex_unlock(&other->lock);
+		if (head == tail)
+			continue;
+		pthread_mutex_lock(&own->lock);
+		task = head;
+		own->head = head + 1;
+		own->tail = tail;
+		pthread_mutex_unlock(&own->lock);
+	}
+	return task;
+}
+
+static void pool_work(pool_batch *batch, int id)
+{
+	int task;
+	while ((task = pool_next_task(batch, id)) >= 0)
+		batch->task(batch->args + task * batch->arg_size);
+}
+
+static void *pool_thread(void *arg)
+{
+	int id = (int) (size_t) arg; // 1-based, the caller is 0
+	pthread_mutex_lock(&pool.lock);
+	unsigned seen = pool.started[id];
+	for (;;)
+	{
+		while (pool.generation == seen)
+			pthread_cond_wait(&pool.work, &pool.lock);
+		seen = pool.generation;
+		pool_batch *batch = pool.batch;
+		pthread_mutex_unlock(&pool.lock);
+		if (id < batch->n_workers)
+			pool_work(batch, id);
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.n_busy == 0)
+			pthread_cond_signal(&pool.done);
+	}
+	return NULL;
+}
+
+// a forked child has none of the threads, it starts a pool of its own
+static void pool_after_fork()
+{
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_mutex_init(&pool.submit, NULL);
+	pthread_cond_init(&pool.work, NULL);
+	pthread_cond_init(&pool.done, NULL);
+	pool.n_threads = 0;
+	pool.batch = NULL;
+	pool.n_busy = 0;
+}
+
+// grows the pool to n_threads - 1 threads, called with pool.lock held
+static void pool_grow(int n_threads)
+{
+	static int atfork = 0;
+	if (!atfork)
+		atfork = !pthread_atfork(NULL, NULL, pool_after_fork);
+	while (pool.n_threads < n_threads - 1)
+	{
+		pool.started[pool.n_threads + 1] = pool.generation;
+		if (pthread_create(&pool.threads[pool.n_threads], NULL, pool_thread, 
+			(void *) (size_t) (pool.n_threads + 1)))
+		{
+			perror("pthread_create");
+			break;
+		}
+		pthread_detach(pool.threads[pool.n_threads]);
+		pool.n_threads++;
+	}
+}
+
+int pool_size()
+{
+	pthread_mutex_lock(&pool.lock);
+	int n = pool.n_threads + 1;
+	pthread_mutex_unlock(&pool.lock);
+	return n;
+}
+
+// runs task() on (char *) args + i * arg_size for all i < n_tasks, on up to 
+// n_threads threads including the calling one, returns when all are done;
+// batches from different threads run one after another, tasks mustn't submit
+// batches of their own. Returns the number of threads used.
+int pool_run(int n_threads, int n_tasks, void (*task)(void *), void *args, size_t arg_size)
+{
+	int i;
+	if (n_tasks <= 0)
+		return 0;
+	n_threads = MIN(MIN(n_threads, n_tasks), POOL_MAX_THREADS);
+	if (n_threads <= 1)
+	{
+		for (i = 0; i < n_tasks; i++)
+			task((char *) args + i * arg_size);
+		return 1;
+	}
+	pthread_mutex_lock(&pool.submit);
+	pool_batch *batch = (pool_batch *) malloc(sizeof(pool_batch));
+	batch->task = task;
+	batch->args = (char *) args;
+	batch->arg_size = arg_size;
+	pthread_mutex_lock(&pool.lock);
+	pool_grow(n_threads);
+	batch->n_workers = n_threads = MIN(n_threads, pool.n_threads + 1);
+	for (i = 0; i < n_threads; i++)
+	{
+		pthread_mutex_init(&batch->slices[i].lock, NULL);
+		batch->slices[i].head = (int) ((int64_t) n_tasks * i / n_threads);
+		batch->slices[i].tail = (int) ((int64_t) n_tasks * (i + 1) / n_threads);
+	}
+	pool.batch = batch;
+	pool.generation++;
+	pool.n_busy = pool.n_threads;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+	pool_work(batch, 0);
+	pthread_mutex_lock(&pool.lock);
+	while (pool.n_busy > 0)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pool.batch = NULL;
+	pthread_mutex_unlock(&pool.lock);
+	for (i = 0; i < n_threads; i++)
+		pthread_mutex_destroy(&batch->slices[i].lock);
+	free(batch);
+	pthread_mutex_unlock(&pool.submit);
+	return n_threads;
+}
@@ -0,0 +1,9 @@
+#include <stddef.h>
+
+int get_num_cpus();
+int run_threads(int n_threads, void *(*worker)(void *), void *args, size_t arg_size);
+
+#define POOL_MAX_THREADS	256
+
+int pool_run(int n_threads, int n_tasks, void (*task)(void *), void *args, size_t arg_size);
+int pool_size();
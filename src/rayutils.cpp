@@ -8,25 +8,37 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
 
 #include "rayutils.h"
 #include "arrays.h"
 
-// this function is required to read binary files larger than 2GB
+// this function is required to read binary files larger than 2GB,
+// returns the number of blocks read, stops at the first short read
 int load_file(char* dest, size_t size, size_t nitems, FILE* stream)
 {
     int ret = 0;
     size_t bytes_to_load = nitems * size;
     size_t block_size = 0;
-    int offset = 0;
+    size_t offset = 0;
     
     while (bytes_to_load > 0)
     {
         block_size = bytes_to_load > READ_BLOCK_SIZE ? READ_BLOCK_SIZE : bytes_to_load;
-        ret += fread(dest + offset, block_size, 1, stream);
+        if (fread(dest + offset, block_size, 1, stream) != 1)
+            break;
+        ret++;
         offset += block_size;
         bytes_to_load -= block_size;
     }
@@ -34,6 +46,230 @@ int load_file(char* dest, size_t size, size_t nitems, FILE* stream)
     return ret;
 }
 
+// Fletcher-style sums over the 32-bit entries (mod 2^64), cheap enough to be
+// computed while the table is being read; catches truncation, zeroed or 
+// swapped blocks, unlike a plain sum
+void checksum_init(checksum_t *sum)
+{
+    sum->a = 1;
+    sum->b = 0;
+}
+
+void checksum_update(checksum_t *sum, const int *data, size_t n)
+{
+    uint64_t a = sum->a, b = sum->b;
+    for (size_t i = 0; i < n; i++)
+    {
+        a += (uint32_t) data[i];
+        b += a;
+    }
+    sum->a = a;
+    sum->b = b;
+}
+
+uint64_t checksum_final(const checksum_t *sum)
+{
+    return sum->a ^ ((sum->b << 32) | (sum->b >> 32)) ^ 0x9e3779b97f4a7c15ULL;
+}
+
+uint64_t table_checksum(const int *data, size_t n)
+{
+    checksum_t sum;
+    checksum_init(&sum);
+    checksum_update(&sum, data, n);
+    return checksum_final(&sum);
+}
+
+static const char TABLE_FILE_MAGIC[8] = {'R', 'A', 'Y', '\xff', 'H', 'R', '\r', '\n'};
+
+static uint64_t header_checksum(const table_file_header *header)
+{
+    return table_checksum((const int *) header, offsetof(table_file_header, header_checksum) / sizeof(int));
+}
+
+// parses the first bytes of a file of file_size bytes, 0 if it's a valid header
+static int parse_table_header(const char *buf, size_t n, uint64_t file_size, 
+    table_info *info, const char *filename)
+{
+    memset(info, 0, sizeof(table_info));
+    if (n >= sizeof(table_file_header) && !memcmp(buf, TABLE_FILE_MAGIC, sizeof(TABLE_FILE_MAGIC)))
+    {
+        table_file_header header;
+        memcpy(&header, buf, sizeof(header));
+        if (header.byte_order != 0x01020304 || header.entry_size != sizeof(int))
+        {
+            std::cout << "\n\"" << filename << "\" was written on a different architecture.\n";
+            return 1;
+        }
+        if (header.version > TABLE_FILE_VERSION || header.header_checksum != header_checksum(&header))
+        {
+            std::cout << "\n\"" << filename << "\" has an unsupported or corrupt header.\n";
+            return 1;
+        }
+        info->version = (int) header.version;
+        info->kind = (int) header.kind;
+        info->length = header.length;
+        info->data_offset = header.data_offset;
+        memcpy(info->sections, header.sections, sizeof(info->sections));
+        info->checksum = header.checksum;
+    }
+    else if (n >= sizeof(int) && *(const int *) buf > 0)
+    {
+        info->version = 1;
+        info->length = (uint64_t) *(const int *) buf;
+        info->data_offset = sizeof(int);
+    }
+    else
+    {
+        std::cout << "\n\"" << filename << "\" is not a hand ranks file.\n";
+        return 1;
+    }
+    if (info->data_offset % sizeof(int) || info->length == 0 ||
+        info->data_offset + info->length * sizeof(int) > file_size)
+    {
+        std::cout << "\n\"" << filename << "\" is truncated: " << file_size << " bytes, " <<
+            (info->data_offset + info->length * sizeof(int)) << " expected.\n";
+        return 1;
+    }
+    return 0;
+}
+
+// reads and validates the header, leaves the stream at the first entry
+static int read_table_header(FILE *f, table_info *info, const char *filename)
+{
+    char buf[sizeof(table_file_header)];
+    struct stat st;
+    if (fstat(fileno(f), &st) == -1)
+    {
+        perror("fstat");
+        return 1;
+    }
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    if (parse_table_header(buf, n, (uint64_t) st.st_size, info, filename))
+        return 1;
+    if (fseeko(f, (off_t) info->data_offset, SEEK_SET) == -1)
+    {
+        perror("fseek");
+        return 1;
+    }
+    return 0;
+}
+
+// reads n entries in cache-sized blocks, checksumming each block while it is 
+// still hot; version 1 files have no checksum to compare against
+static int load_entries(int *dest, const table_info *info, FILE *f, const char *filename)
+{
+    const size_t block = 1 << 20;
+    checksum_t sum;
+    checksum_init(&sum);
+    for (uint64_t i = 0; i < info->length; i += block)
+    {
+        size_t n = (size_t) MIN((uint64_t) block, info->length - i);
+        if (load_file((char *) (dest + i), n * sizeof(int), 1, f) != 1)
+        {
+            std::cout << "\n\"" << filename << "\": read error at entry " << i << ".\n";
+            return 1;
+        }
+        checksum_update(&sum, dest + i, n);
+    }
+    if (info->version >= 2 && checksum_final(&sum) != info->checksum)
+    {
+        std::cout << "\n\"" << filename << "\": checksum mismatch, the file is corrupt.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int read_table_info(const char *filename, table_info *info)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+    {
+        perror("fopen");
+        return 1;
+    }
+    int result = read_table_header(f, info, filename);
+    fclose(f);
+    return result;
+}
+
+// streams the whole file through the checksum without keeping it, 0 if valid
+int verify_table_file(const char *filename)
+{
+    const size_t block = 1 << 20;
+    FILE *f = fopen(filename, "rb");
+    table_info info;
+    if (!f)
+    {
+        perror("fopen");
+        return 1;
+    }
+    if (read_table_header(f, &info, filename))
+    {
+        fclose(f);
+        return 1;
+    }
+    int result = 0;
+    int *buf = (int *) malloc(block * sizeof(int));
+    checksum_t sum;
+    checksum_init(&sum);
+    for (uint64_t i = 0; !result && i < info.length; i += block)
+    {
+        size_t n = (size_t) MIN((uint64_t) block, info.length - i);
+        if (load_file((char *) buf, n * sizeof(int), 1, f) != 1)
+            result = 1;
+        else
+            checksum_update(&sum, buf, n);
+    }
+    if (!result && info.version >= 2 && checksum_final(&sum) != info.checksum)
+        result = 1;
+    if (result)
+        std::cout << "\n\"" << filename << "\" is corrupt.\n";
+    free(buf);
+    fclose(f);
+    return result;
+}
+
+// fills in t if hr is a compact 9-card table, returns 0 then
+int hr9c_layout(const int *hr, hr9c_t *t)
+{
+    if (!hr || hr[0] != HR9C_MAGIC)
+        return 1;
+    for (int s = 0; s < 3; s++)
+    {
+        t->nodes[s] = hr + hr[1 + 3 * s];
+        t->leaves[s] = (const uint16_t *) (hr + hr[2 + 3 * s]);
+        t->root[s] = hr[3 + 3 * s];
+    }
+    return 0;
+}
+
+// cards: 9 cards 1-52, board first, missing board cards of 7- and 8-card
+// hands are passed as leading zeros
+int eval_hr9c(const hr9c_t *t, const int *cards)
+{
+    const int *nfs = t->nodes[HR9C_FLUSH_SUITS], *nnf = t->nodes[HR9C_NO_FLUSH];
+    int i, fs = t->root[HR9C_FLUSH_SUITS], score = t->root[HR9C_NO_FLUSH];
+    for (i = 0; i < HR9C_DEPTH - 1; i++)
+    {
+        fs = nfs[fs + hr9c_suit_class[cards[i]]];
+        score = nnf[score + hr9c_rank_class[cards[i]]];
+    }
+    fs = t->leaves[HR9C_FLUSH_SUITS][fs + hr9c_suit_class[cards[i]]];
+    score = t->leaves[HR9C_NO_FLUSH][score + hr9c_rank_class[cards[i]]];
+    if (fs != 0)
+    {
+        const int *nfr = t->nodes[HR9C_FLUSH_RANKS];
+        const unsigned char *flush_class = hr9c_flush_class[fs];
+        int sf = t->root[HR9C_FLUSH_RANKS];
+        for (i = 0; i < HR9C_DEPTH - 1; i++)
+            sf = nfr[sf + flush_class[cards[i]]];
+        sf = t->leaves[HR9C_FLUSH_RANKS][sf + flush_class[cards[i]]];
+        score = MAX(score, sf);
+    }
+    return score;
+}
+
 // binary search in the cactus array
 int cactus_findit(int key)
 {
@@ -111,23 +347,125 @@ unsigned long mix(unsigned long a, unsigned long b, unsigned long c)
     return c;
 }
 
-static int RAND_MAX_DIV_52[53];
+#ifdef RAY_RNG_PCG32
 
-void init_random_int_52()
+// PCG-XSH-RR 32 (O'Neill), s[0] is the state, s[1] is the (odd) stream increment
+static inline uint32_t rng_next32(rng_t *rng)
 {
-    int i;
-    for (i = 1; i <= 52; i++)
-        RAND_MAX_DIV_52[i] = RAND_MAX / (i + 1);
-    srand((unsigned int) mix(clock(), time(NULL), getpid()));
+    uint64_t old = rng->s[0];
+    rng->s[0] = old * 6364136223846793005ULL + rng->s[1];
+    uint32_t xorshifted = (uint32_t) (((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t) (old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+static inline uint64_t rng_next64(rng_t *rng)
+{
+    uint64_t hi = rng_next32(rng);
+    return (hi << 32) | rng_next32(rng);
+}
+
+void rng_seed(rng_t *rng, uint64_t seed, uint64_t stream)
+{
+    rng->s[0] = 0;
+    rng->s[1] = (stream << 1) | 1;
+    rng_next32(rng);
+    rng->s[0] += seed;
+    rng_next32(rng);
+}
+
+#else
+
+// xoshiro256** (Blackman & Vigna), streams are seeded apart by splitmix64
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next64(rng_t *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+static inline uint32_t rng_next32(rng_t *rng)
+{
+    return (uint32_t) (rng_next64(rng) >> 32);
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// O(1) in the stream: its state is splitmix64 over the seed keyed by the 
+// mixed stream number, so distinct streams start from unrelated points
+void rng_seed(rng_t *rng, uint64_t seed, uint64_t stream)
+{
+    uint64_t key = stream;
+    seed ^= splitmix64(&key);
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = splitmix64(&seed);
 }
 
-int random_int_52(int k) 
+#endif
+
+uint64_t rng_next(rng_t *rng)
 {
-    int r;
-    if (k == 0)
-        return 0; // prevent potential segfault
-    do { r = rand() / RAND_MAX_DIV_52[k]; } while (r > k);
-    return r; // 0 to k
+    return rng_next64(rng);
+}
+
+// unbiased draw from [0, n) without division in the common case (Lemire, 2018)
+static inline uint32_t rng_bounded_inline(rng_t *rng, uint32_t n)
+{
+    uint64_t m = (uint64_t) rng_next32(rng) * n;
+    uint32_t l = (uint32_t) m;
+    if (l < n)
+    {
+        uint32_t t = (0U - n) % n;
+        while (l < t)
+        {
+            m = (uint64_t) rng_next32(rng) * n;
+            l = (uint32_t) m;
+        }
+    }
+    return (uint32_t) (m >> 32);
+}
+
+uint32_t rng_bounded(rng_t *rng, uint32_t n)
+{
+    return rng_bounded_inline(rng, n);
+}
+
+// generator used to derive the streams of every Monte Carlo run
+static rng_t global_rng;
+
+void init_random()
+{
+    rng_seed(&global_rng, (uint64_t) mix(clock(), time(NULL), getpid()), 0);
+    srand((unsigned int) rng_next(&global_rng));
+}
+
+void seed_random(uint64_t seed, uint64_t stream)
+{
+    rng_seed(&global_rng, seed, stream);
+    srand((unsigned int) seed);
+}
+
+uint64_t random_stream_seed()
+{
+    return rng_next(&global_rng);
 }
 
 inline void swap(int *x, int *y)
@@ -137,7 +475,7 @@ inline void swap(int *x, int *y)
     *y = z;
 }
 
-void random_sample_52_ross(int n, int k, int *out)
+void random_sample_52_ross(int n, int k, int *out, rng_t *rng)
 {
     // Ross algorithm modified to work in-place (C) Aldanor
     const int DECK_52[52] = {
@@ -148,19 +486,295 @@ void random_sample_52_ross(int n, int k, int *out)
     memcpy(out, DECK_52, sizeof(DECK_52));
     int i;
     for (i = 0; i < k; i++)
-        swap(out + i, out + i + random_int_52(n - 1 - i));
+        swap(out + i, out + i + rng_bounded_inline(rng, n - i));
 }
 
-int *smart_load(const char *filename)
+// the same, but the first card is always out[first]
+void random_sample_52_stratified(int n, int k, int first, int *out, rng_t *rng)
+{
+    random_sample_52_ross(n, 0, out, rng);
+    swap(out, out + first);
+    for (int i = 1; i < k; i++)
+        swap(out + i, out + i + rng_bounded_inline(rng, n - i));
+}
+
+// copies the combos, returns 1 if the range is empty, has a negative weight
+// or nothing but zero weights, or a combo holds the same card twice
+int range_init(range_t *r, int n, int size, const int *cards, const double *weights)
+{
+    int i, j;
+    double total = 0.0;
+    memset(r, 0, sizeof(range_t));
+    if (n <= 0)
+        return 1;
+    for (i = 0; i < n; i++)
+    {
+        if (weights[i] < 0.0)
+            return 1;
+        total += weights[i];
+    }
+    if (total <= 0.0)
+        return 1;
+    r->n = n;
+    r->size = size;
+    r->cards = (int *) malloc(n * size * sizeof(int));
+    r->masks = (uint64_t *) malloc(n * sizeof(uint64_t));
+    r->weights = (double *) malloc(2 * n * sizeof(double));
+    r->cdf = r->weights + n;
+    memcpy(r->cards, cards, n * size * sizeof(int));
+    double cumulative = 0.0;
+    for (i = 0; i < n; i++)
+    {
+        r->masks[i] = 0;
+        for (j = 0; j < size; j++)
+        {
+            int card = cards[i * size + j];
+            if (card == 255)
+                continue;
+            if (r->masks[i] & (1LLU << card))
+            {
+                range_free(r);
+                return 1;
+            }
+            r->masks[i] |= 1LLU << card;
+        }
+        r->weights[i] = weights[i] / total;
+        cumulative += weights[i];
+        r->cdf[i] = cumulative / total;
+    }
+    // rounding must not leave room past the last combo that can be drawn
+    for (i = n - 1; r->weights[i] == 0.0; i--)
+        r->cdf[i] = 1.0;
+    r->cdf[i] = 1.0;
+    return 0;
+}
+
+void range_free(range_t *r)
+{
+    free(r->cards);
+    free(r->masks);
+    free(r->weights);
+    memset(r, 0, sizeof(range_t));
+}
+
+// draws a combo with probability of its weight, never the zero weight ones
+int range_sample(const range_t *r, rng_t *rng)
+{
+    if (r->n == 1)
+        return 0;
+    double u = (double) (rng_next64(rng) >> 11) * (1.0 / 9007199254740992.0);
+    int low = 0, high = r->n - 1;
+    while (low < high)
+    {
+        int mid = (low + high) >> 1;
+        if (r->cdf[mid] > u)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+// the 24 relabellings of the suits, perm[s] is the new suit of suit s, 
+// identity first
+static const int suit_perms[SUIT_PERMUTATIONS][4] = {
+    {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {0, 3, 2, 1},
+    {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 0, 2}, {1, 3, 2, 0},
+    {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 3, 0, 1}, {2, 3, 1, 0},
+    {3, 0, 1, 2}, {3, 0, 2, 1}, {3, 1, 0, 2}, {3, 1, 2, 0}, {3, 2, 0, 1}, {3, 2, 1, 0}
+};
+
+inline int permute_suit(int card, const int *perm)
+{
+    return (card == 255) ? 255 : ((card & ~3) | perm[card & 3]);
+}
+
+// relabels the suits of the cards (0-51, 255 for masked) and sorts every group
+static void suit_image(const int *cards, const int *group_sizes, int n_groups, 
+    const int *perm, int *out)
+{
+    int g, i, j, start = 0;
+    for (g = 0; g < n_groups; start += group_sizes[g++])
+        for (i = start; i < start + group_sizes[g]; i++)
+        {
+            int card = permute_suit(cards[i], perm);
+            for (j = i; j > start && out[j - 1] > card; j--)
+                out[j] = out[j - 1];
+            out[j] = card;
+        }
+}
+
+// The suit permutations that map every group of the cards (0-51, 255 for 
+// masked; e.g. the board and each pocket) onto itself as a set, identity 
+// first; spots related by one of them have the same equities. Returns their 
+// number, a divisor of 24.
+int suit_symmetries(const int *cards, const int *group_sizes, int n_groups, 
+    int perms[SUIT_PERMUTATIONS][4])
+{
+    int i, k, n = 0, n_cards = 0, sorted[64], image[64];
+    for (i = 0; i < n_groups; i++)
+        n_cards += group_sizes[i];
+    suit_image(cards, group_sizes, n_groups, suit_perms[0], sorted);
+    for (k = 0; k < SUIT_PERMUTATIONS; k++)
+    {
+        suit_image(cards, group_sizes, n_groups, suit_perms[k], image);
+        if (!memcmp(image, sorted, n_cards * sizeof(int)))
+            memcpy(perms[n++], suit_perms[k], 4 * sizeof(int));
+    }
+    return n;
+}
+
+// Relabels the suits of the cards to the representative of their class under
+// suit permutations: of the images under all 24 with every group sorted, the
+// lexicographically smallest, so equivalent spots get the same cards. The
+// permutation used goes to perm if not NULL. Returns the number of distinct 
+// spots in the class.
+int suit_canonicalize(const int *cards, const int *group_sizes, int n_groups, 
+    int *out, int *perm)
+{
+    int i, k, n_cards = 0, n_same = 1, best = 0, image[64];
+    for (i = 0; i < n_groups; i++)
+        n_cards += group_sizes[i];
+    suit_image(cards, group_sizes, n_groups, suit_perms[0], out);
+    for (k = 1; k < SUIT_PERMUTATIONS; k++)
+    {
+        suit_image(cards, group_sizes, n_groups, suit_perms[k], image);
+        int cmp = 0;
+        for (i = 0; i < n_cards && !cmp; i++)
+            cmp = image[i] - out[i];
+        if (cmp < 0)
+        {
+            memcpy(out, image, n_cards * sizeof(int));
+            best = k;
+            n_same = 1;
+        }
+        else if (cmp == 0)
+            n_same++;
+    }
+    if (perm)
+        memcpy(perm, suit_perms[best], 4 * sizeof(int));
+    return SUIT_PERMUTATIONS / n_same;
+}
+
+const char *backing_str(int backing)
+{
+    const char *_backing_str[] =
+    {
+        "none",
+        "heap",
+        "heap+thp",
+        "hugetlb",
+        "mmap",
+        "mmap+thp",
+        "hugetlbfs",
+        "shm",
+        "shm+hugetlb",
+        "posix_shm",
+        "posix_shm+thp"
+    };
+    return _backing_str[backing];
+}
+
+#ifdef MAP_HUGETLB
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT      26
+#endif
+
+// MAP_HUGE_* (and SHM_HUGE_*, same encoding) bits for the huge page size in MB
+static int huge_page_bits(int huge_pages)
+{
+    return (huge_pages >= 1024 ? 30 : 21) << MAP_HUGE_SHIFT;
+}
+#endif
+
+static size_t huge_page_bytes(int huge_pages)
+{
+    return huge_pages >= 1024 ? (1UL << 30) : (2UL << 20);
+}
+
+static size_t round_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// anonymous memory for a private table copy: explicit huge pages of the given
+// size in MB (2 or 1024) if the pool has enough of them, else transparent huge 
+// pages, else whatever malloc gives; huge_pages = 0 just mallocs
+void *alloc_table(size_t size, int huge_pages, int *backing)
+{
+    *backing = BACKING_HEAP;
+    if (!huge_pages)
+        return malloc(size);
+#ifdef MAP_HUGETLB
+    size_t map_size = round_up(size, huge_page_bytes(huge_pages));
+    void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge_page_bits(huge_pages), -1, 0);
+    if (p != MAP_FAILED)
+    {
+        *backing = BACKING_HUGETLB;
+        return p;
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    // transparent huge pages need 2MB-aligned ranges, so over-allocate a bit
+    size_t thp_size = round_up(size, 2UL << 20) + (2UL << 20);
+    void *q = mmap(NULL, thp_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (q != MAP_FAILED)
+    {
+        char *aligned = (char *) round_up((size_t) q, 2UL << 20);
+        size_t head = aligned - (char *) q, body = round_up(size, 2UL << 20);
+        // trim the unaligned head and the rest of the tail, so that free_table() 
+        // can release the whole mapping from the aligned pointer
+        if (head)
+            munmap(q, head);
+        if (thp_size - head - body)
+            munmap(aligned + body, thp_size - head - body);
+        if (madvise(aligned, body, MADV_HUGEPAGE) == 0)
+        {
+            *backing = BACKING_HEAP_THP;
+            return aligned;
+        }
+        munmap(aligned, body);
+    }
+#endif
+    return malloc(size);
+}
+
+// releases what alloc_table() returned
+void free_table(void *p, size_t size, int huge_pages, int backing)
+{
+    if (!p)
+        return;
+    if (backing == BACKING_HUGETLB)
+        munmap(p, round_up(size, huge_page_bytes(huge_pages)));
+    else if (backing == BACKING_HEAP_THP)
+        munmap(p, round_up(size, 2UL << 20)); // alloc_table() trimmed the rest
+    else
+        free(p);
+}
+
+int *smart_load(const char *filename, int huge_pages, int *backing)
 {
     // the size of the file is contained in the header
     FILE *f = fopen(filename, "rb");
+    table_info info;
     if (f)
     {
-        int size = 0;
-        fread(&size, sizeof(int), 1, f);
-        int *data = (int *) malloc(size * sizeof(int));
-        load_file((char *)data, sizeof(int), size, f);
+        int _backing;
+        if (read_table_header(f, &info, filename))
+        {
+            fclose(f);
+            return NULL;
+        }
+        int *data = (int *) alloc_table((size_t) info.length * sizeof(int), huge_pages, &_backing);
+        if (load_entries(data, &info, f, filename))
+        {
+            free_table(data, (size_t) info.length * sizeof(int), huge_pages, _backing);
+            fclose(f);
+            return NULL;
+        }
+        if (backing)
+            *backing = _backing;
         fclose(f);
         return data;
     }
@@ -168,6 +782,68 @@ int *smart_load(const char *filename)
         return NULL;
 }
 
+// maps the file read-only instead of copying it, so that all processes share 
+// the same page cache copy; populate pre-faults the pages (MAP_POPULATE on 
+// linux, madvise(MADV_WILLNEED) elsewhere); files on hugetlbfs are backed by 
+// huge pages anyway, otherwise huge_pages only asks for transparent ones
+int *smart_mmap(const char *filename, bool populate, int huge_pages, int *backing)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open");
+        return NULL;
+    }
+    struct stat st;
+    char buf[sizeof(table_file_header)];
+    table_info info;
+    ssize_t n;
+    if (fstat(fd, &st) == -1 || (n = pread(fd, buf, sizeof(buf), 0)) < 0 ||
+        parse_table_header(buf, (size_t) n, (uint64_t) st.st_size, &info, filename))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t map_size = (size_t) (info.data_offset + info.length * sizeof(int));
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (populate)
+        flags |= MAP_POPULATE;
+#endif
+    void *map = mmap(NULL, map_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    int _backing = BACKING_MMAP;
+#ifdef __linux__
+    struct statfs sfs;
+    if (statfs(filename, &sfs) == 0 && sfs.f_type == 0x958458f6) // HUGETLBFS_MAGIC
+        _backing = BACKING_HUGETLBFS;
+#endif
+#ifdef MADV_HUGEPAGE
+    if (huge_pages && _backing == BACKING_MMAP && madvise(map, map_size, MADV_HUGEPAGE) == 0)
+        _backing = BACKING_MMAP_THP;
+#endif
+#ifndef MAP_POPULATE
+    if (populate)
+        madvise(map, map_size, MADV_WILLNEED);
+#endif
+    int *data = (int *) ((char *) map + info.data_offset);
+    // the pages are being read anyway when populating, lazy mappings aren't verified
+    if (populate && info.version >= 2 && table_checksum(data, (size_t) info.length) != info.checksum)
+    {
+        std::cout << "\n\"" << filename << "\": checksum mismatch, the file is corrupt.\n";
+        munmap(map, map_size);
+        return NULL;
+    }
+    if (backing)
+        *backing = _backing;
+    return data;
+}
+
 key_t generate_random_shm_key(void)
 {
     /*
@@ -192,31 +868,56 @@ key_t generate_random_shm_key(void)
     return (key_t)key;
 }
 
-int *smart_load_to_shm(const char *filename, key_t key)
+int *smart_load_to_shm(const char *filename, key_t key, int huge_pages, int *backing)
 {
-    int shmid;
+    int shmid = -1;
     // the size of the file is contained in the header
     FILE *f = fopen(filename, "rb");
     int *shm, *hr;
-    int size = 0;
+    table_info info;
     if (f)
     {
-        fread(&size, sizeof(int), 1, f);
-        shmid = shmget(key, size*sizeof(int) + sizeof(int), IPC_CREAT | 0600);
+        if (read_table_header(f, &info, filename) || info.length >= INT_MAX)
+        {
+            fclose(f);
+            return NULL;
+        }
+        int size = (int) info.length;
+        if (backing)
+            *backing = BACKING_SHM;
+#if defined(SHM_HUGETLB) && defined(MAP_HUGETLB)
+        if (huge_pages)
+        {
+            shmid = shmget(key, round_up(size*sizeof(int) + sizeof(int), huge_page_bytes(huge_pages)),
+                IPC_CREAT | 0600 | SHM_HUGETLB | huge_page_bits(huge_pages));
+            if (shmid != -1 && backing)
+                *backing = BACKING_SHM_HUGETLB;
+        }
+#endif
+        if (shmid == -1)
+            shmid = shmget(key, size*sizeof(int) + sizeof(int), IPC_CREAT | 0600);
         if (shmid == -1)
         {
             perror("shmget");
+            fclose(f);
             return NULL;
         }
         
         if ((shm = (int *)shmat(shmid, NULL, 0)) == (int *) -1)
         {
             perror("shmat");
+            fclose(f);
             return NULL;
         }
         *shm = size;
         hr = shm + 1;
-        load_file((char *)hr, sizeof(int), size, f);
+        if (load_entries(hr, &info, f, filename))
+        {
+            shmdt(shm);
+            shmctl(shmid, IPC_RMID, NULL);
+            fclose(f);
+            return NULL;
+        }
         fclose(f);
         return shm;
     }
@@ -225,9 +926,14 @@ int *smart_load_to_shm(const char *filename, key_t key)
 
 int *attach_hr(key_t key)
 {
-    int hr_size;
-    hr_size = *attach_shm(key, 1);
-    return attach_shm(key, hr_size + 1) + 1;
+    int *shm;
+    if (!(shm = attach_shm(key, 1)))
+        return NULL;
+    int hr_size = *shm;
+    shmdt(shm);
+    if (!(shm = attach_shm(key, hr_size + 1)))
+        return NULL;
+    return shm + 1;
 }
 
 int *attach_shm(key_t key, int size)
@@ -266,8 +972,431 @@ int del_shm(key_t key)
     return res;
 }
 
+// POSIX shared memory segments start with a header page, the table follows it
+#define POSIX_SHM_MAGIC     0x52415953 // "RAYS"
+#define POSIX_SHM_HEADER    4096
+
+typedef struct {
+    uint32_t magic;
+    volatile uint32_t ready;    // set only once the table is completely loaded
+    uint64_t size;              // number of ints in the table
+    uint64_t creator_pid;
+} posix_shm_header;
+
+#define POSIX_SHM_WAIT_SECONDS  600 // for another process to finish loading the segment
+#define POSIX_SHM_POLL_MS       20
+#define POSIX_SHM_UNSIZED_SECONDS 10 // a segment still unsized after that has lost its creator
+
+#define POSIX_SHM_READY     0
+#define POSIX_SHM_STALE     1   // its creator died before it was ready, now unlinked
+#define POSIX_SHM_FAILED    2
+
+// derives the segment name from the path and the id, like ftok() does for SysV keys
+void posix_shm_name(const char *path, int id, char *name, size_t len)
+{
+    char resolved[PATH_MAX];
+    if (!realpath(path, resolved))
+        snprintf(resolved, sizeof(resolved), "%s", path);
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (const char *c = resolved; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 0x100000001b3ULL;
+    snprintf(name, len, "/rayeval.%016llx.%d", (unsigned long long) hash, id);
+}
+
+// unlinks a segment its creator left unready, if the name still refers to it
+static void posix_shm_unlink_stale(const char *name, const struct stat *st)
+{
+    struct stat now;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+        return;
+    if (fstat(fd, &now) == 0 && now.st_ino == st->st_ino)
+    {
+        std::cout << "\nposix_shm_load(): removing \"" << name << "\" left half-loaded.\n";
+        shm_unlink(name);
+    }
+    close(fd);
+}
+
+// Waits for a segment that another process is loading to be marked ready. If
+// its creator is gone (it can't be signalled, so this only works within one 
+// pid namespace), or it died before even sizing the segment, the segment can
+// never become ready and is unlinked.
+static int posix_shm_wait_ready(const char *name)
+{
+    struct timespec pause = {0, POSIX_SHM_POLL_MS * 1000000L};
+    for (int t = 0; t < POSIX_SHM_WAIT_SECONDS * 1000; t += POSIX_SHM_POLL_MS)
+    {
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd == -1)
+            return (errno == ENOENT) ? POSIX_SHM_STALE : POSIX_SHM_FAILED; // unlinked meanwhile
+        struct stat st;
+        int stale = 0;
+        if (fstat(fd, &st) == -1)
+        {
+            close(fd);
+            return POSIX_SHM_FAILED;
+        }
+        if (st.st_size < POSIX_SHM_HEADER)
+            stale = time(NULL) - st.st_ctime > POSIX_SHM_UNSIZED_SECONDS;
+        else
+        {
+            void *map = mmap(NULL, POSIX_SHM_HEADER, PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED)
+            {
+                close(fd);
+                return POSIX_SHM_FAILED;
+            }
+            const posix_shm_header *header = (const posix_shm_header *) map;
+            int ready = header->ready;
+            pid_t pid = (pid_t) header->creator_pid;
+            munmap(map, POSIX_SHM_HEADER);
+            if (ready)
+            {
+                close(fd);
+                return POSIX_SHM_READY;
+            }
+            stale = pid > 0 && kill(pid, 0) == -1 && errno == ESRCH;
+        }
+        close(fd);
+        if (stale)
+        {
+            posix_shm_unlink_stale(name, &st);
+            return POSIX_SHM_STALE;
+        }
+        nanosleep(&pause, NULL);
+    }
+    std::cout << "\nposix_shm_load(): timed out waiting for \"" << name << "\" to be loaded.\n";
+    return POSIX_SHM_FAILED;
+}
 
-int smart_save(int *x, int size, const char *filename)
+// Creates the segment exclusively, loads the table and only then marks it ready,
+// so attachers never see a half-loaded table; the creator's mapping is made 
+// read-only afterwards. If the segment exists already it is attached instead,
+// once it's ready; one left behind by a crashed creator is replaced.
+// The segment lives until posix_shm_unlink().
+int *posix_shm_load(const char *name, const char *filename, int huge_pages, int *backing)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+    {
+        perror("fopen");
+        return NULL;
+    }
+    table_info info;
+    if (read_table_header(f, &info, filename))
+    {
+        fclose(f);
+        return NULL;
+    }
+    size_t map_size = POSIX_SHM_HEADER + (size_t) info.length * sizeof(int);
+    int fd;
+    while ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644)) == -1)
+    {
+        if (errno != EEXIST)
+        {
+            perror("shm_open");
+            fclose(f);
+            return NULL;
+        }
+        // somebody else is loading it or has loaded it already
+        int state = posix_shm_wait_ready(name);
+        if (state == POSIX_SHM_STALE)
+            continue;
+        fclose(f);
+        if (state != POSIX_SHM_READY)
+            return NULL;
+        int *hr = posix_shm_attach(name);
+        if (hr && backing)
+            *backing = BACKING_POSIX_SHM;
+        return hr;
+    }
+    if (ftruncate(fd, (off_t) map_size) == -1)
+    {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        fclose(f);
+        return NULL;
+    }
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_unlink(name);
+        fclose(f);
+        return NULL;
+    }
+    if (backing)
+        *backing = BACKING_POSIX_SHM;
+#ifdef MADV_HUGEPAGE
+    // shmem honours this if /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it
+    if (huge_pages && madvise(map, map_size, MADV_HUGEPAGE) == 0 && backing)
+        *backing = BACKING_POSIX_SHM_THP;
+#endif
+    posix_shm_header *header = (posix_shm_header *) map;
+    header->magic = POSIX_SHM_MAGIC;
+    header->size = info.length;
+    header->creator_pid = (uint64_t) getpid();
+    int *hr = (int *) ((char *) map + POSIX_SHM_HEADER);
+    if (load_entries(hr, &info, f, filename))
+    {
+        // never marked ready, so nobody can have attached to it
+        munmap(map, map_size);
+        shm_unlink(name);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    __sync_synchronize();
+    header->ready = 1;
+    mprotect(map, map_size, PROT_READ);
+    return hr;
+}
+
+// attaches read-only, fails if the segment doesn't exist or is still being loaded
+int *posix_shm_attach(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        perror("shm_open");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < POSIX_SHM_HEADER)
+    {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    posix_shm_header *header = (posix_shm_header *) map;
+    int ready = header->ready;
+    __sync_synchronize();
+    if (header->magic != POSIX_SHM_MAGIC || !ready || 
+        POSIX_SHM_HEADER + header->size * sizeof(int) > (uint64_t) st.st_size)
+    {
+        std::cout << "\nposix_shm_attach(): \"" << name << "\" is not a ready hand ranks segment.\n";
+        munmap(map, (size_t) st.st_size);
+        return NULL;
+    }
+    return (int *) ((char *) map + POSIX_SHM_HEADER);
+}
+
+int posix_shm_detach(int *hr)
+{
+    posix_shm_header *header = (posix_shm_header *) ((char *) hr - POSIX_SHM_HEADER);
+    if (munmap(header, POSIX_SHM_HEADER + header->size * sizeof(int)) == -1)
+    {
+        perror("munmap");
+        return -1;
+    }
+    return 0;
+}
+
+int posix_shm_unlink(const char *name)
+{
+    if (shm_unlink(name) == -1)
+    {
+        perror("shm_unlink");
+        return -1;
+    }
+    return 0;
+}
+
+// true if the segment exists and its table is completely loaded
+bool posix_shm_is_ready(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+        return false;
+    posix_shm_header header;
+    bool ready = (read(fd, &header, sizeof(header)) == (ssize_t) sizeof(header)) &&
+        header.magic == POSIX_SHM_MAGIC && header.ready;
+    close(fd);
+    return ready;
+}
+
+// Equity cache files are a header page and a power of two of fixed-size slots
+// shared by every process that maps the file. A slot is found by linear 
+// probing from the hash of its key and guarded by a sequence number that is
+// odd while it is written, so readers never take a torn entry and writers 
+// that lose the race for a slot just don't store their result.
+#define CACHE_FILE_MAGIC    0x43594152 // "RAYC"
+#define CACHE_FILE_VERSION  1
+#define CACHE_FILE_HEADER   4096
+#define CACHE_PROBES        8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t key_size;
+    uint64_t n_slots;
+} cache_file_header;
+
+typedef struct {
+    volatile uint32_t seq;      // odd while the entry is written, 0 if never used
+    uint32_t n_players;
+    uint64_t accuracy;          // deals sampled, CACHE_EXACT if enumerated
+    uint8_t key[CACHE_KEY_SIZE];
+    double ev[MAX_PLAYERS];
+} cache_entry;
+
+static uint64_t cache_hash(const uint8_t *key)
+{
+    uint64_t h = 0xcbf29ce484222325LLU;
+    for (int i = 0; i < CACHE_KEY_SIZE; i++)
+        h = (h ^ key[i]) * 0x100000001b3LLU;
+    return h ^ (h >> 29);
+}
+
+// Maps the cache file, creating it with n_slots (rounded up to a power of two)
+// if it doesn't exist; an existing file keeps its own size. Returns 1 on error.
+int cache_store_open(cache_store *c, const char *filename, uint64_t n_slots)
+{
+    cache_file_header header;
+    memset(c, 0, sizeof(cache_store));
+    int fd = open(filename, O_RDWR);
+    if (fd == -1 && errno == ENOENT)
+    {
+        // built aside and linked into place, so that nobody sees a partial header
+        char tmp[PATH_MAX];
+        snprintf(tmp, sizeof(tmp), "%s.%d.tmp", filename, (int) getpid());
+        uint64_t n = 1;
+        while (n < n_slots)
+            n <<= 1;
+        memset(&header, 0, sizeof(header));
+        header.magic = CACHE_FILE_MAGIC;
+        header.version = CACHE_FILE_VERSION;
+        header.entry_size = sizeof(cache_entry);
+        header.key_size = CACHE_KEY_SIZE;
+        header.n_slots = n;
+        int tmp_fd = open(tmp, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (tmp_fd == -1)
+        {
+            perror("open");
+            return 1;
+        }
+        int failed = ftruncate(tmp_fd, (off_t) (CACHE_FILE_HEADER + n * sizeof(cache_entry))) == -1 ||
+            pwrite(tmp_fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header);
+        close(tmp_fd);
+        if (failed || (link(tmp, filename) == -1 && errno != EEXIST))
+        {
+            perror("cache_store_open");
+            unlink(tmp);
+            return 1;
+        }
+        unlink(tmp);
+        fd = open(filename, O_RDWR);
+    }
+    if (fd == -1)
+    {
+        perror("open");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+        header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION ||
+        header.entry_size != sizeof(cache_entry) || header.key_size != CACHE_KEY_SIZE ||
+        !header.n_slots || (header.n_slots & (header.n_slots - 1)) ||
+        CACHE_FILE_HEADER + header.n_slots * sizeof(cache_entry) > (uint64_t) st.st_size)
+    {
+        std::cout << "\n\"" << filename << "\" is not an equity cache file.\n";
+        close(fd);
+        return 1;
+    }
+    c->size = (size_t) (CACHE_FILE_HEADER + header.n_slots * sizeof(cache_entry));
+    c->map = mmap(NULL, c->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (c->map == MAP_FAILED)
+    {
+        perror("mmap");
+        c->map = NULL;
+        return 1;
+    }
+    c->n_slots = header.n_slots;
+    return 0;
+}
+
+void cache_store_close(cache_store *c)
+{
+    if (c->map)
+        munmap(c->map, c->size);
+    memset(c, 0, sizeof(cache_store));
+}
+
+static cache_entry *cache_slot(const cache_store *c, uint64_t i)
+{
+    return (cache_entry *) ((char *) c->map + CACHE_FILE_HEADER) + (i & (c->n_slots - 1));
+}
+
+// Copies the equities of the key to ev if they are stored with at least the 
+// given accuracy, returns 1 if so.
+int cache_store_get(const cache_store *c, const uint8_t *key, uint64_t accuracy, double *ev, int n_players)
+{
+    uint64_t h = cache_hash(key);
+    for (int i = 0; i < CACHE_PROBES; i++)
+    {
+        cache_entry *e = cache_slot(c, h + i), copy;
+        uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        if (seq == 0)
+            return 0;
+        if (seq & 1)
+            continue;
+        memcpy(&copy, e, sizeof(cache_entry));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq || memcmp(copy.key, key, CACHE_KEY_SIZE))
+            continue;
+        if (copy.accuracy < accuracy || (int) copy.n_players != n_players)
+            return 0;
+        memcpy(ev, copy.ev, n_players * sizeof(double));
+        return 1;
+    }
+    return 0;
+}
+
+// Stores the equities of the key unless they are already there with a better
+// accuracy; if every probed slot holds another key, the first one is evicted.
+void cache_store_put(cache_store *c, const uint8_t *key, uint64_t accuracy, const double *ev, int n_players)
+{
+    uint64_t h = cache_hash(key);
+    cache_entry *target = NULL;
+    for (int i = 0; i < CACHE_PROBES && !target; i++)
+    {
+        cache_entry *e = cache_slot(c, h + i);
+        uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        if (seq == 0 || (!(seq & 1) && !memcmp(e->key, key, CACHE_KEY_SIZE)))
+        {
+            if (seq != 0 && e->accuracy > accuracy)
+                return;
+            target = e;
+        }
+    }
+    if (!target)
+        target = cache_slot(c, h);
+    uint32_t seq = __atomic_load_n(&target->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) || !__atomic_compare_exchange_n(&target->seq, &seq, seq + 1, false, 
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+    memcpy(target->key, key, CACHE_KEY_SIZE);
+    target->n_players = (uint32_t) n_players;
+    target->accuracy = accuracy;
+    memset(target->ev, 0, sizeof(target->ev));
+    memcpy(target->ev, ev, n_players * sizeof(double));
+    __atomic_store_n(&target->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// writes a version 2 file; sections are the flush suit, flush rank and 
+// non-flush block offsets of 9-card tables
+int smart_save(const int *x, size_t size, const char *filename, int kind, const uint64_t *sections)
 {
     std::cout << "\nSaving the data to \"" << filename << "\"...";
     std::ofstream out(filename, std::ios::out | std::ios::binary);
@@ -276,11 +1405,29 @@ int smart_save(int *x, int size, const char *filename)
         std::cout << "\tError opening file.\n";
         return 1;
     }
-    int header[1];
-    header[0] = size; // store the size in the first 4 bytes
-    out.write(reinterpret_cast<const char *>(header), sizeof(int));
-    out.write(reinterpret_cast<const char *>((int *) x), 
-        sizeof(int) * header[0]);
+    char header_page[TABLE_FILE_HEADER];
+    table_file_header header;
+    memset(header_page, 0, sizeof(header_page));
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLE_FILE_MAGIC, sizeof(TABLE_FILE_MAGIC));
+    header.version = TABLE_FILE_VERSION;
+    header.kind = (uint32_t) kind;
+    header.byte_order = 0x01020304;
+    header.entry_size = sizeof(int);
+    header.length = size;
+    header.data_offset = TABLE_FILE_HEADER;
+    if (sections)
+        memcpy(header.sections, sections, sizeof(header.sections));
+    header.checksum = table_checksum(x, size);
+    header.header_checksum = header_checksum(&header);
+    memcpy(header_page, &header, sizeof(header));
+    out.write(header_page, sizeof(header_page));
+    out.write(reinterpret_cast<const char *>(x), sizeof(int) * size);
+    out.close();
+    if (!out)
+    {
+        std::cout << "\tError writing file.\n";
+        return 1;
+    }
     return 0;    
 }
-
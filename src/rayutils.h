@@ -6,6 +6,21 @@
 #define MAX(x, y)           ((x) > (y) ? (x) : (y))
 #define MIN(x, y)           ((x) < (y) ? (x) : (y))
 
+#define MC_INTERLEAVE       16  // default number of Monte Carlo trials walked in lockstep
+#define MC_MAX_INTERLEAVE   32
+#define MC_ADAPTIVE_CHUNK   10000 // deals in the first round of adaptive Monte Carlo
+#define MC_BATCH_CHUNK      100000 // deals per task of batch Monte Carlo
+#define MC_ASYNC_CHUNK      20000  // deals per task of asynchronous Monte Carlo
+#define PREFETCH(p)         __builtin_prefetch((p), 0, 0)
+#define SUIT_PERMUTATIONS   24
+#define PREFLOP_HOLDEM_COMBOS 1326
+#define PREFLOP_OMAHA_COMBOS  270725
+#define PREFLOP_TABLE_SIZE  (PREFLOP_HOLDEM_COMBOS * (1 + PREFLOP_HOLDEM_COMBOS) + PREFLOP_OMAHA_COMBOS)
+#define PREFLOP_SCALE       (1 << 30) // equities are stored as fixed point ints
+#define CACHE_KEY_SIZE      48      // game, board size, number of players, then the canonical cards
+#define CACHE_EXACT         (~0LLU) // accuracy of enumerated equities
+#define RANGE_MAX_REJECTS   100000  // combo draws in a row that clash before ranges are deemed incompatible
+
 #define	STRAIGHT_FLUSH		1
 #define	FOUR_OF_A_KIND		2
 #define	FULL_HOUSE			3
@@ -16,25 +31,147 @@
 #define	ONE_PAIR			8
 #define	HIGH_CARD			9
 
+#define BACKING_NONE        0
+#define BACKING_HEAP        1
+#define BACKING_HEAP_THP    2
+#define BACKING_HUGETLB     3
+#define BACKING_MMAP        4
+#define BACKING_MMAP_THP    5
+#define BACKING_HUGETLBFS   6
+#define BACKING_SHM         7
+#define BACKING_SHM_HUGETLB 8
+#define BACKING_POSIX_SHM   9
+#define BACKING_POSIX_SHM_THP 10
+
+#define TABLE_KIND_UNKNOWN  0
+#define TABLE_KIND_PREFLOP  2
+#define TABLE_KIND_7        7
+#define TABLE_KIND_9        9
+#define TABLE_KIND_9_COMPACT 19
+
+#define TABLE_FILE_VERSION  2
+#define TABLE_FILE_HEADER   4096    // bytes reserved for the header, data starts after it
+
+#define HR9C_MAGIC          ((int) 0xC9C9C9C9)   // reads as a negative HR9[0]
+#define HR9C_HEADER         16      // ints: magic, then node offset, leaf offset and root per section
+#define HR9C_FLUSH_SUITS    0
+#define HR9C_FLUSH_RANKS    1
+#define HR9C_NO_FLUSH       2
+#define HR9C_DEPTH          9       // 8 node levels, then a leaf level
+
 #define CLUB				0x8000
 #define DIAMOND 			0x4000
 #define HEART   			0x2000
 #define SPADE   			0x1000
 
 #include <sys/types.h>
+#include <stdint.h>
+
+// random number generator state, owned by the caller (one per thread)
+typedef struct { uint64_t s[4]; } rng_t;
+
+// Hand ranks file header, version 2. Version 1 files are a bare int count 
+// followed by the entries; the magic reads as a negative count there, so 
+// old readers refuse new files instead of misloading them.
+typedef struct {
+    char magic[8];              // "RAY\xffHR\r\n"
+    uint32_t version;           // TABLE_FILE_VERSION
+    uint32_t kind;              // TABLE_KIND_*
+    uint32_t byte_order;        // 0x01020304 in the writer's byte order
+    uint32_t entry_size;        // sizeof(int)
+    uint64_t length;            // number of entries
+    uint64_t data_offset;       // in bytes, from the start of the file
+    uint64_t sections[3];       // entry offsets of flush suit, flush rank and non-flush blocks
+    uint64_t checksum;          // table_checksum() of the entries
+    uint64_t header_checksum;   // table_checksum() of the fields above
+} table_file_header;
+
+// what is known about a hand ranks file from its header, either version
+typedef struct {
+    int version;
+    int kind;
+    uint64_t length;
+    uint64_t data_offset;
+    uint64_t sections[3];
+    uint64_t checksum;          // 0 for version 1 files
+} table_info;
+
+// the sections of a compact 9-card table: nodes hold pre-scaled offsets of the
+// next level's blocks, the last node level points into the 16-bit leaves
+typedef struct {
+    const int *nodes[3];
+    const uint16_t *leaves[3];
+    int root[3];
+} hr9c_t;
+
+// weighted range of pockets: every combo is size cards, 0-51 or 255 for a 
+// card dealt at random; a fixed pocket is a range of one combo
+typedef struct {
+    int n, size;
+    int *cards;                 // n * size cards
+    uint64_t *masks;            // bit masks of the known cards of every combo
+    double *weights;            // normalized to sum to 1
+    double *cdf;                // cumulative weights, for sampling
+} range_t;
+
+// a mapped equity cache file, see cache_store_open()
+typedef struct {
+    void *map;
+    size_t size;
+    uint64_t n_slots;
+} cache_store;
+
+// streaming checksum state, see checksum_update()
+typedef struct { uint64_t a, b; } checksum_t;
 
 int load_file(char* dest, size_t size, size_t nitems, FILE* stream);
+void checksum_init(checksum_t *sum);
+void checksum_update(checksum_t *sum, const int *data, size_t n);
+uint64_t checksum_final(const checksum_t *sum);
+uint64_t table_checksum(const int *data, size_t n);
+int read_table_info(const char *filename, table_info *info);
+int hr9c_layout(const int *hr, hr9c_t *t);
+int eval_hr9c(const hr9c_t *t, const int *cards);
+int verify_table_file(const char *filename);
 int cactus_findit(int key);
 int cactus_to_ray(int holdrank);
 const char *hand_rank_str(int handrank_num);
 const char *get_hand_rank(int handrank);
-void init_random_int_52();
+void rng_seed(rng_t *rng, uint64_t seed, uint64_t stream);
+uint64_t rng_next(rng_t *rng);
+uint32_t rng_bounded(rng_t *rng, uint32_t n);
+void init_random();
+void seed_random(uint64_t seed, uint64_t stream);
+uint64_t random_stream_seed();
 void swap(int *x, int *y);
-void random_sample_52_ross(int n, int k, int *out);
-int *smart_load(const char *filename);
-int smart_save(int *x, int size, const char *filename);
+void random_sample_52_ross(int n, int k, int *out, rng_t *rng);
+void random_sample_52_stratified(int n, int k, int first, int *out, rng_t *rng);
+int range_init(range_t *r, int n, int size, const int *cards, const double *weights);
+void range_free(range_t *r);
+int range_sample(const range_t *r, rng_t *rng);
+int suit_symmetries(const int *cards, const int *group_sizes, int n_groups, 
+    int perms[SUIT_PERMUTATIONS][4]);
+int suit_canonicalize(const int *cards, const int *group_sizes, int n_groups, 
+    int *out, int *perm);
+const char *backing_str(int backing);
+void *alloc_table(size_t size, int huge_pages, int *backing);
+void free_table(void *p, size_t size, int huge_pages, int backing);
+int *smart_load(const char *filename, int huge_pages=0, int *backing=NULL);
+int *smart_mmap(const char *filename, bool populate, int huge_pages=0, int *backing=NULL);
+int smart_save(const int *x, size_t size, const char *filename, 
+    int kind=TABLE_KIND_UNKNOWN, const uint64_t *sections=NULL);
 key_t generate_random_shm_key(void);
-int *smart_load_to_shm(const char *filename, key_t key);
+int *smart_load_to_shm(const char *filename, key_t key, int huge_pages=0, int *backing=NULL);
 int *attach_hr(key_t key);
 int *attach_shm(key_t key, int size);
 int del_shm(key_t key);
+void posix_shm_name(const char *path, int id, char *name, size_t len);
+int *posix_shm_load(const char *name, const char *filename, int huge_pages=0, int *backing=NULL);
+int *posix_shm_attach(const char *name);
+int posix_shm_detach(int *hr);
+int posix_shm_unlink(const char *name);
+bool posix_shm_is_ready(const char *name);
+int cache_store_open(cache_store *c, const char *filename, uint64_t n_slots);
+void cache_store_close(cache_store *c);
+int cache_store_get(const cache_store *c, const uint8_t *key, uint64_t accuracy, double *ev, int n_players);
+void cache_store_put(cache_store *c, const uint8_t *key, uint64_t accuracy, const double *ev, int n_players);